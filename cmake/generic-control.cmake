@@ -0,0 +1,14 @@
+list(APPEND SRC_FILES src/generic-control.cc)
+
+# Defaults for the pins; can be overridden at runtime with the environment
+# variables TXTEMPUS_GPIO_CHIP, TXTEMPUS_GPIO_LINE, TXTEMPUS_PWM_CHIP and
+# TXTEMPUS_PWM_CHANNEL.
+set(GENERIC_GPIO_CHIP "/dev/gpiochip0" CACHE STRING "GPIO character device")
+set(GENERIC_ATTENUATION_LINE 17 CACHE STRING "Attenuation line offset")
+set(GENERIC_PWM_CHIP "/sys/class/pwm/pwmchip0" CACHE STRING "sysfs PWM chip")
+set(GENERIC_PWM_CHANNEL 0 CACHE STRING "PWM channel for the carrier")
+
+add_definitions(-DGENERIC_GPIO_CHIP="${GENERIC_GPIO_CHIP}"
+                -DGENERIC_ATTENUATION_LINE=${GENERIC_ATTENUATION_LINE}
+                -DGENERIC_PWM_CHIP="${GENERIC_PWM_CHIP}"
+                -DGENERIC_PWM_CHANNEL=${GENERIC_PWM_CHANNEL})
@@ -1,2 +1,2 @@
-find_package(JetsonGPIO)    # JetsonGPIO must be installed (https://github.com/pjueon/JetsonGPIO)
+find_package(JetsonGPIO REQUIRED)    # JetsonGPIO must be installed (https://github.com/pjueon/JetsonGPIO)
 list(APPEND PLATFORM_DEPENDENCIES JetsonGPIO::JetsonGPIO)
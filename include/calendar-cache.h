@@ -0,0 +1,60 @@
+// -*- mode: c++; c-basic-offset: 2; indent-tabs-mode: nil; -*-
+// Part of txtempus, a LF time signal transmitter.
+// Copyright (C) 2018 Henner Zeller <h.zeller@acm.org>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+
+#ifndef CALENDAR_CACHE_H
+#define CALENDAR_CACHE_H
+
+#include <ctime>
+
+// Breaks down times into calendar fields like localtime_r() or gmtime_r(),
+// for callers that mostly ask for a time close after the previous one, such
+// as an encoder going from minute to minute.
+//
+// The C library is only called at the start of a stretch of time, which
+// lasts until the next midnight or until the UTC offset or DST flag of the
+// time zone changes, whichever comes first. Within it, the time of day is
+// counted from the start. The offset is assumed to change at most once
+// between two midnights. Changing TZ needs a new cache.
+class CalendarCache {
+ public:
+  enum Zone { LOCAL, UTC };
+
+  explicit CalendarCache(Zone zone) : zone_(zone) {}
+
+  // Fields of the given time, as localtime_r() or gmtime_r() would return.
+  void BreakDown(time_t t, struct tm *result);
+
+ private:
+  void BreakDownSlow(time_t t, struct tm *result) const;
+  void StartStretch(time_t t);
+
+  Zone zone_;
+  time_t start_ = 0;  // The stretch is [start_, end_)
+  time_t end_ = 0;
+  int start_second_of_day_ = 0;
+  struct tm start_fields_ = {};
+};
+
+// The calendars EncodeSpecMinute() needs, kept from minute to minute.
+struct StationCalendars {
+  CalendarCache local{CalendarCache::LOCAL};
+  CalendarCache utc{CalendarCache::UTC};
+  CalendarCache tomorrow{CalendarCache::LOCAL};  // Local time a day ahead.
+};
+
+#endif  // CALENDAR_CACHE_H
@@ -0,0 +1,77 @@
+// -*- mode: c++; c-basic-offset: 2; indent-tabs-mode: nil; -*-
+// Part of txtempus, a LF time signal transmitter.
+// Copyright (C) 2018 Henner Zeller <h.zeller@acm.org>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+
+#ifndef CAPTURE_FILE_H
+#define CAPTURE_FILE_H
+
+#include <cstddef>
+#include <cstdint>
+
+// A recording of the transmitted signal: real samples from a sound card
+// (WAV or raw), or complex I/Q samples from an SDR. The file is memory
+// mapped, so hours of recording don't need to be read into memory.
+class CaptureFile {
+ public:
+  CaptureFile() = default;
+  ~CaptureFile();
+
+  CaptureFile(const CaptureFile &) = delete;
+  CaptureFile &operator=(const CaptureFile &) = delete;
+
+  // Open a WAV file (8, 16, 24, 32 bit integer or 32 bit float). Stereo
+  // files contain I/Q if "iq" is set, otherwise only the first channel is
+  // used. Returns 'false' on failure.
+  bool OpenWav(const char *filename, bool iq);
+
+  // Open a file with raw samples; "format" is one of "s16", "f32" for real
+  // or "cu8", "cs16", "cf32" for complex I/Q samples.
+  // Returns 'false' on failure.
+  bool OpenRaw(const char *filename, const char *format, int sample_rate);
+
+  int sample_rate() const { return sample_rate_; }
+  bool is_complex() const { return complex_; }
+  int64_t frames() const { return frames_; }
+
+  // Convert "count" frames starting at "first" to float, scaled to +/-1.
+  // Output values are written "stride" floats apart. The quadrature
+  // component of complex captures goes to "q", which is ignored otherwise.
+  void GetFrames(int64_t first, int count, int stride, float *i,
+                 float *q) const;
+
+ private:
+  enum class SampleType { U8, S16, S24, S32, F32 };
+
+  bool Map(const char *filename);
+  template <SampleType type>
+  static float ToFloat(const uint8_t *p);
+  template <SampleType type>
+  void Convert(int64_t first, int count, int stride, float *i, float *q) const;
+
+  const uint8_t *map_ = nullptr;
+  size_t map_size_ = 0;
+
+  const uint8_t *data_ = nullptr;
+  int64_t frames_ = 0;
+  int frame_bytes_ = 0;   // All channels.
+  int sample_bytes_ = 0;  // One channel.
+  SampleType type_ = SampleType::S16;
+  bool complex_ = false;
+  int sample_rate_ = 0;
+};
+
+#endif  // CAPTURE_FILE_H
@@ -0,0 +1,35 @@
+// -*- mode: c++; c-basic-offset: 2; indent-tabs-mode: nil; -*-
+// Part of txtempus, a LF time signal transmitter.
+// Copyright (C) 2018 Henner Zeller <h.zeller@acm.org>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#ifndef CLOCK_QUALITY_H
+#define CLOCK_QUALITY_H
+
+#include <cstdint>
+
+// How good the system clock is according to the kernel, as maintained by
+// NTP (or chrony, ...) through adjtimex().
+struct ClockQuality {
+  bool synchronized = false;  // Kernel doesn't consider the clock unsynced.
+  int64_t max_error_us = 0;   // Upper bound of the error.
+  int64_t est_error_us = 0;   // Estimated error.
+};
+
+// Read the current clock quality; this needs no special permissions.
+// Returns 'false' if adjtimex() failed.
+bool ReadClockQuality(ClockQuality *quality);
+
+#endif  // CLOCK_QUALITY_H
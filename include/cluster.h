@@ -0,0 +1,148 @@
+// -*- mode: c++; c-basic-offset: 2; indent-tabs-mode: nil; -*-
+// Part of txtempus, a LF time signal transmitter.
+// Copyright (C) 2018 Henner Zeller <h.zeller@acm.org>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#ifndef CLUSTER_H
+#define CLUSTER_H
+
+#include <netinet/in.h>
+
+#include <cstdint>
+#include <ctime>
+
+#include "time-signal-source.h"
+
+// Coordination of several txtempus with overlapping coverage through UDP
+// multicast, so that they act as one transmitter instead of sending
+// conflicting frames at slightly different times.
+//
+// Every node sends a heartbeat once per second. The node with the highest id
+// heard from within the last couple of seconds, including ourselves, is the
+// leader; if it goes silent, the next one takes over without any further
+// negotiation.
+//
+// The leader publishes the frame of the next minute ahead of time, which the
+// followers send instead of their own encoding. Its heartbeats are the
+// common time base: followers estimate the offset of their system clock from
+// the minimum difference between receive and send timestamps, so the error
+// is the one-way network delay (tens of microseconds on a LAN).
+//
+// Up to kMaxNodes other nodes are tracked; more are ignored until one of
+// them goes silent.
+//
+// Messages are in host byte order (little endian on all supported boards).
+class Cluster {
+ public:
+  // Amplitude changes per second that fit in a frame.
+  static constexpr int kMaxChanges = 4;
+
+  // Other nodes we keep track of.
+  static constexpr int kMaxNodes = 16;
+
+  // One minute as published by the leader. Fixed size, so that taking it
+  // on the transmit thread doesn't allocate.
+  struct Frame {
+    struct Second {
+      TimeSignalSource::ModulationSpan modulation() const {
+        return {changes, changes + count};
+      }
+
+      int count = 0;
+      ModulationDuration changes[kMaxChanges];
+    };
+
+    // Fill second "s" from "modulation". Returns 'false' if it has more
+    // changes than fit.
+    bool SetSecond(int s, TimeSignalSource::ModulationSpan modulation);
+
+    time_t minute = 0;         // Start of the minute on the leader's clock.
+    time_t transmit_time = 0;  // Time sent, as given to PrepareMinute().
+    char station[16] = "";
+    Second seconds[60];
+  };
+
+  // Nodes are ordered by id for the leader election.
+  explicit Cluster(uint32_t node_id);
+  ~Cluster();
+
+  // Join the group "<multicast-address>:<port>[/<interface>]", e.g.
+  // 239.255.77.77:7777 or 239.255.77.77:7777/lo.
+  // Returns 'false' on failure.
+  bool Open(const char *group);
+
+  // Readable whenever there are messages to be handled.
+  int fd() const { return fd_; }
+
+  // Receive all pending messages without waiting.
+  void HandleMessages();
+
+  // Tell the others that we are around; call about once per second.
+  void SendHeartbeat(const char *station);
+
+  uint32_t node_id() const { return node_id_; }
+  uint32_t leader_id();
+  bool IsLeader() { return leader_id() == node_id_; }
+
+  // As leader, send the frame of an upcoming minute. Returns 'false' if it
+  // could not be sent.
+  bool PublishFrame(const Frame &frame);
+
+  // As follower, get the frame the leader published for the given minute.
+  // Returns 'true' if "frame" has been filled. Frames with power values we
+  // don't know or seconds longer than a second are never taken.
+  bool TakeFrame(time_t minute, Frame *frame);
+
+  // Returns 'true' if we have enough heartbeats from the current leader to
+  // know the offset of our system clock to its.
+  bool have_time_base();
+
+  // Our system clock minus the leader's.
+  int64_t leader_offset_ns() const { return leader_offset_ns_; }
+
+ private:
+  static constexpr int kTimeSamples = 8;
+
+  void HandleMessage(const uint8_t *buffer, size_t size,
+                     const struct timespec &received);
+  void AddTimeSample(int64_t offset_ns);
+  void NoteHeard(uint32_t node_id, int64_t now_ns);
+  void ForgetSilentNodes(int64_t now_ns);
+
+  const uint32_t node_id_;
+  int fd_ = -1;
+  struct sockaddr_in group_addr_ = {};
+
+  // Nodes heard from recently; fixed size, as it is updated on the transmit
+  // thread.
+  struct Node {
+    uint32_t id;
+    int64_t last_heard_ns;  // CLOCK_MONOTONIC
+  };
+  Node nodes_[kMaxNodes];
+  int node_count_ = 0;
+
+  // Receive minus send timestamp of the last heartbeats of the leader.
+  uint32_t time_base_id_ = 0;
+  int64_t time_samples_[kTimeSamples];
+  int time_sample_count_ = 0;
+  int next_time_sample_ = 0;
+  int64_t leader_offset_ns_ = 0;
+
+  Frame frames_[2];  // Indexed by minute parity.
+  uint32_t frame_sender_[2] = {};
+};
+
+#endif  // CLUSTER_H
@@ -0,0 +1,134 @@
+// -*- mode: c++; c-basic-offset: 2; indent-tabs-mode: nil; -*-
+// Part of txtempus, a LF time signal transmitter.
+// Copyright (C) 2018 Henner Zeller <h.zeller@acm.org>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#ifndef CONTROL_SOCKET_H
+#define CONTROL_SOCKET_H
+
+#include <atomic>
+#include <cstdint>
+#include <ctime>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#include "time-signal-source.h"
+
+// A unix domain socket to query the status of a running txtempus and to
+// change its settings without restarting. It is served by its own thread
+// with normal scheduling priority; the realtime transmit loop only ever
+// exchanges data with it through the non-blocking PublishStatus(),
+// TakeChanges() and RetireSource(). Time sources are created and destroyed
+// in the socket thread, so switching stations doesn't allocate or free
+// memory in the transmit loop.
+//
+// The protocol is line based; each request line gets a reply terminated
+// by an empty line:
+//   status                 : Current frame, next edge, error counters.
+//   station <name>         : Switch time service at the next minute.
+//   offset <minutes>       : Transmit time offset from local (like -z).
+//   carrier-only <on|off>  : Switch carrier-only mode.
+class ControlSocket {
+ public:
+  // Snapshot of what the transmit loop is doing.
+  struct Status {
+    char station[16] = "";
+    int carrier_hz = 0;
+    bool carrier_only = false;
+    int offset_minutes = 0;
+    time_t transmit_minute = 0;  // Time sent in the current frame.
+    int second = 0;
+    struct timespec next_edge = {};
+    int64_t edges = 0;
+    int64_t late_edges = 0;
+    int64_t max_lateness_us = 0;
+    int64_t dropped_log_messages = 0;
+
+    // Edges later than the lateness budget, overall and per station.
+    int64_t missed_edges = 0;
+    static constexpr int kMaxStations = 8;
+    struct StationMisses {
+      char station[16];
+      int64_t missed;
+    } missed_by_station[kMaxStations] = {};
+    int stations = 0;  // Entries used in missed_by_station.
+
+    // System clock quality as of the start of the minute (with -q).
+    bool clock_good = true;
+    int64_t clock_max_error_us = 0;
+  };
+
+  // Changes requested by a client, to be applied at the next minute.
+  struct Changes {
+    std::unique_ptr<TimeSignalSource> time_source;  // nullptr: no change.
+    char station[16] = "";
+    bool change_offset = false;
+    int offset_minutes = 0;
+    bool change_carrier_only = false;
+    bool carrier_only = false;
+  };
+
+  using SourceFactory = std::unique_ptr<TimeSignalSource> (*)(const char *);
+
+  // The factory is used to create new time sources outside the transmit
+  // loop.
+  explicit ControlSocket(SourceFactory factory);
+  ~ControlSocket();
+
+  // Create socket at given path and start serving in a separate thread.
+  // Returns 'false' if the socket could not be created.
+  bool Start(const char *path);
+
+  // Publish the current status. Never blocks; if the status is just being
+  // read by a client, this update is skipped.
+  void PublishStatus(const Status &status);
+
+  // Take pending changes if there are any. Never blocks. Returns 'true' if
+  // "changes" has been filled.
+  bool TakeChanges(Changes *changes);
+
+  // Hand back a time source replaced by one from TakeChanges(), to be
+  // destroyed in the socket thread. Never blocks.
+  void RetireSource(std::unique_ptr<TimeSignalSource> source);
+
+ private:
+  void Run();
+  void FreeRetiredSources();
+  void HandleClient(int fd);
+  std::string HandleRequest(char *line);
+
+  const SourceFactory factory_;
+  std::string path_;
+  int listen_fd_ = -1;
+  int stop_fd_ = -1;    // eventfd to wake up the serving thread on shutdown.
+  int retire_fd_ = -1;  // eventfd signalling sources to free.
+  std::thread thread_;
+
+  std::mutex status_lock_;
+  Status status_;
+
+  std::mutex changes_lock_;
+  Changes changes_;
+  bool have_changes_ = false;
+
+  // Sources handed back by the transmit loop; changes happen at most once a
+  // minute, so there is always a free slot.
+  static constexpr int kRetiredSlots = 4;
+  std::atomic<TimeSignalSource *> retired_[kRetiredSlots] = {};
+};
+
+#endif  // CONTROL_SOCKET_H
@@ -0,0 +1,60 @@
+// -*- mode: c++; c-basic-offset: 2; indent-tabs-mode: nil; -*-
+// Part of txtempus, a LF time signal transmitter.
+// Copyright (C) 2018 Henner Zeller <h.zeller@acm.org>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#ifndef CYCLE_COUNTER_H
+#define CYCLE_COUNTER_H
+
+#include <cstdint>
+#include <ctime>
+
+// Timestamps with as little overhead as possible to measure short code
+// paths. On 64 bit ARM, this is the virtual counter of the generic timer,
+// which can be read from user space without a system call; elsewhere it
+// falls back to CLOCK_MONOTONIC_RAW in nanoseconds.
+inline uint64_t ReadCycleCounter() {
+#if defined(__aarch64__)
+  uint64_t value;
+  // The isb keeps the read from being done ahead of the measured code.
+  asm volatile("isb; mrs %0, cntvct_el0" : "=r"(value) : : "memory");
+  return value;
+#else
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC_RAW, &ts);
+  return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+#endif
+}
+
+// Ticks per second of ReadCycleCounter().
+inline uint64_t CycleCounterFrequency() {
+#if defined(__aarch64__)
+  uint64_t value;
+  asm volatile("mrs %0, cntfrq_el0" : "=r"(value));
+  return value;
+#else
+  return 1000000000ULL;
+#endif
+}
+
+inline const char *CycleCounterName() {
+#if defined(__aarch64__)
+  return "cntvct_el0";
+#else
+  return "CLOCK_MONOTONIC_RAW";
+#endif
+}
+
+#endif  // CYCLE_COUNTER_H
@@ -0,0 +1,108 @@
+// -*- mode: c++; c-basic-offset: 2; indent-tabs-mode: nil; -*-
+// Part of txtempus, a LF time signal transmitter.
+// Copyright (C) 2018 Henner Zeller <h.zeller@acm.org>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#ifndef EDGE_EXPORT_H
+#define EDGE_EXPORT_H
+
+#include <cstddef>
+#include <cstdint>
+#include <ctime>
+#include <memory>
+#include <string_view>
+#include <vector>
+
+#include "carrier-power.h"
+#include "edge-schedule.h"
+
+// Writes the exact edge timeline of a transmission to a file, for waveform
+// viewers and for diffing the output of different versions or platforms:
+//   VCD (value change dump, e.g. for GTKWave) for filenames ending in .vcd,
+//   JSON lines, one record per minute and per edge, otherwise.
+// The output only depends on the transmitted minutes, not on when or where
+// it was created.
+//
+// Records are formatted into a large buffer that is written out with few
+// write() calls, so this keeps up with simulating many minutes quickly.
+class EdgeExporter {
+ public:
+  enum class Format { VCD, JSON_LINES };
+
+  EdgeExporter();
+  ~EdgeExporter();
+
+  // Create the file; "-" is stdout, written as JSON lines.
+  // Returns 'false' on failure.
+  bool Open(const char *filename);
+
+  Format format() const { return format_; }
+
+  // Describe the transmission; call once before the first minute.
+  void Begin(const char *station, int carrier_hz, time_t first_minute,
+             bool with_phase);
+
+  // Export one minute, starting at "minute", in which "transmit_time" is
+  // sent. The symbols of each second (see
+  // TimeSignalSource::GetSymbolForSecond()) and the edges as returned by
+  // AppendMinuteEdges(). Minutes have to be added in chronological order.
+  void AddMinute(time_t minute, time_t transmit_time, const int symbols[60],
+                 const std::vector<ModulationEdge> &edges);
+
+  // Write out everything and close the file. Returns 'false' if any
+  // write failed.
+  bool Finish();
+
+  // Number of edges exported so far.
+  int64_t edges() const { return edges_; }
+
+ private:
+  static constexpr size_t kBufferSize = 1 << 20;
+
+  void AddVCDMinute(int64_t minute_ns, time_t transmit_time,
+                    const int symbols[60],
+                    const std::vector<ModulationEdge> &edges);
+  void AddJSONMinute(time_t minute, time_t transmit_time,
+                     const int symbols[60],
+                     const std::vector<ModulationEdge> &edges);
+  void VCDTime(int64_t t);
+  void VCDEdge(int64_t minute_ns, const ModulationEdge &edge);
+
+  void Append(std::string_view s);
+  void AppendInt(int64_t value);
+  void AppendBinary(uint64_t value);
+  void AppendDouble(double value);
+  void Flush();
+
+  int fd_ = -1;
+  bool close_fd_ = false;
+  bool write_error_ = false;
+  const char *filename_ = nullptr;
+  Format format_ = Format::JSON_LINES;
+  std::unique_ptr<char[]> buffer_;
+  size_t fill_ = 0;
+
+  time_t first_minute_ = 0;
+  int64_t edges_ = 0;
+
+  // Last values written to the VCD file; only changes are dumped.
+  int64_t vcd_time_ = 0;
+  CarrierPower vcd_power_ = CarrierPower::HIGH;
+  bool vcd_power_known_ = false;
+  double vcd_phase_ = 0;
+  int vcd_symbol_ = -2;
+};
+
+#endif  // EDGE_EXPORT_H
@@ -0,0 +1,44 @@
+// -*- mode: c++; c-basic-offset: 2; indent-tabs-mode: nil; -*-
+// Part of txtempus, a LF time signal transmitter.
+// Copyright (C) 2018 Henner Zeller <h.zeller@acm.org>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#ifndef EDGE_SCHEDULE_H
+#define EDGE_SCHEDULE_H
+
+#include <cstdint>
+#include <ctime>
+#include <vector>
+
+#include "carrier-power.h"
+#include "time-signal-source.h"
+
+// A change of the carrier within a minute: either its power or its phase.
+struct ModulationEdge {
+  enum class Type { POWER, PHASE };
+
+  int64_t offset_ns;  // Since the beginning of the minute.
+  Type type;
+  CarrierPower power;    // For POWER edges.
+  double phase_degrees;  // For PHASE edges.
+};
+
+// Prepare the given minute and append all its edges in chronological order.
+// Each second starts with a power edge; phase changes are only included
+// "with_phase". Edges at the same time keep the power change first.
+void AppendMinuteEdges(TimeSignalSource *source, time_t minute,
+                       bool with_phase, std::vector<ModulationEdge> *edges);
+
+#endif  // EDGE_SCHEDULE_H
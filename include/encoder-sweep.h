@@ -0,0 +1,42 @@
+// -*- mode: c++; c-basic-offset: 2; indent-tabs-mode: nil; -*-
+// Part of txtempus, a LF time signal transmitter.
+// Copyright (C) 2018 Henner Zeller <h.zeller@acm.org>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+
+#ifndef ENCODER_SWEEP_H
+#define ENCODER_SWEEP_H
+
+#include <cstdint>
+#include <ctime>
+
+struct SweepResult {
+  int64_t minutes = 0;    // Minutes checked.
+  int64_t failures = 0;   // Minutes not decoding to the time they encode.
+  int64_t ambiguous = 0;  // Decoded differently, but with identical frame.
+};
+
+// Encode every minute in [from, to) with the given service, decode it with
+// the reference decoder (frame-decoder.h) and check that we get the same
+// minute back. The work is split between "workers" processes, in the time
+// zone currently set. The first "max_reports" failures are printed.
+//
+// Some time codes can't distinguish all minutes, e.g. JJY has no DST flag,
+// so in the hour repeated at the end of DST the frames are the same; these
+// are counted as ambiguous, not as failure.
+SweepResult SweepEncoder(const char *service, time_t from, time_t to,
+                         int workers, int max_reports);
+
+#endif  // ENCODER_SWEEP_H
@@ -0,0 +1,42 @@
+// -*- mode: c++; c-basic-offset: 2; indent-tabs-mode: nil; -*-
+// Part of txtempus, a LF time signal transmitter.
+// Copyright (C) 2018 Henner Zeller <h.zeller@acm.org>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+
+#ifndef ENVELOPE_DETECTOR_H
+#define ENVELOPE_DETECTOR_H
+
+#include <vector>
+
+class CaptureFile;
+
+// Frequency at which a carrier shows up in a capture. For complex captures,
+// "frequency_hz" is relative to the center frequency. Frequencies beyond
+// the Nyquist limit fold back like they do when sampling without an
+// anti-aliasing filter, so e.g. a 77.5 kHz carrier can be analyzed in a
+// 48 kHz recording at 18.5 kHz.
+double AliasedFrequency(double frequency_hz, int sample_rate, bool complex);
+
+// Amplitude of the carrier at "frequency_hz" (as returned by
+// AliasedFrequency()) for each consecutive block of "block_frames" samples
+// of the capture, computed with the Goertzel algorithm. Several blocks are
+// processed in parallel SIMD lanes, and the capture is split between
+// "threads" threads.
+std::vector<float> ComputeEnvelope(const CaptureFile &capture,
+                                   double frequency_hz, int block_frames,
+                                   int threads);
+
+#endif  // ENVELOPE_DETECTOR_H
@@ -0,0 +1,95 @@
+// -*- mode: c++; c-basic-offset: 2; indent-tabs-mode: nil; -*-
+// Part of txtempus, a LF time signal transmitter.
+// Copyright (C) 2018 Henner Zeller <h.zeller@acm.org>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#ifndef EVENT_LOOP_H
+#define EVENT_LOOP_H
+
+#include <ctime>
+#include <functional>
+#include <initializer_list>
+#include <memory>
+#include <vector>
+
+// Single-threaded event loop: the transmit loop waits for its next edge
+// deadline in epoll, while signals, clock changes and any other file
+// descriptor events are dispatched as they come in.
+//
+// Deadlines are absolute CLOCK_REALTIME timerfd timeouts; signals are
+// received through a signalfd.
+class EventLoop {
+ public:
+  EventLoop();
+  ~EventLoop();
+
+  // Set up the loop and receive the given signals through it. They are
+  // blocked for the whole process, so this needs to be called before any
+  // other thread is started.
+  // Returns 'false' on failure.
+  bool Init(std::initializer_list<int> signals);
+
+  // Handler to be called for each of the signals given in Init().
+  void OnSignal(std::function<void(int signo)> handler) {
+    signal_handler_ = std::move(handler);
+  }
+
+  // Handler to be called when the realtime clock is set (e.g. a large NTP
+  // step). A pending WaitUntil() keeps waiting for its absolute deadline.
+  void OnClockChange(std::function<void()> handler) {
+    clock_change_handler_ = std::move(handler);
+  }
+
+  // Call "handler" whenever "fd" becomes readable.
+  bool AddReadHandler(int fd, std::function<void()> handler);
+
+  // Wait until the given absolute CLOCK_REALTIME time, dispatching all
+  // other events in the meantime. Returns 'false' if the loop is stopped.
+  bool WaitUntil(const struct timespec &deadline);
+
+  // Dispatch events that are already pending without waiting.
+  // Returns 'false' if the loop is stopped.
+  bool DispatchPending();
+
+  // Make the current and all following WaitUntil() return 'false' right
+  // away. Typically called from a handler.
+  void Stop() { stopped_ = true; }
+
+ private:
+  struct Source {
+    int fd;
+    std::function<void()> handler;
+  };
+
+  Source *AddSource(int fd, std::function<void()> handler);
+  void Dispatch(int timeout_ms);
+  void ArmTimer();
+  void HandleTimer();
+  void HandleSignal();
+
+  int epoll_fd_ = -1;
+  int timer_fd_ = -1;
+  int signal_fd_ = -1;
+  std::vector<std::unique_ptr<Source>> sources_;
+
+  std::function<void(int)> signal_handler_;
+  std::function<void()> clock_change_handler_;
+
+  struct timespec deadline_ = {};
+  bool deadline_reached_ = false;
+  bool stopped_ = false;
+};
+
+#endif  // EVENT_LOOP_H
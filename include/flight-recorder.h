@@ -0,0 +1,134 @@
+// -*- mode: c++; c-basic-offset: 2; indent-tabs-mode: nil; -*-
+// Part of txtempus, a LF time signal transmitter.
+// Copyright (C) 2018 Henner Zeller <h.zeller@acm.org>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#ifndef FLIGHT_RECORDER_H
+#define FLIGHT_RECORDER_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+// Record of what was transmitted, kept in a fixed size ring file, so that
+// we can find out later what a receiver saw, e.g. overnight.
+//
+// The file is mapped shared and records are written with plain stores, so
+// recording an edge is no system call; the kernel writes the pages back.
+// As the data lives in the page cache, it survives a crash of txtempus.
+//
+// Layout, in host byte order:
+//   FlightRecorderHeader
+//   FlightRecord records[capacity]
+// Record number n (counting from 0 since the file was created) is in slot
+// n % capacity; its sequence field is (uint32_t)(n + 1) once complete.
+
+static constexpr char kFlightRecorderMagic[8] = {'T', 'X', 'F', 'L',
+                                                 'I', 'G', 'H', 'T'};
+static constexpr uint32_t kFlightRecorderByteOrder = 0x01020304;
+
+struct FlightRecorderHeader {
+  char magic[8];        // kFlightRecorderMagic
+  uint32_t byte_order;  // kFlightRecorderByteOrder
+  uint32_t record_size;
+  uint64_t capacity;  // Number of record slots.
+  uint64_t count;     // Records written so far.
+  char reserved[32];
+};
+static_assert(sizeof(FlightRecorderHeader) == 64, "Unexpected padding");
+
+enum class FlightEdge : uint8_t {
+  AMPLITUDE = 'A',  // value: CarrierPower
+  PHASE = 'P',      // First phase of the second; value: 1/10 degrees
+  BLANK = 'B',      // Missed edge, carrier only for rest of minute.
+};
+
+// Bits of FlightRecord::clock_status
+enum FlightClockStatus : uint8_t {
+  kFlightPPSUsed = 0x01,     // Seconds aligned to a PPS source ...
+  kFlightPPSLocked = 0x02,   // ... which is locked.
+  kFlightMissed = 0x04,      // Edge was later than the lateness budget.
+  kFlightClockGated = 0x08,  // Clock not good enough: carrier only.
+};
+
+struct FlightRecord {
+  int64_t intended_ns;  // True time the edge is for (PPS, leader aligned).
+  int32_t late_ns;      // Actual minus intended time (saturated).
+  uint32_t frame;       // Minute being transmitted (time_t).
+  int16_t value;        // Depending on edge.
+  FlightEdge edge;
+  uint8_t clock_status;  // FlightClockStatus bits.
+  uint32_t sequence;     // Record number + 1, written last.
+};
+static_assert(sizeof(FlightRecord) == 24, "Unexpected padding");
+
+class FlightRecorder {
+ public:
+  // Six days of DCF77 with its two edges per second, four with phase
+  // modulation.
+  static constexpr uint64_t kDefaultCapacity = 1 << 20;
+
+  FlightRecorder() = default;
+  ~FlightRecorder();
+
+  // Open or create the ring file. An existing file keeps its records and
+  // capacity; a new one gets "capacity" slots. All pages are faulted in
+  // right away. Returns 'false' on failure.
+  bool Open(const char *filename, uint64_t capacity = kDefaultCapacity);
+
+  // Map an existing file read-only, e.g. to dump it.
+  bool OpenReadOnly(const char *filename);
+
+  bool is_open() const { return header_ != nullptr; }
+  const FlightRecorderHeader &header() const { return *header_; }
+
+  // Record slot for record number n; check its sequence to see if it is
+  // complete.
+  const FlightRecord &record(uint64_t n) const {
+    return reinterpret_cast<const FlightRecord *>(header_ + 1)
+        [n % header_->capacity];
+  }
+
+  void Add(int64_t intended_ns, int64_t late_ns, uint32_t frame,
+           FlightEdge edge, int16_t value, uint8_t clock_status) {
+    if (!records_) return;
+    const uint64_t n = header_->count;
+    FlightRecord *r = &records_[n % header_->capacity];
+    r->sequence = 0;  // Incomplete until we're done.
+    std::atomic_signal_fence(std::memory_order_release);
+    r->intended_ns = intended_ns;
+    r->late_ns = late_ns > INT32_MAX   ? INT32_MAX
+                 : late_ns < INT32_MIN ? INT32_MIN
+                                       : late_ns;
+    r->frame = frame;
+    r->value = value;
+    r->edge = edge;
+    r->clock_status = clock_status;
+    std::atomic_signal_fence(std::memory_order_release);
+    r->sequence = (uint32_t)(n + 1);
+    header_->count = n + 1;
+  }
+
+ private:
+  bool Map(int fd, size_t size, bool writable, bool created,
+           const char *filename);
+
+  void *map_ = nullptr;
+  size_t map_size_ = 0;
+  FlightRecorderHeader *header_ = nullptr;
+  FlightRecord *records_ = nullptr;  // Only set if writable.
+};
+
+#endif  // FLIGHT_RECORDER_H
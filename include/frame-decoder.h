@@ -0,0 +1,63 @@
+// -*- mode: c++; c-basic-offset: 2; indent-tabs-mode: nil; -*-
+// Part of txtempus, a LF time signal transmitter.
+// Copyright (C) 2018 Henner Zeller <h.zeller@acm.org>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+
+#ifndef FRAME_DECODER_H
+#define FRAME_DECODER_H
+
+#include <ctime>
+#include <memory>
+
+#include "carrier-power.h"
+#include "time-signal-source.h"
+
+// Content of a decoded minute frame.
+struct DecodedMinute {
+  // The time the transmitter prepared the minute for, i.e. what it was given
+  // in TimeSignalSource::PrepareMinute().
+  time_t minute;
+
+  // Daylight saving time flag as sent, -1 if the service doesn't send one.
+  int dst;
+};
+
+// Decoders for the amplitude modulated time code of each service, working
+// like a receiver would: sampling the carrier at fixed times into each
+// second and checking markers, parity and calendar consistency.
+//
+// These are written from the service specifications independently of the
+// encoders, so that they can be used to check what txtempus actually sends.
+class FrameDecoder {
+ public:
+  virtual ~FrameDecoder() = default;
+
+  // Decode the minute from the modulation of its 60 seconds, seconds[0]
+  // being the first second of the minute. Two-digit years are expanded to
+  // the century closest to "reference".
+  // Returns 'false' if this is not a valid frame.
+  virtual bool DecodeMinute(const TimeSignalSource::ModulationSpan *seconds,
+                            time_t reference, DecodedMinute *result) = 0;
+};
+
+// Create the decoder for the given service name, e.g. "DCF77" (case
+// insensitive). Returns nullptr if there is no such service.
+std::unique_ptr<FrameDecoder> CreateFrameDecoder(const char *name);
+
+// Carrier power at the given time into the second.
+CarrierPower PowerAt(TimeSignalSource::ModulationSpan modulation, int ms);
+
+#endif  // FRAME_DECODER_H
@@ -0,0 +1,82 @@
+// -*- mode: c++; c-basic-offset: 2; indent-tabs-mode: nil; -*-
+// Part of txtempus, a LF time signal transmitter.
+// Copyright (C) 2018 Henner Zeller <h.zeller@acm.org>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#ifndef GENERIC_CONTROL_H
+#define GENERIC_CONTROL_H
+
+#include <cstdint>
+#include <string>
+
+#include "carrier-power.h"
+#include "hardware-control.h"
+
+// -- Implementation for any board with a GPIO character device and sysfs PWM.
+//
+// The attenuation pin is requested once through the GPIO v2 character
+// device API as open-drain output, so switching it is a single ioctl().
+// The carrier is generated by a channel of /sys/class/pwm.
+//
+// The defaults are chosen at configure time (see cmake/generic-control.cmake),
+// but can be overridden with environment variables, which is e.g. useful to
+// point txtempus to a gpio-sim chip and a fake PWM directory:
+//   TXTEMPUS_GPIO_CHIP    : GPIO character device, e.g. /dev/gpiochip0, or
+//                           'none' to only drive the PWM (for testing).
+//   TXTEMPUS_GPIO_LINE    : Line offset of the attenuation pin on that chip.
+//   TXTEMPUS_PWM_CHIP     : PWM chip directory, e.g. /sys/class/pwm/pwmchip0
+//   TXTEMPUS_PWM_CHANNEL  : PWM channel on that chip.
+class GenericControl final : public HardwareControl {
+ public:
+  ~GenericControl() override;
+
+  const char *platform() const override { return "generic"; }
+
+  bool Init() override;
+
+  // Set PWM frequency as close as possible to the requested one.
+  // Returns the approximate frequency it could configure or -1 if that was
+  // not possible.
+  double StartClock(double frequency_hertz) override;
+  void StopClock() override;
+
+  // Switches the output of the currently running clock.
+  void EnableClockOutput(bool on) override;
+
+  void SetTxPower(CarrierPower power) override;
+
+  // Enabling the PWM through sysfs is not synchronized to the carrier.
+  int64_t KeyingLatencyNs() const override { return 0; }
+
+  // The sysfs PWM interface is too slow for phase modulation.
+  bool SetCarrierPhase(double degrees) override { return false; }
+
+ private:
+  bool RequestAttenuationLine(const char *chip, int line);
+  bool OpenPwmChannel(const std::string &chip_dir, int channel);
+
+  // Pull down the attenuation pin (true) or leave it high-Z (false).
+  void SetAttenuation(bool attenuate);
+
+  int line_fd_ = -1;        // Line request on the GPIO character device.
+  int pwm_enable_fd_ = -1;  // Kept open, toggled with pwrite().
+  std::string pwm_dir_;     // e.g. /sys/class/pwm/pwmchip0/pwm0
+
+  bool clock_running_ = false;
+  bool output_enabled_ = false;
+  bool attenuated_ = false;
+};
+
+#endif  // GENERIC_CONTROL_H
@@ -0,0 +1,60 @@
+// -*- mode: c++; c-basic-offset: 2; indent-tabs-mode: nil; -*-
+// Part of txtempus, a LF time signal transmitter.
+// Copyright (C) 2018 Henner Zeller <h.zeller@acm.org>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#ifndef HARDWARE_BACKENDS_H
+#define HARDWARE_BACKENDS_H
+
+// The hardware backends compiled in; CMakeLists.txt defines TXTEMPUS_HAVE_*
+// for each of them.
+
+#include "hardware-control.h"
+
+#ifdef TXTEMPUS_HAVE_RPI
+#include "rpi/rpi-control.h"
+#endif
+#ifdef TXTEMPUS_HAVE_SUNXIH3
+#include "sunxih3/sunxih3-control.h"
+#endif
+#ifdef TXTEMPUS_HAVE_GENERIC
+#include "generic/generic-control.h"
+#endif
+#ifdef TXTEMPUS_HAVE_JETSON
+#include "jetson/jetson-control.h"
+#endif
+
+// Call "f" with "hw" as pointer to its concrete backend type, so that a
+// function template instantiated per backend, such as the transmit loop,
+// calls the hardware directly and can inline it instead of going through
+// the virtual functions. Anything else is passed on as HardwareControl.
+template <typename F>
+auto DispatchBackend(HardwareControl *hw, F &&f) {
+#ifdef TXTEMPUS_HAVE_RPI
+  if (auto *rpi = dynamic_cast<RpiControl *>(hw)) return f(rpi);
+#endif
+#ifdef TXTEMPUS_HAVE_SUNXIH3
+  if (auto *h3 = dynamic_cast<SunxiH3Control *>(hw)) return f(h3);
+#endif
+#ifdef TXTEMPUS_HAVE_GENERIC
+  if (auto *generic = dynamic_cast<GenericControl *>(hw)) return f(generic);
+#endif
+#ifdef TXTEMPUS_HAVE_JETSON
+  if (auto *jetson = dynamic_cast<JetsonControl *>(hw)) return f(jetson);
+#endif
+  return f(hw);
+}
+
+#endif  // HARDWARE_BACKENDS_H
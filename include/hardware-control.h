@@ -19,45 +19,78 @@
 #ifndef HARDWARE_CONTROL_H
 #define HARDWARE_CONTROL_H
 
+#include <cstdint>
+#include <ctime>
 #include <memory>
 
 #include "carrier-power.h"
 
+// Interface of the hardware backends. All backends that can be built are
+// compiled in; the one for the board we're running on is chosen at startup.
+//
+// To add a new platform support:
+// 1. Add include/[new_platform_name]/[new_platform_name]-control.h with a
+//    final class implementing this interface; keep the methods used while
+//    transmitting (SetTxPower(), SetCarrierPhase()) inline where possible.
+// 2. Add cmake/[new_platform_name]-control.cmake file and set
+//    platform-specific configuration:
+//    SRC_FILES: source files
+//    PLATFORM_DEPENDENCIES: dependencies
+// 3. Append [new_platform_name] to "SUPPORTED_PLATFORMS" in CMakeLists.txt,
+//    and add the backend to Create() and DetectPlatform() in
+//    hardware-control.cc as well as to DispatchBackend() in
+//    hardware-backends.h.
 class HardwareControl {
  public:
-  // To add a new platform support:
-  // 1. Add include/[new_platform_name]/hardware-control-implementation.h file
-  // and
-  //    implement "HardwareControl::Implementation" class for the platform.
-  // 2. Add cmake/[new_platform_name]-control.cmake file and set
-  // platform-specific configuration:
-  //    SRC_FILES: source files
-  //    INCLUDE_DIRS: include directories
-  //    PLATFORM_DEPENDENCIES: dependencies
-  // 3. Append [new_platform_name] to "SUPPORTED_PLATFORMS" in CMakeLists.txt.
-  class Implementation;
-
-  HardwareControl();
-  ~HardwareControl();
+  virtual ~HardwareControl() = default;
+
+  // Platform of the board we're running on, judging from the device tree or
+  // /proc/cpuinfo, e.g. "rpi". The environment variable TXTEMPUS_PLATFORM
+  // overrides it. Falls back to "generic" if nothing else fits.
+  static const char *DetectPlatform();
+
+  // Comma separated list of the platforms compiled in.
+  static const char *AvailablePlatforms();
+
+  // Create the backend for the given platform; nullptr if it is not compiled
+  // in. Doesn't touch the hardware before Init().
+  static std::unique_ptr<HardwareControl> Create(const char *platform);
+
+  // Name of the platform of this backend.
+  virtual const char *platform() const = 0;
 
   // Initialize before use. Returns 'true' if successful, 'false' otherwise
   // (e.g. due to a permission problem).
-  bool Init();
+  virtual bool Init() = 0;
 
   // Set frequency output as close as possible to the requested one.
   // Returns the approximate frequency it could configure or -1 if that was
   // not possible.
-  double StartClock(double frequency_hertz);
-  void StopClock();
+  virtual double StartClock(double frequency_hertz) = 0;
+  virtual void StopClock() = 0;
 
   // Switches the output of the currently running clock.
-  void EnableClockOutput(bool b);
+  virtual void EnableClockOutput(bool b) = 0;
+
+  virtual void SetTxPower(CarrierPower power) = 0;
+
+  // Switching the carrier on or off waits for the end of a carrier cycle
+  // where the hardware allows it. This is the average time SetTxPower() takes
+  // to do that, to be subtracted from the deadline by the caller; 0 if the
+  // platform can't key synchronized to the carrier.
+  virtual int64_t KeyingLatencyNs() const = 0;
 
-  void SetTxPower(CarrierPower power);
+  // Shift the carrier phase to the given value relative to the unmodulated
+  // carrier. Returns 'false' if the platform can't do phase modulation.
+  virtual bool SetCarrierPhase(double degrees) = 0;
 
- private:
-  // pimpl idiom to hide platform-specific information
-  std::unique_ptr<Implementation> pimpl;
+  // A phase shift can take a while, e.g. if it is done by detuning the
+  // carrier. Then SetCarrierPhase() only starts it, PhaseShiftEnd() returns
+  // 'true' and the system time (CLOCK_REALTIME) at which the caller should
+  // call FinishPhaseShift(). Being late there is made up for with the next
+  // shift.
+  virtual bool PhaseShiftEnd(struct timespec *end) const { return false; }
+  virtual void FinishPhaseShift() {}
 };
 
 #endif  // HARDWARE_CONTROL_H
@@ -16,19 +16,23 @@
 // You should have received a copy of the GNU General Public License
 // along with this program.  If not, see <https://www.gnu.org/licenses/>.
 
-#ifndef JETSON_HARDWARE_CONTROL_IMPLEMENTATION_H
-#define JETSON_HARDWARE_CONTROL_IMPLEMENTATION_H
+#ifndef JETSON_CONTROL_H
+#define JETSON_CONTROL_H
 
 #define __STDC_FORMAT_MACROS
 
 #include <JetsonGPIO.h>
 
+#include <cstdint>
+#include <iostream>
+#include <memory>
+
 #include "carrier-power.h"
 #include "hardware-control.h"
 
 // -- Implementation for Nvidia Jetson Series --
 
-class HardwareControl::Implementation {
+class JetsonControl final : public HardwareControl {
  private:
   int carrierPin;
   int attenuationPin;
@@ -37,7 +41,9 @@ class HardwareControl::Implementation {
   std::unique_ptr<GPIO::PWM> pwm;
 
  public:
-  bool Init() {
+  const char *platform() const override { return "jetson"; }
+
+  bool Init() override {
     if (isInitialized) return carrierPin > 0;
 
     isInitialized = true;
@@ -67,7 +73,7 @@ class HardwareControl::Implementation {
     return true;
   }
 
-  double StartClock(double frequency_hertz) {
+  double StartClock(double frequency_hertz) override {
     if (pwm == nullptr)
       pwm = std::unique_ptr<GPIO::PWM>(
           new GPIO::PWM(carrierPin, frequency_hertz));
@@ -78,14 +84,14 @@ class HardwareControl::Implementation {
     return frequency_hertz;
   }
 
-  void StopClock() {
+  void StopClock() override {
     if (pwm) {
       pwm->stop();
       isOn = false;
     }
   }
 
-  void EnableClockOutput(bool on) {
+  void EnableClockOutput(bool on) override {
     if (on == isOn) return;
 
     if (on) {
@@ -96,7 +102,7 @@ class HardwareControl::Implementation {
     }
   }
 
-  void SetTxPower(CarrierPower power) {
+  void SetTxPower(CarrierPower power) override {
     switch (power) {
       case CarrierPower::LOW:
         EnableClockOutput(true);
@@ -112,9 +118,15 @@ class HardwareControl::Implementation {
     }
   }
 
+  // JetsonGPIO's software PWM is not synchronized to anything.
+  int64_t KeyingLatencyNs() const override { return 0; }
+
+  // Phase modulation not implemented.
+  bool SetCarrierPhase(double degrees) override { return false; }
+
   void ApplyAttenuation() { GPIO::output(attenuationPin, GPIO::HIGH); }
 
   void StopAttenuation() { GPIO::output(attenuationPin, GPIO::LOW); }
 };
 
-#endif  // JETSON_HARDWARE_CONTROL_IMPLEMENTATION_H
+#endif  // JETSON_CONTROL_H
@@ -0,0 +1,51 @@
+// -*- mode: c++; c-basic-offset: 2; indent-tabs-mode: nil; -*-
+// Part of txtempus, a LF time signal transmitter.
+// Copyright (C) 2018 Henner Zeller <h.zeller@acm.org>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#ifndef LATENCY_STATS_H
+#define LATENCY_STATS_H
+
+#include <cstdint>
+#include <cstdio>
+#include <vector>
+
+// Collects latency samples and reports their distribution. Space for the
+// expected number of samples is reserved up front, so that adding them
+// while measuring does not allocate.
+class LatencyStats {
+ public:
+  explicit LatencyStats(size_t expected_samples = 0);
+
+  void Add(int64_t ns) { samples_.push_back(ns); }
+
+  size_t count() const { return samples_.size(); }
+
+  // Number of samples larger than "ns".
+  size_t CountAbove(int64_t ns) const;
+
+  // Value below which the given fraction (0..1) of samples are.
+  // Sorts the samples; don't call while still adding.
+  int64_t Percentile(double fraction);
+
+  // Print count, min/avg/max, percentiles and a logarithmic histogram.
+  void Print(FILE *out, const char *title);
+
+ private:
+  std::vector<int64_t> samples_;
+  bool sorted_ = false;
+};
+
+#endif  // LATENCY_STATS_H
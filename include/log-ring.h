@@ -0,0 +1,91 @@
+// -*- mode: c++; c-basic-offset: 2; indent-tabs-mode: nil; -*-
+// Part of txtempus, a LF time signal transmitter.
+// Copyright (C) 2018 Henner Zeller <h.zeller@acm.org>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+
+#ifndef LOG_RING_H
+#define LOG_RING_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <thread>
+
+// Diagnostic output that must not hold up the transmit loop. Messages are
+// formatted into a preallocated ring of fixed size slots, which a low
+// priority thread writes to the output file descriptor. Adding a message
+// never blocks or allocates: if the ring is full, e.g. because the console
+// is slow, the message is dropped and counted instead.
+//
+// Any thread can add messages (bounded multi-producer queue with a sequence
+// number per slot); there is one thread draining it. That thread sleeps on
+// an eventfd while the ring is empty; only the message that makes it
+// non-empty wakes it up.
+class LogRing {
+ public:
+  LogRing();
+  ~LogRing();
+
+  // Start the thread writing messages to "fd". Needs to be called before
+  // the calling thread switches to realtime scheduling, as the new thread
+  // inherits it otherwise.
+  void Start(int fd);
+
+  // Instead of Start(): write each message right away in the calling
+  // thread, for when nothing is timing critical, e.g. in a dry run. Messages
+  // are then never dropped, but Printf() blocks on the output.
+  void StartDirect(int fd);
+
+  // Write all outstanding messages and stop the thread.
+  void Stop();
+
+  // Add a message; longer ones are truncated to the slot size.
+  void Printf(const char *format, ...) __attribute__((format(printf, 2, 3)));
+
+  // Number of messages that had to be dropped so far.
+  uint64_t dropped() const { return dropped_.load(std::memory_order_relaxed); }
+
+ private:
+  static constexpr int kSlots = 256;  // Power of two.
+  static constexpr int kSlotSize = 248;
+
+  struct alignas(64) Slot {
+    std::atomic<uint64_t> sequence;
+    uint32_t length;
+    char text[kSlotSize];
+  };
+
+  void Run();
+  bool Drain();  // Returns 'false' if there was nothing to write.
+  void Wake();
+  void WriteAll(const char *data, size_t size);
+
+  Slot slots_[kSlots];
+  alignas(64) std::atomic<uint64_t> head_{0};  // Next slot to write.
+  alignas(64) uint64_t tail_ = 0;              // Next slot to drain.
+  std::atomic<uint64_t> dropped_{0};
+  // Messages added minus messages drained; can be negative for a moment,
+  // as a message can be drained before its writer counts it.
+  alignas(64) std::atomic<int64_t> pending_{0};
+
+  int fd_ = -1;
+  int wake_fd_ = -1;  // eventfd to wake up the drain thread.
+  bool direct_ = false;
+  std::atomic<bool> running_{false};
+  std::thread thread_;
+};
+
+#endif  // LOG_RING_H
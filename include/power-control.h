@@ -0,0 +1,70 @@
+// -*- mode: c++; c-basic-offset: 2; indent-tabs-mode: nil; -*-
+// Part of txtempus, a LF time signal transmitter.
+// Copyright (C) 2018 Henner Zeller <h.zeller@acm.org>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#ifndef POWER_CONTROL_H
+#define POWER_CONTROL_H
+
+#include <string>
+#include <vector>
+
+// Limit the CPU wakeup latency through /dev/cpu_dma_latency. Deep idle
+// states can take hundreds of microseconds to leave, which directly adds to
+// the time we reach an edge. The request is only held while needed, so that
+// the CPU can still go to deep sleep in between edges.
+class LatencyQoS {
+ public:
+  LatencyQoS() = default;
+  ~LatencyQoS();
+
+  // Open the QoS device; the limit is not held yet.
+  // Returns 'false' on failure.
+  bool Open(int max_latency_us);
+
+  // Hold the latency limit (true) or release it (false). Cheap to call
+  // repeatedly with the same value.
+  void Hold(bool on);
+
+ private:
+  int fd_ = -1;
+  int max_latency_us_ = 0;
+  bool holding_ = false;
+};
+
+// Pin all cpufreq policies to the 'performance' governor while
+// transmitting, so that we don't wait for the clock to ramp up when waking
+// up for an edge. The previous governors are restored when released.
+class GovernorPin {
+ public:
+  GovernorPin() = default;
+  ~GovernorPin();
+
+  // Find the cpufreq policies and remember their governors.
+  // Returns 'false' if there are none.
+  bool Init();
+
+  void Pin(bool on);
+
+ private:
+  struct Policy {
+    std::string governor_file;
+    std::string original;
+  };
+  std::vector<Policy> policies_;
+  bool pinned_ = false;
+};
+
+#endif  // POWER_CONTROL_H
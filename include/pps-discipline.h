@@ -0,0 +1,90 @@
+// -*- mode: c++; c-basic-offset: 2; indent-tabs-mode: nil; -*-
+// Part of txtempus, a LF time signal transmitter.
+// Copyright (C) 2018 Henner Zeller <h.zeller@acm.org>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#ifndef PPS_DISCIPLINE_H
+#define PPS_DISCIPLINE_H
+
+#include <cstdint>
+#include <ctime>
+
+// Model of the system clock relative to a pulse-per-second source.
+// Each PPS assert timestamp (in system time) marks a true second boundary;
+// from the last couple of them, we estimate the offset and rate of the
+// system clock and can translate true times into system clock deadlines.
+//
+// This is separate from the device so that it can be fed with recorded
+// timestamps as well.
+class PPSModel {
+ public:
+  // Add the system timestamp of a PPS assert event. Returns 'false' if the
+  // sample was rejected as outlier.
+  bool AddSample(const struct timespec &assert_time);
+
+  // Returns 'true' if we have enough consistent samples to be useful.
+  bool locked() const { return count_ >= kMinSamples; }
+
+  // Current estimates: system clock minus true time, and its rate.
+  int64_t offset_ns() const { return offset_ns_; }
+  double rate_ppm() const { return rate_ * 1e6; }
+
+  // Convert a true time into the system clock time at which it happens.
+  // Returns the time unchanged if not locked or if the last sample is too
+  // long ago.
+  struct timespec ToSystemTime(const struct timespec &true_time) const;
+
+ private:
+  static constexpr int kMaxSamples = 16;
+  static constexpr int kMinSamples = 4;
+
+  void Fit();
+
+  // Samples: true second and the offset of the system clock at it.
+  int64_t second_[kMaxSamples];
+  int64_t sample_offset_ns_[kMaxSamples];
+  int count_ = 0;
+  int next_ = 0;
+  int rejected_in_a_row_ = 0;
+
+  int64_t reference_second_ = 0;  // Second of the newest sample.
+  int64_t offset_ns_ = 0;         // at reference_second_
+  double rate_ = 0;               // system seconds per true second - 1
+};
+
+// Kernel PPS source (/dev/ppsN, e.g. GPS module or pps-ktimer), accessed
+// through the same ioctl()s the RFC 2783 time_pps_*() functions use.
+class PPSSource {
+ public:
+  PPSSource() = default;
+  ~PPSSource();
+
+  // Open device and enable capturing of assert events.
+  // Returns 'false' on failure.
+  bool Open(const char *device);
+
+  // Fetch the latest assert event without waiting and add it to the
+  // model if it is new. Returns 'true' if there was a new event.
+  bool Update();
+
+  const PPSModel &model() const { return model_; }
+
+ private:
+  int fd_ = -1;
+  uint32_t last_sequence_ = 0;
+  PPSModel model_;
+};
+
+#endif  // PPS_DISCIPLINE_H
@@ -0,0 +1,123 @@
+// -*- mode: c++; c-basic-offset: 2; indent-tabs-mode: nil; -*-
+// Part of txtempus, a LF time signal transmitter.
+// Copyright (C) 2013 Henner Zeller <h.zeller@acm.org>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#ifndef RPI_CONTROL_H
+#define RPI_CONTROL_H
+
+#include <cstdint>
+#include <ctime>
+
+#include "carrier-power.h"
+#include "hardware-control.h"
+
+// -- Implementation for Raspberry Pi Series --
+class RpiControl final : public HardwareControl {
+ public:
+  // Available bits that actually have pins.
+  static const uint32_t kValidBits;
+
+  // The GPIO bit that is pulled down for attenuation of the signal.
+  static const uint32_t kAttenuationGPIOBit;
+
+  const char *platform() const override { return "rpi"; }
+
+  bool Init() override;
+
+  // Initialize outputs for given bits.
+  // Returns the bits that are physically available and could be set for output.
+  uint32_t RequestOutput(uint32_t outputs);
+
+  // Request given bits for input.
+  // Returns the bits that available and could be reserved.
+  uint32_t RequestInput(uint32_t inputs);
+
+  // Set the bits that are '1' in the output. Leave the rest untouched.
+  void SetBits(uint32_t value) { *gpio_set_bits_ = value; }
+
+  // Clear the bits that are '1' in the output. Leave the rest untouched.
+  void ClearBits(uint32_t value) { *gpio_clr_bits_ = value; }
+
+  // Set frequency output on GPIO4 as close as possible to the requested one.
+  // Returns the approximate frequency it could configure or -1 if that was
+  // not possible.
+  double StartClock(double frequency_hertz) override;
+  void StopClock() override;
+
+  // Switches the output of the currently running clock.
+  void EnableClockOutput(bool b) override;
+
+  void SetTxPower(CarrierPower power) override {
+    switch (power) {
+      case CarrierPower::OFF:
+        KeyCarrier(false);
+        break;
+      case CarrierPower::LOW:
+        RequestOutput(kAttenuationGPIOBit);  // Pull down.
+        ClearBits(kAttenuationGPIOBit);
+        EnableClockOutput(true);
+        KeyCarrier(true);
+        break;
+      case CarrierPower::HIGH:
+        RequestInput(kAttenuationGPIOBit);  // High-Z
+        EnableClockOutput(true);
+        KeyCarrier(true);
+        break;
+    }
+  }
+
+  // Average time from keying the carrier on or off until it happened.
+  int64_t KeyingLatencyNs() const override { return keying_latency_ns_; }
+
+  // Shift the phase by briefly running the clock one divider step faster
+  // or slower. The divider is changed while running, which is glitch-free.
+  // The shift ends with FinishPhaseShift(), which takes the time the clock
+  // actually ran detuned into account.
+  bool SetCarrierPhase(double degrees) override;
+  bool PhaseShiftEnd(struct timespec *end) const override {
+    *end = shift_end_;
+    return shifting_;
+  }
+  void FinishPhaseShift() override;
+
+ private:
+  // Start or stop the clock generator at the end of a carrier cycle, so
+  // that there are no runt pulses; used for CarrierPower::OFF.
+  void KeyCarrier(bool on);
+
+  volatile uint32_t *gpio_port_ = nullptr;
+  volatile uint32_t *gpio_set_bits_ = nullptr;
+  volatile uint32_t *gpio_clr_bits_ = nullptr;
+  volatile uint32_t *clock_reg_ = nullptr;
+
+  // Current clock configuration, needed for phase shifts.
+  double clock_source_frequency_ = 0;
+  int divider_ = 0;  // In units of 1/1024
+  double phase_degrees_ = 0;  // Current phase, including shift errors.
+
+  // Running phase shift.
+  bool shifting_ = false;
+  struct timespec shift_start_ = {};  // CLOCK_MONOTONIC
+  struct timespec shift_end_ = {};    // CLOCK_REALTIME
+  double shift_degrees_per_second_ = 0;
+
+  uint32_t clock_ctl_ = 0;  // Source and MASH of the running clock.
+  bool keyed_on_ = false;
+  int64_t carrier_period_ns_ = 0;
+  int64_t keying_latency_ns_ = 0;
+};
+
+#endif  // RPI_CONTROL_H
@@ -0,0 +1,109 @@
+// -*- mode: c++; c-basic-offset: 2; indent-tabs-mode: nil; -*-
+// Part of txtempus, a LF time signal transmitter.
+// Copyright (C) 2018 Henner Zeller <h.zeller@acm.org>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+
+#ifndef SCHEDULE_FILE_H
+#define SCHEDULE_FILE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <ctime>
+
+#include "time-signal-source.h"
+
+// Precomputed transmission schedule, generated offline by
+// txtempus-mkschedule and played back by txtempus through mmap().
+//
+// Layout, all in host byte order (little endian on all supported boards):
+//   ScheduleFileHeader
+//   ScheduleSymbol symbols[60][1 << bits_per_second]
+//   uint64_t frames[minutes][words_per_frame]
+//
+// Each second of a frame is a small number, selecting the modulation of that
+// second from the symbol table of its position in the minute. E.g. DCF77
+// needs one bit per second (100ms or 200ms pulse; second 59 has only one
+// symbol), so a frame fits in one 64 bit word, about 4MB per year.
+// Version 2 of the format has durations in nanoseconds instead of
+// milliseconds.
+// Seconds don't straddle words: each word holds 64 / bits_per_second seconds,
+// the first one in the least significant bits.
+
+static constexpr char kScheduleMagic[8] = {'T', 'X', 'S', 'C',
+                                          'H', 'E', 'D', '2'};
+static constexpr uint32_t kScheduleByteOrder = 0x01020304;
+static constexpr int kScheduleMaxChanges = 4;  // Per second.
+static constexpr int kScheduleMaxBitsPerSecond = 4;
+
+struct ScheduleFileHeader {
+  char magic[8];             // kScheduleMagic
+  uint32_t byte_order;       // kScheduleByteOrder
+  uint32_t carrier_hz;
+  char station[16];          // Service name, nul terminated.
+  int64_t first_minute;      // Time of the first frame, as in PrepareMinute()
+  uint32_t minutes;          // Number of frames.
+  uint16_t bits_per_second;  // 1 .. kScheduleMaxBitsPerSecond
+  uint16_t words_per_frame;
+  uint64_t symbols_offset;  // File offset of the symbol table.
+  uint64_t frames_offset;   // File offset of the first frame.
+};
+static_assert(sizeof(ScheduleFileHeader) == 64, "Unexpected padding");
+
+// Amplitude modulation of one second, like TimeSignalSource::SecondModulation
+// The last change has a duration of zero.
+struct ScheduleSymbol {
+  struct {
+    uint8_t power;  // CarrierPower
+    uint8_t reserved[3];
+    uint32_t duration_ns;
+  } changes[kScheduleMaxChanges];
+};
+static_assert(sizeof(ScheduleSymbol) == 32, "Unexpected padding");
+
+// Time signal source playing back a schedule file. Outside the time range of
+// the file, it sends the unmodulated carrier.
+class ScheduleFileSource : public TimeSignalSource {
+ public:
+  ScheduleFileSource() = default;
+  ~ScheduleFileSource() override;
+
+  // Map the file and check its header. Returns 'false' on failure.
+  bool Open(const char *filename);
+
+  const ScheduleFileHeader &header() const { return *header_; }
+
+  // Returns 'true' if the minute given in the last PrepareMinute() is
+  // in the schedule.
+  bool has_frame() const { return frame_ != nullptr; }
+
+  int GetCarrierFrequencyHz() const final { return header_->carrier_hz; }
+  void PrepareMinute(time_t t) final;
+  ModulationSpan GetModulationSpan(int second) final;
+
+ private:
+  const uint8_t *map_ = nullptr;
+  size_t map_size_ = 0;
+  const ScheduleFileHeader *header_ = nullptr;
+  const ScheduleSymbol *symbols_ = nullptr;
+  const uint64_t *frames_ = nullptr;
+  const uint64_t *frame_ = nullptr;  // Current minute.
+
+  // Its modulation, filled in by PrepareMinute().
+  ModulationDuration modulation_[60][kScheduleMaxChanges];
+  int changes_[60];
+};
+
+#endif  // SCHEDULE_FILE_H
@@ -0,0 +1,38 @@
+// -*- mode: c++; c-basic-offset: 2; indent-tabs-mode: nil; -*-
+// Part of txtempus, a LF time signal transmitter.
+// Copyright (C) 2018 Henner Zeller <h.zeller@acm.org>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#ifndef SCHEDULING_H
+#define SCHEDULING_H
+
+#include <cstdint>
+
+// Make the calling thread SCHED_FIFO with the given priority.
+// Returns 'false' if not permitted.
+bool SetFifoScheduling(int priority);
+
+// Make the calling thread SCHED_DEADLINE: each activation (wakeup for an
+// edge) gets "runtime_ns" of CPU time guaranteed within "deadline_ns";
+// activations are at least "period_ns" apart.
+// Returns 'false' if not permitted or not supported by the kernel, or if
+// the admission control rejects the parameters.
+//
+// Note, a SCHED_DEADLINE thread can not create new threads anymore, so
+// helper threads have to be started before calling this.
+bool SetDeadlineScheduling(int64_t runtime_ns, int64_t deadline_ns,
+                           int64_t period_ns);
+
+#endif  // SCHEDULING_H
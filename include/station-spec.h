@@ -0,0 +1,260 @@
+// -*- mode: c++; c-basic-offset: 2; indent-tabs-mode: nil; -*-
+// Part of txtempus, a LF time signal transmitter.
+// Copyright (C) 2018 Henner Zeller <h.zeller@acm.org>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#ifndef STATION_SPEC_H
+#define STATION_SPEC_H
+
+#include <cstdint>
+#include <cstring>
+#include <ctime>
+
+#include "calendar-cache.h"
+#include "carrier-power.h"
+#include "time-signal-source.h"
+
+// Declarative description of the amplitude modulated time code of a
+// station. The encoder templates below take the spec as compile-time
+// constant, so the compiler unrolls the loops over its fields and only the
+// bit placement for that particular station remains.
+//
+// Each second of a frame carries a symbol of "bits_per_second" bits. Fields
+// put time values into the symbols of consecutive seconds, parity bits are
+// computed over ranges of seconds, and the pulse table gives the modulation
+// for each symbol value. Marker seconds have their own fixed modulation.
+
+enum class FieldValue : uint8_t {
+  MINUTE,
+  HOUR,
+  HOUR_12,          // 0..11
+  PM,               // 1 in the afternoon.
+  DAY_OF_MONTH,     // 1..31
+  DAY_OF_YEAR,      // 1..366
+  DAY_OF_WEEK,      // 0 = Sunday .. 6
+  DAY_OF_WEEK_ISO,  // 1 = Monday .. 7 = Sunday
+  MONTH,            // 1..12
+  YEAR_OF_CENTURY,  // 0..99
+  LEAP_YEAR,
+  DST,            // Local time is daylight saving time.
+  STANDARD_TIME,  // Local time is not daylight saving time.
+  DST_TOMORROW,   // Daylight saving time 24 hours from now.
+  FRAME_NUMBER,   // Number of the repetition within the minute.
+  ALL_ONES,
+};
+
+enum class FieldEncoding : uint8_t {
+  BINARY,
+  BCD,
+  PADDED_BCD,  // BCD with a zero bit between the digits.
+};
+
+// Field bits are sent in the station's bit order over the seconds starting
+// at first_second. Either only one bit of each symbol is used, or all of
+// them, most significant first.
+static constexpr int8_t kAllSymbolBits = -1;
+
+struct FieldSpec {
+  FieldValue value;
+  FieldEncoding encoding;
+  int8_t first_second;  // Relative to the start of the frame.
+  int8_t seconds;       // Number of seconds it spans.
+  int8_t symbol_bit = kAllSymbolBits;
+  int8_t shift = 0;  // Only send value >> shift.
+};
+
+// Even (or odd) parity over all used symbol bits of a range of seconds.
+struct ParitySpec {
+  int8_t first_second;
+  int8_t last_second;  // Including.
+  int8_t source_bit;   // Symbol bit covered, or kAllSymbolBits.
+  int8_t second;       // Where the parity bit goes ...
+  int8_t symbol_bit;   // ... and which bit of that symbol.
+  bool odd = false;
+};
+
+// Modulation of a second; the last change has a duration of zero and lasts
+// until the end of it.
+struct PulseSpec {
+  int changes;
+  ModulationDuration modulation[4];
+};
+
+struct StationSpec {
+  // The frame encodes the time this many seconds after the beginning of the
+  // minute it is sent in, e.g. 60 if it announces the upcoming minute.
+  int time_offset_seconds;
+  bool utc;  // Time fields are in UTC instead of local time.
+
+  bool msb_first;  // Bit order of the fields.
+  int frame_seconds;  // Frame repeats within the minute; divides 60.
+  int bits_per_second;
+
+  const FieldSpec *fields;
+  int field_count;
+  const ParitySpec *parities;
+  int parity_count;
+
+  uint64_t marker_seconds;  // Bit n set: second n of the frame is a marker.
+  PulseSpec marker;
+  const PulseSpec *symbols;  // 1 << bits_per_second entries.
+};
+
+// Returns 'true' if all pulses of the spec are within a second and end with
+// a change lasting for the rest of it.
+constexpr bool PulsesFitInSecond(const StationSpec &spec) {
+  for (int i = 0; i <= (1 << spec.bits_per_second); ++i) {
+    const PulseSpec &pulse =
+        i < (1 << spec.bits_per_second) ? spec.symbols[i] : spec.marker;
+    if (pulse.changes < 1 || pulse.changes > 4) return false;
+    int64_t total_ns = 0;
+    for (int c = 0; c < pulse.changes; ++c) {
+      total_ns += pulse.modulation[c].duration_ns;
+    }
+    if (total_ns >= kNanosPerSecond) return false;
+    if (pulse.modulation[pulse.changes - 1].duration_ns != 0) return false;
+  }
+  return true;
+}
+
+// Returns 'true' if any field of the spec needs the given value.
+constexpr bool SpecUsesValue(const StationSpec &spec, FieldValue value) {
+  for (int i = 0; i < spec.field_count; ++i) {
+    if (spec.fields[i].value == value) return true;
+  }
+  return false;
+}
+
+// The symbols of all seconds of a minute. The calendars are kept by the
+// caller from one minute to the next, so that the calendar fields mostly
+// don't need the C library.
+template <const StationSpec &Spec>
+void EncodeSpecMinute(time_t t, StationCalendars *calendars,
+                      uint8_t symbols[60]) {
+  static_assert(60 % Spec.frame_seconds == 0, "Frame must divide minute");
+  static_assert(Spec.bits_per_second >= 1 && Spec.bits_per_second <= 4,
+                "Unsupported symbol size");
+  static_assert(PulsesFitInSecond(Spec), "Pulse does not fit in a second");
+
+  t += Spec.time_offset_seconds;
+  struct tm local;
+  calendars->local.BreakDown(t, &local);
+  struct tm time_fields = local;
+  if constexpr (Spec.utc) calendars->utc.BreakDown(t, &time_fields);
+  struct tm tomorrow = {};
+  if constexpr (SpecUsesValue(Spec, FieldValue::DST_TOMORROW)) {
+    calendars->tomorrow.BreakDown(t + 86400, &tomorrow);
+  }
+
+  memset(symbols, 0, 60);
+  for (int frame = 0; frame < 60 / Spec.frame_seconds; ++frame) {
+    uint8_t *const frame_symbols = symbols + frame * Spec.frame_seconds;
+
+#pragma GCC unroll 32
+    for (int i = 0; i < Spec.field_count; ++i) {
+      const FieldSpec &field = Spec.fields[i];
+      const struct tm &tm = time_fields;
+      uint64_t value = 0;
+      switch (field.value) {
+        case FieldValue::MINUTE: value = tm.tm_min; break;
+        case FieldValue::HOUR: value = tm.tm_hour; break;
+        case FieldValue::HOUR_12: value = tm.tm_hour % 12; break;
+        case FieldValue::PM: value = tm.tm_hour >= 12; break;
+        case FieldValue::DAY_OF_MONTH: value = tm.tm_mday; break;
+        case FieldValue::DAY_OF_YEAR: value = tm.tm_yday + 1; break;
+        case FieldValue::DAY_OF_WEEK: value = tm.tm_wday; break;
+        case FieldValue::DAY_OF_WEEK_ISO:
+          value = tm.tm_wday ? tm.tm_wday : 7;
+          break;
+        case FieldValue::MONTH: value = tm.tm_mon + 1; break;
+        case FieldValue::YEAR_OF_CENTURY: value = tm.tm_year % 100; break;
+        case FieldValue::LEAP_YEAR: {
+          const int year = tm.tm_year + 1900;
+          value = year % 4 == 0 && (year % 100 != 0 || year % 400 == 0);
+          break;
+        }
+        case FieldValue::DST: value = local.tm_isdst > 0; break;
+        case FieldValue::STANDARD_TIME: value = local.tm_isdst <= 0; break;
+        case FieldValue::DST_TOMORROW: value = tomorrow.tm_isdst > 0; break;
+        case FieldValue::FRAME_NUMBER: value = frame; break;
+        case FieldValue::ALL_ONES: value = ~0ULL; break;
+      }
+      value >>= field.shift;
+
+      uint64_t bits = value;
+      if (field.encoding != FieldEncoding::BINARY) {
+        const int digit_bits = field.encoding == FieldEncoding::BCD ? 4 : 5;
+        bits = 0;
+        for (int digit = 0; digit < 3 && value; ++digit, value /= 10) {
+          bits |= (value % 10) << (digit * digit_bits);
+        }
+      }
+
+      const int bits_per_slot =
+          field.symbol_bit == kAllSymbolBits ? Spec.bits_per_second : 1;
+      const int count = field.seconds * bits_per_slot;
+#pragma GCC unroll 32
+      for (int b = 0; b < count; ++b) {
+        const int source = Spec.msb_first ? count - 1 - b : b;
+        if (!((bits >> source) & 1)) continue;
+        const int second = field.first_second + b / bits_per_slot;
+        const int symbol_bit =
+            field.symbol_bit == kAllSymbolBits
+                ? Spec.bits_per_second - 1 - b % bits_per_slot
+                : field.symbol_bit;
+        frame_symbols[second] |= 1 << symbol_bit;
+      }
+    }
+
+#pragma GCC unroll 32
+    for (int i = 0; i < Spec.parity_count; ++i) {
+      const ParitySpec &parity = Spec.parities[i];
+      const int mask = parity.source_bit == kAllSymbolBits
+                           ? (1 << Spec.bits_per_second) - 1
+                           : 1 << parity.source_bit;
+      int ones = 0;
+      for (int s = parity.first_second; s <= parity.last_second; ++s) {
+        ones += __builtin_popcount(frame_symbols[s] & mask);
+      }
+      if ((ones & 1) != parity.odd) {
+        frame_symbols[parity.second] |= 1 << parity.symbol_bit;
+      }
+    }
+  }
+}
+
+// Modulation of the given second of a minute encoded with EncodeSpecMinute().
+template <const StationSpec &Spec>
+TimeSignalSource::ModulationSpan SpecModulationForSecond(
+    const uint8_t symbols[60], int second) {
+  const bool marker =
+      second >= 60 ||
+      ((Spec.marker_seconds >> (second % Spec.frame_seconds)) & 1);
+  const PulseSpec &pulse = marker ? Spec.marker : Spec.symbols[symbols[second]];
+  return {pulse.modulation, pulse.modulation + pulse.changes};
+}
+
+// Symbol of the given second of a minute encoded with EncodeSpecMinute(),
+// -1 for markers.
+template <const StationSpec &Spec>
+int SpecSymbolForSecond(const uint8_t symbols[60], int second) {
+  if (second >= 60 ||
+      ((Spec.marker_seconds >> (second % Spec.frame_seconds)) & 1)) {
+    return -1;
+  }
+  return symbols[second];
+}
+
+#endif  // STATION_SPEC_H
@@ -0,0 +1,53 @@
+// -*- mode: c++; c-basic-offset: 2; indent-tabs-mode: nil; -*-
+// Part of txtempus, a LF time signal transmitter.
+// Copyright (C) 2018 Henner Zeller <h.zeller@acm.org>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#ifndef STRESSORS_H
+#define STRESSORS_H
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+// Background load to see how the transmit loop holds up on a busy system.
+// Stressors run as normal priority threads until stopped.
+class Stressors {
+ public:
+  Stressors() = default;
+  ~Stressors();
+
+  // Start the comma separated list of stressors:
+  //   cpu : one busy loop per CPU.
+  //   mem : one thread per CPU copying buffers much larger than the caches.
+  //   io  : one thread writing and syncing a temporary file.
+  // Returns 'false' on an unknown name or if a stressor can't be set up.
+  //
+  // Like other threads, these need to be started before the transmit loop
+  // switches to realtime scheduling.
+  bool Start(const char *spec);
+
+  void Stop();
+
+ private:
+  void CpuLoad();
+  void MemoryLoad();
+  void IOLoad(int fd);
+
+  std::atomic<bool> running_{false};
+  std::vector<std::thread> threads_;
+};
+
+#endif  // STRESSORS_H
@@ -15,8 +15,8 @@
 // You should have received a copy of the GNU General Public License
 // along with this program.  If not, see <https://www.gnu.org/licenses/>.
 
-#ifndef SUNXIH3_HARDWARE_CONTROL_IMPLEMENTATION_H
-#define SUNXIH3_HARDWARE_CONTROL_IMPLEMENTATION_H
+#ifndef SUNXIH3_CONTROL_H
+#define SUNXIH3_CONTROL_H
 
 #include <stdio.h>  // NOLINT(modernize-deprecated-headers) off_t only there
 
@@ -28,24 +28,48 @@
 
 // -- Implementation for Allwinner H3 SOC --
 // https://linux-sunxi.org/Category:H3_Devices Tested on OrangePI PC
-class HardwareControl::Implementation {
+class SunxiH3Control final : public HardwareControl {
  public:
+  const char *platform() const override { return "sunxih3"; }
+
   // Initialize
-  bool Init();
+  bool Init() override;
 
   // Set frequency output on PA5 as close as possible to the requested one.
   // Returns the approximate frequency it could configure or -1 if that was
   // not possible.
   // You need to identify PA5 on your board on the OrngePI PC it is the middle
   // pin of the debug UART
-  double StartClock(double frequency_hertz);
-  void StopClock();
+  double StartClock(double frequency_hertz) override;
+  void StopClock() override;
 
   // Switches the output of the currently running clock.
-  void EnableClockOutput(bool enable);
+  void EnableClockOutput(bool enable) override;
 
   // Sets the power of the output by pulling low the voltage divider's mid point
-  void SetTxPower(CarrierPower power);
+  void SetTxPower(CarrierPower power) override {
+    switch (power) {
+      case CarrierPower::OFF:
+        KeyCarrier(false);
+        break;
+      case CarrierPower::LOW:
+        SetOutput(PA6);
+        EnableClockOutput(true);
+        KeyCarrier(true);
+        break;
+      case CarrierPower::HIGH:
+        SetInput(PA6);  // High-Z
+        EnableClockOutput(true);
+        KeyCarrier(true);
+        break;
+    }
+  }
+
+  // Average time from keying the carrier on or off until it happened.
+  int64_t KeyingLatencyNs() const override { return keying_latency_ns_; }
+
+  // Phase modulation not implemented.
+  bool SetCarrierPhase(double degrees) override { return false; }
 
  private:
   enum TPwmCtrlReg {
@@ -88,8 +112,16 @@ class HardwareControl::Implementation {
   // Calculate PWM parameters based on requested output frequency
   pwm_params CalculatePWMParams(double requested_freq);
   void WaitPwmPeriodReady();
-};
 
-using H3BOARD = HardwareControl::Implementation;
+  // Switch between 50% duty cycle and no active cycles at all. The period
+  // register only takes effect at the end of a PWM period, so there are no
+  // runt pulses; used for CarrierPower::OFF.
+  void KeyCarrier(bool on);
+
+  int period_ = 0;  // Of the running clock, in prescaled clock cycles.
+  bool keyed_on_ = false;
+  int64_t carrier_period_ns_ = 0;
+  int64_t keying_latency_ns_ = 0;
+};
 
-#endif  // SUNXIH3_HARDWARE_CONTROL_IMPLEMENTATION_H
+#endif  // SUNXIH3_CONTROL_H
@@ -18,21 +18,77 @@
 #ifndef TIMETRANSMITTER_CLOCKGEN_H
 #define TIMETRANSMITTER_CLOCKGEN_H
 
+#include <cstddef>
 #include <cstdint>
 #include <ctime>
+#include <memory>
 #include <vector>
 
+#include "calendar-cache.h"
 #include "carrier-power.h"
 
+static constexpr int32_t kNanosPerSecond = 1000000000;
+
+// Called if a duration is out of range; not constexpr, so that using it in
+// a constant expression fails to compile.
+int32_t DurationOutsideSecond(int64_t ns);
+
+// Time within a second in nanoseconds, checked to be within 0..1s. In
+// constant expressions such as the station specs, this is checked at compile
+// time; at runtime, a value out of range aborts.
+constexpr int32_t Nanos(int64_t ns) {
+  return (ns >= 0 && ns <= kNanosPerSecond) ? (int32_t)ns
+                                            : DurationOutsideSecond(ns);
+}
+constexpr int32_t Micros(int64_t us) { return Nanos(us * 1000); }
+constexpr int32_t Millis(int64_t ms) { return Nanos(ms * 1000000); }
+
 struct ModulationDuration {
   CarrierPower power;
-  int duration_ms;
+  int32_t duration_ns;  // e.g. Millis(100); zero for the rest of the second.
+};
+
+// Change of the carrier phase at a particular time within the second.
+struct PhaseChange {
+  int32_t offset_ns;     // Time since the beginning of the second.
+  double phase_degrees;  // Relative to the unmodulated carrier.
+};
+
+// Read-only view of consecutive elements owned by someone else, like
+// C++20's std::span.
+template <class T>
+class ConstSpan {
+ public:
+  constexpr ConstSpan() = default;
+  constexpr ConstSpan(const T *begin, const T *end)
+      : begin_(begin), end_(end) {}
+  ConstSpan(const std::vector<T> &v)  // NOLINT(google-explicit-constructor)
+      : begin_(v.data()), end_(v.data() + v.size()) {}
+
+  const T *begin() const { return begin_; }
+  const T *end() const { return end_; }
+  size_t size() const { return end_ - begin_; }
+  bool empty() const { return begin_ == end_; }
+  const T &front() const { return *begin_; }
+  const T &back() const { return end_[-1]; }
+  const T &operator[](size_t i) const { return begin_[i]; }
+
+ private:
+  const T *begin_ = nullptr;
+  const T *end_ = nullptr;
 };
 
 // Base class for different types of time signal sources.
 class TimeSignalSource {
  public:
   using SecondModulation = std::vector<ModulationDuration>;
+  using SecondPhaseModulation = std::vector<PhaseChange>;
+
+  // The same without copying, pointing into data of the source. Valid
+  // until the next PrepareMinute(); used by the transmit loop, which must
+  // not allocate.
+  using ModulationSpan = ConstSpan<ModulationDuration>;
+  using PhaseSpan = ConstSpan<PhaseChange>;
 
   virtual ~TimeSignalSource() = default;
 
@@ -48,65 +104,117 @@ class TimeSignalSource {
   // The provided time is guaranteed to be an even minute, i.e. divisible by 60.
   virtual void PrepareMinute(time_t t) = 0;
 
-  // Returns a vector of modulation transitions to be sent out for the
+  // Returns the modulation transitions to be sent out for the
   // particular second within the minute mentioned in PrepareMinute().
   // The method should return a sequence of power-levels and durations in
-  // milliseconds. The last transition stays for the remainder of the second,
+  // nanoseconds. The last transition stays for the remainder of the second,
   // so it is good practice to set the last duration to zero to auto-fill.
-  // e.g. {{CarrierPower::HIGH, 200},{CarrierPower::LOW, 0}}
+  // e.g. {{CarrierPower::HIGH, Millis(200)},{CarrierPower::LOW, 0}}
   //
-  // All numbers must add up to less or equal 1000ms.
+  // All numbers must add up to less or equal one second.
   //
   // Value of second can be between 0..59, or up to 60 with leap seconds
   // (leap seconds not implemented yet).
-  virtual SecondModulation GetModulationForSecond(int second) = 0;
+  virtual ModulationSpan GetModulationSpan(int second) = 0;
+  SecondModulation GetModulationForSecond(int second) {
+    const ModulationSpan modulation = GetModulationSpan(second);
+    return {modulation.begin(), modulation.end()};
+  }
+
+  // Returns the phase changes to be sent in addition to the amplitude
+  // modulation in the given second, in chronological order. The phase
+  // stays until the next change.
+  // Most time sources only modulate the amplitude, so the default is none.
+  virtual PhaseSpan GetPhaseSpan(int second) { return {}; }
+  SecondPhaseModulation GetPhaseModulationForSecond(int second) {
+    const PhaseSpan phase = GetPhaseSpan(second);
+    return {phase.begin(), phase.end()};
+  }
+
+  // Returns the data symbol sent in the given second of the prepared
+  // minute, as numbered by the station's encoding (e.g. the bit value), or
+  // -1 for marker seconds and sources that don't know.
+  virtual int GetSymbolForSecond(int second) const { return -1; }
 };
 
 // -- Various implementations.
+// The amplitude modulation of all of them is described declaratively by a
+// StationSpec (see station-spec.h) in the corresponding source file; the
+// classes only hold the symbols of the prepared minute and the calendars
+// to encode the next one.
 class DCF77TimeSignalSource : public TimeSignalSource {
  public:
-  int GetCarrierFrequencyHz() const final { return 77500; }
+  static constexpr int kCarrierHz = 77500;
+
+  int GetCarrierFrequencyHz() const final { return kCarrierHz; }
   void PrepareMinute(time_t t) final;
-  SecondModulation GetModulationForSecond(int second) final;
+  ModulationSpan GetModulationSpan(int second) final;
+  int GetSymbolForSecond(int second) const final;
+  PhaseSpan GetPhaseSpan(int second) final;
 
  private:
-  uint64_t time_bits_;
+  StationCalendars calendars_;
+  uint8_t symbols_[60];
 };
 
 class WWVBTimeSignalSource : public TimeSignalSource {
  public:
   int GetCarrierFrequencyHz() const final { return 60000; }
   void PrepareMinute(time_t t) final;
-  SecondModulation GetModulationForSecond(int second) final;
+  ModulationSpan GetModulationSpan(int second) final;
+  int GetSymbolForSecond(int second) const final;
+  PhaseSpan GetPhaseSpan(int second) final;
 
  private:
-  uint64_t time_bits_;
+  StationCalendars calendars_;
+  uint8_t symbols_[60];
+  PhaseChange phase_[60];  // One phase per second.
 };
 
-class JJYTimeSignalSource : public TimeSignalSource {
+// JJY40 and JJY60 send the same time code on different carriers.
+template <int kCarrierHz>
+class JJYTimeSignalSource final : public TimeSignalSource {
  public:
+  int GetCarrierFrequencyHz() const final { return kCarrierHz; }
   void PrepareMinute(time_t t) final;
-  SecondModulation GetModulationForSecond(int second) final;
+  ModulationSpan GetModulationSpan(int second) final;
+  int GetSymbolForSecond(int second) const final;
 
  private:
-  uint64_t time_bits_;
+  StationCalendars calendars_;
+  uint8_t symbols_[60];
 };
+using JJY40TimeSignalSource = JJYTimeSignalSource<40000>;
+using JJY60TimeSignalSource = JJYTimeSignalSource<60000>;
 
-class JJY60TimeSignalSource : public JJYTimeSignalSource {
+class MSFTimeSignalSource : public TimeSignalSource {
+ public:
   int GetCarrierFrequencyHz() const final { return 60000; }
-};
-class JJY40TimeSignalSource : public JJYTimeSignalSource {
-  int GetCarrierFrequencyHz() const final { return 40000; }
+  void PrepareMinute(time_t t) final;
+  ModulationSpan GetModulationSpan(int second) final;
+  int GetSymbolForSecond(int second) const final;
+
+ private:
+  StationCalendars calendars_;
+  uint8_t symbols_[60];
 };
 
-class MSFTimeSignalSource : public TimeSignalSource {
+// China's BPC: three 20 second frames per minute, each second carrying one
+// of four pulse lengths.
+class BPCTimeSignalSource : public TimeSignalSource {
  public:
-  int GetCarrierFrequencyHz() const final { return 60000; }
+  int GetCarrierFrequencyHz() const final { return 68500; }
   void PrepareMinute(time_t t) final;
-  SecondModulation GetModulationForSecond(int second) final;
+  ModulationSpan GetModulationSpan(int second) final;
+  int GetSymbolForSecond(int second) const final;
 
  private:
-  uint64_t a_bits_, b_bits_;
+  StationCalendars calendars_;
+  uint8_t symbols_[60];
 };
 
+// Create the time signal source for the given service name, e.g. "DCF77"
+// (case insensitive). Returns nullptr if there is no such service.
+std::unique_ptr<TimeSignalSource> CreateTimeSignalSource(const char *name);
+
 #endif  // TIMETRANSMITTER_CLOCKGEN_H
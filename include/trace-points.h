@@ -0,0 +1,83 @@
+// -*- mode: c++; c-basic-offset: 2; indent-tabs-mode: nil; -*-
+// Part of txtempus, a LF time signal transmitter.
+// Copyright (C) 2018 Henner Zeller <h.zeller@acm.org>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#ifndef TRACE_POINTS_H
+#define TRACE_POINTS_H
+
+#include <cstdint>
+#include <ctime>
+
+// Instrumentation to correlate what we do with kernel scheduling events.
+//
+// USDT probes (provider 'txtempus': minute_prepare, edge_issue, wakeup) are
+// compiled in if <sys/sdt.h> is available; they are a single nop until
+// attached to with perf or bpftrace.
+//
+// Records to the ftrace trace_marker are only written after
+// OpenTraceMarker() succeeded; otherwise, the cost is a predictable branch.
+#if defined(__has_include)
+#if __has_include(<sys/sdt.h>)
+#include <sys/sdt.h>
+#define TXTEMPUS_HAVE_USDT 1
+#endif
+#endif
+
+#ifdef TXTEMPUS_HAVE_USDT
+#define TXTEMPUS_PROBE1(name, a) DTRACE_PROBE1(txtempus, name, a)
+#define TXTEMPUS_PROBE2(name, a, b) DTRACE_PROBE2(txtempus, name, a, b)
+#define TXTEMPUS_PROBE3(name, a, b, c) DTRACE_PROBE3(txtempus, name, a, b, c)
+#else
+#define TXTEMPUS_PROBE1(name, a) (void)0
+#define TXTEMPUS_PROBE2(name, a, b) (void)0
+#define TXTEMPUS_PROBE3(name, a, b, c) (void)0
+#endif
+
+// File descriptor of the trace marker, -1 if not enabled.
+extern int trace_marker_fd;
+
+// Open the ftrace trace_marker. Returns 'false' if not available.
+bool OpenTraceMarker();
+
+// Slow paths, only called if the trace marker is open.
+void WriteTraceMinute(time_t transmit_time);
+void WriteTraceEdge(int power);
+void WriteTraceWakeup(const struct timespec &target, int64_t late_ns);
+
+// Before preparing the minute with the given time to be transmitted.
+inline void TraceMinutePrepare(time_t transmit_time) {
+  TXTEMPUS_PROBE1(minute_prepare, (int64_t)transmit_time);
+  if (__builtin_expect(trace_marker_fd >= 0, 0)) {
+    WriteTraceMinute(transmit_time);
+  }
+}
+
+// Right before the hardware is switched to a new power level.
+inline void TraceEdgeIssue(int power) {
+  TXTEMPUS_PROBE1(edge_issue, power);
+  if (__builtin_expect(trace_marker_fd >= 0, 0)) WriteTraceEdge(power);
+}
+
+// After waking up for the given deadline, "late_ns" after it.
+inline void TraceWakeup(const struct timespec &target, int64_t late_ns) {
+  TXTEMPUS_PROBE3(wakeup, (int64_t)target.tv_sec, (int64_t)target.tv_nsec,
+                  late_ns);
+  if (__builtin_expect(trace_marker_fd >= 0, 0)) {
+    WriteTraceWakeup(target, late_ns);
+  }
+}
+
+#endif  // TRACE_POINTS_H
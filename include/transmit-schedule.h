@@ -0,0 +1,50 @@
+// -*- mode: c++; c-basic-offset: 2; indent-tabs-mode: nil; -*-
+// Part of txtempus, a LF time signal transmitter.
+// Copyright (C) 2018 Henner Zeller <h.zeller@acm.org>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#ifndef TRANSMIT_SCHEDULE_H
+#define TRANSMIT_SCHEDULE_H
+
+#include <ctime>
+#include <vector>
+
+// Daily windows in local time in which we should transmit, e.g. the times
+// a watch is listening for the signal. An empty schedule means 'always'.
+class TransmitSchedule {
+ public:
+  // Add windows from a comma-separated list of "HH:MM-HH:MM" ranges. The
+  // end is exclusive; a window can wrap around midnight.
+  // Returns false if the specification could not be parsed.
+  bool AddWindows(const char *spec);
+
+  bool empty() const { return windows_.empty(); }
+
+  // Returns true if the minute starting at "t" is within a window.
+  bool IsActive(time_t t) const;
+
+  // Returns the start of the next minute at or after "t" that is within a
+  // window, or -1 if there is none.
+  time_t NextActiveMinute(time_t t) const;
+
+ private:
+  struct Window {
+    int start_minute;  // Minute of the day.
+    int end_minute;
+  };
+  std::vector<Window> windows_;
+};
+
+#endif  // TRANSMIT_SCHEDULE_H
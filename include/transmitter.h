@@ -0,0 +1,167 @@
+// -*- mode: c++; c-basic-offset: 2; indent-tabs-mode: nil; -*-
+// Part of txtempus, a LF time signal transmitter.
+// Copyright (C) 2018 Henner Zeller <h.zeller@acm.org>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+
+#ifndef TRANSMITTER_H
+#define TRANSMITTER_H
+
+#include <climits>
+#include <cstdint>
+#include <ctime>
+#include <memory>
+
+#include "carrier-power.h"
+#include "cluster.h"
+#include "control-socket.h"
+#include "event-loop.h"
+#include "hardware-control.h"
+#include "log-ring.h"
+#include "time-signal-source.h"
+#include "transmit-schedule.h"
+
+class FlightRecorder;
+class GovernorPin;
+class LatencyQoS;
+class LatencyStats;
+class PPSSource;
+
+// Edges we reach later than this are counted as late.
+static constexpr int64_t kLateEdgeMicros = 1000;
+
+// Edges later than this are missed: the pulse lengths are off enough to
+// possibly change the meaning of a bit.
+static constexpr int kDefaultLatenessBudgetMicros = 10000;
+
+// What to do if an edge is missed.
+enum class MissPolicy {
+  BLANK,    // Send the carrier only for the rest of the minute.
+  STRETCH,  // Shift the rest of the second, so following pulses keep length.
+  ABORT,    // Stop transmitting and exit.
+};
+
+// The transmit loop: sends the minutes of a time signal source, edge by
+// edge, on the hardware. It waits for each edge in an event loop that also
+// serves signals, clock changes and the group messages, and writes its
+// diagnostic output through a log ring so that it never blocks.
+//
+// The optional parts in the options are set up by the caller and are not
+// owned; leave them nullptr if not used.
+class Transmitter {
+ public:
+  struct Options {
+    time_t start_minute = 0;    // First minute to send.
+    int time_offset_s = 0;      // Sent time minus true time, like -t.
+    int offset_minutes = 0;     // Added to that, like -z; can change.
+    int minutes = INT_MAX;      // Minutes to send.
+    TransmitSchedule schedule;  // Daily windows; always on if empty.
+
+    bool verbose = false;
+    bool dryrun = false;     // No hardware, no waiting, print modulation.
+    bool benchmark = false;  // Wait for edges, but no hardware.
+    bool carrier_only = false;
+    bool phase_modulation = false;
+
+    int deadline_runtime_us = 0;  // SCHED_DEADLINE budget; 0: SCHED_FIFO.
+    int lateness_budget_us = kDefaultLatenessBudgetMicros;
+    MissPolicy miss_policy = MissPolicy::BLANK;
+    int64_t max_clock_error_us = -1;  // Carrier only above; -1: no check.
+
+    PPSSource *pps = nullptr;              // Align seconds to its pulses.
+    LatencyQoS *latency_qos = nullptr;     // Held shortly before edges.
+    GovernorPin *governor = nullptr;       // Pinned while transmitting.
+    FlightRecorder *recorder = nullptr;    // Gets every edge.
+    ControlSocket *control = nullptr;      // Status and runtime changes.
+    Cluster *cluster = nullptr;            // Opened group to send with.
+    LatencyStats *wakeup_stats = nullptr;  // Lateness of each wakeup.
+  };
+
+  Transmitter(const Options &options, HardwareControl *hardware,
+              std::unique_ptr<TimeSignalSource> source, const char *station);
+
+  Transmitter(const Transmitter &) = delete;
+  Transmitter &operator=(const Transmitter &) = delete;
+
+  // Receive SIGTERM and SIGINT through the event loop and start the log
+  // ring. Needs to be called before any other thread is started, so that
+  // they don't receive the signals.
+  // Returns 'false' on failure.
+  bool Init();
+
+  // Send until the given number of minutes is done or a signal arrives,
+  // then print a summary. Returns 'false' if an edge was missed with
+  // MissPolicy::ABORT.
+  bool Run();
+
+  // The scheduling the transmit loop ran with, e.g. "SCHED_FIFO 99".
+  const char *scheduling() const { return scheduling_; }
+
+ private:
+  // Instantiated for each backend, so that the hardware calls are direct.
+  template <class Hardware>
+  void TransmitLoop(Hardware *hw);
+
+  template <class Hardware>
+  void SetTxPower(Hardware *hw, CarrierPower power);
+  template <class Hardware>
+  int64_t KeyingLeadNs(const Hardware *hw, CarrierPower power) const;
+  template <class Hardware>
+  void SetCarrierPhase(Hardware *hw, double degrees);
+  template <class Hardware>
+  void FinishPhaseShiftBefore(Hardware *hw, const struct timespec &deadline);
+
+  void StartCarrier(HardwareControl *hw, int frequency);
+  void StopCarrier(HardwareControl *hw);
+  bool WaitUntil(const struct timespec &ts);
+  struct timespec EdgeDeadline(const struct timespec &edge_time) const;
+  int64_t WaitForEdge(const struct timespec &ts);
+  void UpdatePPS();
+  bool CheckClockQuality();
+  void CountMiss();
+  int ShortestEdgeIntervalUs(time_t minute);
+  const char *SetupScheduling(time_t minute);
+  void PrintLocalTime(time_t t);
+  void PrintModulationChart(TimeSignalSource::ModulationSpan mod);
+  void PrintPhaseSummary(TimeSignalSource::PhaseSpan phase);
+
+  const Options options_;
+  HardwareControl *const hardware_;
+  std::unique_ptr<TimeSignalSource> time_source_;
+
+  EventLoop event_loop_;
+  LogRing log_ring_;
+  ControlSocket::Status status_;
+  const char *scheduling_ = "";
+
+  // Settings that can change while running.
+  int time_offset_s_;
+  bool carrier_only_;
+  bool phase_modulation_;
+
+  int interrupted_ = 0;  // Signal that stopped us.
+  bool aborted_ = false;
+  bool clock_changed_ = false;
+  bool carrier_running_ = false;
+  CarrierPower tx_power_ = CarrierPower::OFF;  // Last one sent.
+
+  // When following the leader of a group, our system clock minus the
+  // leader's, so that edges are sent on the leader's clock.
+  int64_t leader_offset_ns_ = 0;
+  Cluster::Frame leader_frame_;  // Published or followed frame.
+  uint32_t leader_id_ = 0;
+};
+
+#endif  // TRANSMITTER_H
@@ -0,0 +1,155 @@
+// -*- mode: c++; c-basic-offset: 2; indent-tabs-mode: nil; -*-
+// Part of txtempus, a LF time signal transmitter.
+// Copyright (C) 2018 Henner Zeller <h.zeller@acm.org>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#ifndef TXTEMPUS_H
+#define TXTEMPUS_H
+
+// C interface of libtxtempus, to embed the time signal encoders, their edge
+// schedules and the hardware control into other programs.
+//
+// Objects are not thread safe, but different objects can be used in
+// different threads. There should only be one hardware object at a time, as
+// it owns the clock and attenuation pins.
+
+#include <stddef.h>
+#include <stdint.h>
+#include <time.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Incremented with incompatible changes of this interface.
+#define TXTEMPUS_API_VERSION 2
+
+// Returns the TXTEMPUS_API_VERSION the library was built with.
+int txtempus_api_version(void);
+
+// Hardware platform of the board we're running on, e.g. "rpi". The library
+// contains all backends that could be built and uses this one.
+const char *txtempus_platform(void);
+
+enum txtempus_power {
+  TXTEMPUS_POWER_OFF,
+  TXTEMPUS_POWER_LOW,
+  TXTEMPUS_POWER_HIGH,
+};
+
+// -- Frame encoding
+
+typedef struct txtempus_encoder txtempus_encoder;
+
+// Create the encoder for the given service, e.g. "DCF77" (case insensitive).
+// Returns NULL if there is no such service.
+txtempus_encoder *txtempus_encoder_new(const char *service);
+
+// Create an encoder playing back a schedule file generated with
+// txtempus-mkschedule. Returns NULL if it can't be opened.
+txtempus_encoder *txtempus_encoder_open_schedule(const char *filename);
+
+void txtempus_encoder_free(txtempus_encoder *encoder);
+
+int txtempus_encoder_carrier_hz(const txtempus_encoder *encoder);
+
+// Prepare the minute starting at the given time, which must be divisible
+// by 60; the following functions return its modulation.
+void txtempus_encoder_prepare_minute(txtempus_encoder *encoder, time_t minute);
+
+// Change of the carrier power; the last one of a second has a duration of
+// zero and lasts until the end of it.
+struct txtempus_modulation {
+  int power;  // enum txtempus_power
+  int32_t duration_ns;
+};
+
+// Write up to "max_changes" power changes of the given second (0..59) of the
+// prepared minute. Returns the total number of changes in that second.
+int txtempus_encoder_get_second(txtempus_encoder *encoder, int second,
+                                struct txtempus_modulation *changes,
+                                int max_changes);
+
+// Change of the carrier phase, relative to the unmodulated carrier.
+struct txtempus_phase_change {
+  int32_t offset_ns;  // Since the beginning of the second.
+  double phase_degrees;
+};
+
+// Write up to "max_changes" phase changes of the given second of the
+// prepared minute. Returns the total number of changes in that second.
+int txtempus_encoder_get_phase(txtempus_encoder *encoder, int second,
+                               struct txtempus_phase_change *changes,
+                               int max_changes);
+
+// -- Edge schedule
+
+enum txtempus_edge_type {
+  TXTEMPUS_EDGE_POWER,
+  TXTEMPUS_EDGE_PHASE,
+};
+
+struct txtempus_edge {
+  int64_t time_ns;  // Since the epoch.
+  int type;         // enum txtempus_edge_type
+  int power;        // enum txtempus_power, for power edges.
+  double phase_degrees;  // For phase edges.
+};
+
+// Encode "minutes" consecutive minutes, starting with "first_minute"
+// (divisible by 60), and write up to "max_edges" of their edges in
+// chronological order. Phase changes are only included if "with_phase" is
+// non-zero. Returns the total number of edges; call with max_edges = 0 to
+// find the size of the array needed.
+size_t txtempus_encoder_get_edges(txtempus_encoder *encoder,
+                                  time_t first_minute, int minutes,
+                                  int with_phase, struct txtempus_edge *edges,
+                                  size_t max_edges);
+
+// -- Hardware
+
+typedef struct txtempus_hardware txtempus_hardware;
+
+// Initialize the hardware of the platform. Usually needs root.
+// Returns NULL on failure; the reason is printed to stderr.
+txtempus_hardware *txtempus_hardware_open(void);
+
+// Stop the carrier and release the hardware.
+void txtempus_hardware_close(txtempus_hardware *hw);
+
+// Start the carrier as close as possible to the given frequency. Returns the
+// frequency it could configure or -1 if that was not possible.
+double txtempus_hardware_start_clock(txtempus_hardware *hw,
+                                     double frequency_hz);
+void txtempus_hardware_stop_clock(txtempus_hardware *hw);
+
+// Switch the output of the running carrier on (non-zero) or off.
+void txtempus_hardware_enable_output(txtempus_hardware *hw, int on);
+
+void txtempus_hardware_set_power(txtempus_hardware *hw, int power);
+
+// Average time set_power() takes to key the carrier on or off at the end of a
+// carrier cycle; call it that much earlier. 0 if the platform can't do that.
+int64_t txtempus_hardware_keying_latency_ns(const txtempus_hardware *hw);
+
+// Returns when the shift is done, or 0 if the platform can't do phase
+// modulation.
+int txtempus_hardware_set_phase(txtempus_hardware *hw, double degrees);
+
+#ifdef __cplusplus
+}  // extern "C"
+#endif
+
+#endif  // TXTEMPUS_H
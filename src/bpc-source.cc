@@ -0,0 +1,98 @@
+// -*- mode: c++; c-basic-offset: 2; indent-tabs-mode: nil; -*-
+// Part of txtempus, a LF time signal transmitter.
+// Copyright (C) 2018 Henner Zeller <h.zeller@acm.org>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#include <cstdint>
+#include <ctime>
+#include <iterator>
+
+#include "carrier-power.h"
+#include "station-spec.h"
+#include "time-signal-source.h"
+
+// https://en.wikipedia.org/wiki/BPC_(time_signal)
+// The minute is sent as three identical 20 second frames that only differ
+// in their frame number. Each second carries a two bit symbol as carrier
+// reduction of 100ms (0) to 400ms (3); the first second of each frame is
+// not reduced. Big endian, in local time; if in CN, this is China Standard
+// Time.
+//
+// Fields per frame:
+//  1      frame number 0..2
+//  2      reserved
+//  3..4   hour 0..11
+//  5..7   minute
+//  8..9   day of week, 1 = Monday .. 7 = Sunday
+//  10     afternoon (high bit), even parity of seconds 1..9 (low bit)
+//  11..13 day of month
+//  14..15 month
+//  16..18 lower six bits of the year of the century
+//  19     its seventh bit (high bit), even parity of seconds 11..18 (low bit)
+static constexpr int kHighBit = 1;
+static constexpr int kLowBit = 0;
+
+static constexpr FieldSpec kBPCFields[] = {
+    {FieldValue::FRAME_NUMBER, FieldEncoding::BINARY, 1, 1},
+    {FieldValue::HOUR_12, FieldEncoding::BINARY, 3, 2},
+    {FieldValue::MINUTE, FieldEncoding::BINARY, 5, 3},
+    {FieldValue::DAY_OF_WEEK_ISO, FieldEncoding::BINARY, 8, 2},
+    {FieldValue::PM, FieldEncoding::BINARY, 10, 1, kHighBit},
+    {FieldValue::DAY_OF_MONTH, FieldEncoding::BINARY, 11, 3},
+    {FieldValue::MONTH, FieldEncoding::BINARY, 14, 2},
+    {FieldValue::YEAR_OF_CENTURY, FieldEncoding::BINARY, 16, 3},
+    {FieldValue::YEAR_OF_CENTURY, FieldEncoding::BINARY, 19, 1, kHighBit,
+     /*shift=*/6},
+};
+
+static constexpr ParitySpec kBPCParities[] = {
+    {1, 9, kAllSymbolBits, 10, kLowBit},
+    {11, 18, kAllSymbolBits, 19, kLowBit},
+};
+
+static constexpr PulseSpec kBPCSymbols[] = {
+    {2, {{CarrierPower::LOW, Millis(100)}, {CarrierPower::HIGH, 0}}},
+    {2, {{CarrierPower::LOW, Millis(200)}, {CarrierPower::HIGH, 0}}},
+    {2, {{CarrierPower::LOW, Millis(300)}, {CarrierPower::HIGH, 0}}},
+    {2, {{CarrierPower::LOW, Millis(400)}, {CarrierPower::HIGH, 0}}},
+};
+
+static constexpr StationSpec kBPCSpec = {
+    /*time_offset_seconds=*/0,
+    /*utc=*/false,
+    /*msb_first=*/true,
+    /*frame_seconds=*/20,
+    /*bits_per_second=*/2,
+    kBPCFields,
+    std::size(kBPCFields),
+    kBPCParities,
+    std::size(kBPCParities),
+    /*marker_seconds=*/1ULL << 0,
+    /*marker=*/{1, {{CarrierPower::HIGH, 0}}},
+    kBPCSymbols,
+};
+
+void BPCTimeSignalSource::PrepareMinute(time_t t) {
+  EncodeSpecMinute<kBPCSpec>(t, &calendars_, symbols_);
+}
+
+TimeSignalSource::ModulationSpan BPCTimeSignalSource::GetModulationSpan(
+    int second) {
+  return SpecModulationForSecond<kBPCSpec>(symbols_, second);
+}
+
+int BPCTimeSignalSource::GetSymbolForSecond(int second) const {
+  return SpecSymbolForSecond<kBPCSpec>(symbols_, second);
+}
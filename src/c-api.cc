@@ -0,0 +1,182 @@
+// -*- mode: c++; c-basic-offset: 2; indent-tabs-mode: nil; -*-
+// Part of txtempus, a LF time signal transmitter.
+// Copyright (C) 2018 Henner Zeller <h.zeller@acm.org>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+// Implementation of the C interface in txtempus.h on top of the C++ classes.
+
+#include "txtempus.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <ctime>
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include "carrier-power.h"
+#include "edge-schedule.h"
+#include "hardware-control.h"
+#include "schedule-file.h"
+#include "time-signal-source.h"
+
+static_assert((int)CarrierPower::OFF == TXTEMPUS_POWER_OFF &&
+                  (int)CarrierPower::LOW == TXTEMPUS_POWER_LOW &&
+                  (int)CarrierPower::HIGH == TXTEMPUS_POWER_HIGH,
+              "C API power levels must match CarrierPower");
+
+struct txtempus_encoder {
+  std::unique_ptr<TimeSignalSource> source;
+  std::vector<ModulationEdge> edges;  // Reused between calls.
+};
+
+struct txtempus_hardware {
+  std::unique_ptr<HardwareControl> control;
+};
+
+int txtempus_api_version(void) { return TXTEMPUS_API_VERSION; }
+
+const char *txtempus_platform(void) {
+  return HardwareControl::DetectPlatform();
+}
+
+txtempus_encoder *txtempus_encoder_new(const char *service) {
+  std::unique_ptr<TimeSignalSource> source = CreateTimeSignalSource(service);
+  if (!source) return nullptr;
+  return new txtempus_encoder{std::move(source), {}};
+}
+
+txtempus_encoder *txtempus_encoder_open_schedule(const char *filename) {
+  std::unique_ptr<ScheduleFileSource> source(new ScheduleFileSource());
+  if (!source->Open(filename)) return nullptr;
+  return new txtempus_encoder{std::move(source), {}};
+}
+
+void txtempus_encoder_free(txtempus_encoder *encoder) { delete encoder; }
+
+int txtempus_encoder_carrier_hz(const txtempus_encoder *encoder) {
+  return encoder->source->GetCarrierFrequencyHz();
+}
+
+void txtempus_encoder_prepare_minute(txtempus_encoder *encoder, time_t minute) {
+  encoder->source->PrepareMinute(minute);
+}
+
+int txtempus_encoder_get_second(txtempus_encoder *encoder, int second,
+                                struct txtempus_modulation *changes,
+                                int max_changes) {
+  const TimeSignalSource::ModulationSpan modulation =
+      encoder->source->GetModulationSpan(second);
+  const int count = modulation.size();
+  for (int i = 0; i < std::min(count, max_changes); ++i) {
+    changes[i].power = (int)modulation[i].power;
+    changes[i].duration_ns = modulation[i].duration_ns;
+  }
+  return count;
+}
+
+int txtempus_encoder_get_phase(txtempus_encoder *encoder, int second,
+                               struct txtempus_phase_change *changes,
+                               int max_changes) {
+  const TimeSignalSource::PhaseSpan phase =
+      encoder->source->GetPhaseSpan(second);
+  const int count = phase.size();
+  for (int i = 0; i < std::min(count, max_changes); ++i) {
+    changes[i].offset_ns = phase[i].offset_ns;
+    changes[i].phase_degrees = phase[i].phase_degrees;
+  }
+  return count;
+}
+
+size_t txtempus_encoder_get_edges(txtempus_encoder *encoder,
+                                  time_t first_minute, int minutes,
+                                  int with_phase, struct txtempus_edge *edges,
+                                  size_t max_edges) {
+  size_t count = 0;
+  for (int m = 0; m < minutes; ++m) {
+    const time_t minute = first_minute + m * 60;
+    encoder->edges.clear();
+    AppendMinuteEdges(encoder->source.get(), minute, with_phase,
+                      &encoder->edges);
+    for (const ModulationEdge &edge : encoder->edges) {
+      if (count < max_edges) {
+        struct txtempus_edge *out = &edges[count];
+        out->time_ns = minute * 1000000000LL + edge.offset_ns;
+        out->type = edge.type == ModulationEdge::Type::POWER
+                        ? TXTEMPUS_EDGE_POWER
+                        : TXTEMPUS_EDGE_PHASE;
+        out->power = (int)edge.power;
+        out->phase_degrees = edge.phase_degrees;
+      }
+      ++count;
+    }
+  }
+  return count;
+}
+
+txtempus_hardware *txtempus_hardware_open(void) {
+  const char *platform = HardwareControl::DetectPlatform();
+  std::unique_ptr<txtempus_hardware> hw(
+      new txtempus_hardware{HardwareControl::Create(platform)});
+  if (!hw->control) {
+    fprintf(stderr, "Platform %s not available; built with %s\n", platform,
+            HardwareControl::AvailablePlatforms());
+    return nullptr;
+  }
+  if (!hw->control->Init()) return nullptr;
+  return hw.release();
+}
+
+void txtempus_hardware_close(txtempus_hardware *hw) {
+  if (!hw) return;
+  hw->control->StopClock();
+  delete hw;
+}
+
+double txtempus_hardware_start_clock(txtempus_hardware *hw,
+                                     double frequency_hz) {
+  return hw->control->StartClock(frequency_hz);
+}
+
+void txtempus_hardware_stop_clock(txtempus_hardware *hw) {
+  hw->control->StopClock();
+}
+
+void txtempus_hardware_enable_output(txtempus_hardware *hw, int on) {
+  hw->control->EnableClockOutput(on);
+}
+
+void txtempus_hardware_set_power(txtempus_hardware *hw, int power) {
+  hw->control->SetTxPower((CarrierPower)power);
+}
+
+int64_t txtempus_hardware_keying_latency_ns(const txtempus_hardware *hw) {
+  return hw->control->KeyingLatencyNs();
+}
+
+int txtempus_hardware_set_phase(txtempus_hardware *hw, double degrees) {
+  if (!hw->control->SetCarrierPhase(degrees)) return 0;
+  struct timespec end;
+  if (hw->control->PhaseShiftEnd(&end)) {
+    while (clock_nanosleep(CLOCK_REALTIME, TIMER_ABSTIME, &end, nullptr) ==
+           EINTR) {
+    }
+    hw->control->FinishPhaseShift();
+  }
+  return 1;
+}
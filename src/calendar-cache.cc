@@ -0,0 +1,67 @@
+// -*- mode: c++; c-basic-offset: 2; indent-tabs-mode: nil; -*-
+// Part of txtempus, a LF time signal transmitter.
+// Copyright (C) 2018 Henner Zeller <h.zeller@acm.org>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+
+#include "calendar-cache.h"
+
+static bool SameOffset(const struct tm &a, const struct tm &b) {
+  return a.tm_gmtoff == b.tm_gmtoff && a.tm_isdst == b.tm_isdst;
+}
+
+void CalendarCache::BreakDown(time_t t, struct tm *result) {
+  if (t < start_ || t >= end_) StartStretch(t);
+  const int second_of_day = start_second_of_day_ + (int)(t - start_);
+  *result = start_fields_;
+  result->tm_hour = second_of_day / 3600;
+  result->tm_min = second_of_day / 60 % 60;
+  result->tm_sec = second_of_day % 60;
+}
+
+void CalendarCache::BreakDownSlow(time_t t, struct tm *result) const {
+  if (zone_ == UTC) {
+    gmtime_r(&t, result);
+  } else {
+    localtime_r(&t, result);
+  }
+}
+
+void CalendarCache::StartStretch(time_t t) {
+  BreakDownSlow(t, &start_fields_);
+  start_ = t;
+  start_second_of_day_ = start_fields_.tm_hour * 3600 +
+                         start_fields_.tm_min * 60 + start_fields_.tm_sec;
+  end_ = t + 86400 - start_second_of_day_;  // Midnight, at this offset.
+
+  struct tm probe;
+  BreakDownSlow(end_ - 1, &probe);
+  if (SameOffset(probe, start_fields_)) return;
+
+  // The offset changes before midnight; find the first second with the new
+  // one, which ends this stretch.
+  time_t same = t;
+  time_t changed = end_ - 1;
+  while (changed - same > 1) {
+    const time_t middle = same + (changed - same) / 2;
+    BreakDownSlow(middle, &probe);
+    if (SameOffset(probe, start_fields_)) {
+      same = middle;
+    } else {
+      changed = middle;
+    }
+  }
+  end_ = changed;
+}
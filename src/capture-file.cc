@@ -0,0 +1,214 @@
+// -*- mode: c++; c-basic-offset: 2; indent-tabs-mode: nil; -*-
+// Part of txtempus, a LF time signal transmitter.
+// Copyright (C) 2018 Henner Zeller <h.zeller@acm.org>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+
+#include "capture-file.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+
+CaptureFile::~CaptureFile() {
+  if (map_) munmap(const_cast<uint8_t *>(map_), map_size_);
+}
+
+bool CaptureFile::Map(const char *filename) {
+  const int fd = open(filename, O_RDONLY | O_CLOEXEC);
+  if (fd < 0) {
+    perror(filename);
+    return false;
+  }
+  struct stat st;
+  if (fstat(fd, &st) < 0 || st.st_size == 0) {
+    fprintf(stderr, "%s: empty or not a regular file\n", filename);
+    close(fd);
+    return false;
+  }
+  void *map = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (map == MAP_FAILED) {
+    perror("mmap");
+    return false;
+  }
+  // We read the whole file once from start to end.
+  madvise(map, st.st_size, MADV_SEQUENTIAL | MADV_WILLNEED);
+  map_ = static_cast<const uint8_t *>(map);
+  map_size_ = st.st_size;
+  return true;
+}
+
+static uint16_t Read16(const uint8_t *p) { return p[0] | p[1] << 8; }
+static uint32_t Read32(const uint8_t *p) {
+  return p[0] | p[1] << 8 | p[2] << 16 | (uint32_t)p[3] << 24;
+}
+
+bool CaptureFile::OpenWav(const char *filename, bool iq) {
+  if (!Map(filename)) return false;
+  if (map_size_ < 12 || memcmp(map_, "RIFF", 4) != 0 ||
+      memcmp(map_ + 8, "WAVE", 4) != 0) {
+    fprintf(stderr, "%s: not a WAV file\n", filename);
+    return false;
+  }
+  int format = -1, channels = 0, bits = 0;
+  for (size_t pos = 12; pos + 8 <= map_size_;) {
+    const uint8_t *chunk = map_ + pos;
+    const size_t size = Read32(chunk + 4);
+    if (memcmp(chunk, "fmt ", 4) == 0 && size >= 16 &&
+        pos + 8 + size <= map_size_) {
+      format = Read16(chunk + 8);
+      channels = Read16(chunk + 10);
+      sample_rate_ = Read32(chunk + 12);
+      bits = Read16(chunk + 22);
+      if (format == 0xfffe && size >= 26) {  // WAVE_FORMAT_EXTENSIBLE
+        format = Read16(chunk + 32);         // First bytes of the sub format.
+      }
+    } else if (memcmp(chunk, "data", 4) == 0) {
+      if (format < 0) break;
+      data_ = chunk + 8;
+      // Recorders that are interrupted leave the size at zero or too large.
+      const size_t available = map_size_ - (pos + 8);
+      const size_t data_size = (size == 0 || size > available) ? available
+                                                               : size;
+      frame_bytes_ = channels * bits / 8;
+      if (frame_bytes_ > 0) frames_ = data_size / frame_bytes_;
+      break;
+    }
+    pos += 8 + size + (size & 1);  // Chunks are padded to even size.
+  }
+  if (!data_ || frame_bytes_ == 0) {
+    fprintf(stderr, "%s: no audio data found\n", filename);
+    return false;
+  }
+
+  sample_bytes_ = bits / 8;
+  if (format == 3 && bits == 32) {
+    type_ = SampleType::F32;
+  } else if (format == 1 && bits == 8) {
+    type_ = SampleType::U8;
+  } else if (format == 1 && bits == 16) {
+    type_ = SampleType::S16;
+  } else if (format == 1 && bits == 24) {
+    type_ = SampleType::S24;
+  } else if (format == 1 && bits == 32) {
+    type_ = SampleType::S32;
+  } else {
+    fprintf(stderr, "%s: unsupported WAV format %d with %d bits\n", filename,
+            format, bits);
+    return false;
+  }
+  if (iq && channels != 2) {
+    fprintf(stderr, "%s: I/Q needs two channels, got %d\n", filename,
+            channels);
+    return false;
+  }
+  complex_ = iq;
+  return true;
+}
+
+bool CaptureFile::OpenRaw(const char *filename, const char *format,
+                          int sample_rate) {
+  static constexpr struct {
+    const char *name;
+    SampleType type;
+    int sample_bytes;
+    bool complex;
+  } kFormats[] = {
+      {"s16", SampleType::S16, 2, false},  {"f32", SampleType::F32, 4, false},
+      {"cu8", SampleType::U8, 1, true},    {"cs16", SampleType::S16, 2, true},
+      {"cf32", SampleType::F32, 4, true},
+  };
+  for (const auto &f : kFormats) {
+    if (strcmp(f.name, format) != 0) continue;
+    if (sample_rate <= 0) {
+      fprintf(stderr, "Raw captures need a sample rate\n");
+      return false;
+    }
+    if (!Map(filename)) return false;
+    type_ = f.type;
+    sample_bytes_ = f.sample_bytes;
+    complex_ = f.complex;
+    frame_bytes_ = sample_bytes_ * (complex_ ? 2 : 1);
+    sample_rate_ = sample_rate;
+    data_ = map_;
+    frames_ = map_size_ / frame_bytes_;
+    return true;
+  }
+  fprintf(stderr, "Unknown sample format '%s'\n", format);
+  return false;
+}
+
+template <CaptureFile::SampleType type>
+inline float CaptureFile::ToFloat(const uint8_t *p) {
+  switch (type) {
+    case SampleType::U8: return (p[0] - 127.5f) / 128.0f;
+    case SampleType::S16: return (int16_t)Read16(p) / 32768.0f;
+    case SampleType::S24:
+      return (int32_t)(p[0] << 8 | p[1] << 16 | (uint32_t)p[2] << 24) /
+             2147483648.0f;
+    case SampleType::S32: return (int32_t)Read32(p) / 2147483648.0f;
+    case SampleType::F32: {
+      float f;
+      memcpy(&f, p, sizeof(f));
+      return f;
+    }
+  }
+  return 0;
+}
+
+template <CaptureFile::SampleType type>
+void CaptureFile::Convert(int64_t first, int count, int stride, float *i,
+                          float *q) const {
+  const uint8_t *p = data_ + first * frame_bytes_;
+  for (int n = 0; n < count; ++n, p += frame_bytes_) {
+    i[n * stride] = ToFloat<type>(p);
+    if (complex_) q[n * stride] = ToFloat<type>(p + sample_bytes_);
+  }
+}
+
+void CaptureFile::GetFrames(int64_t first, int count, int stride, float *i,
+                            float *q) const {
+  // Beyond the end of the capture, there is silence.
+  const int available = (first >= frames_) ? 0
+                        : (frames_ - first < count) ? frames_ - first
+                                                    : count;
+  for (int n = available; n < count; ++n) {
+    i[n * stride] = 0;
+    if (complex_) q[n * stride] = 0;
+  }
+  switch (type_) {
+    case SampleType::U8:
+      Convert<SampleType::U8>(first, available, stride, i, q);
+      break;
+    case SampleType::S16:
+      Convert<SampleType::S16>(first, available, stride, i, q);
+      break;
+    case SampleType::S24:
+      Convert<SampleType::S24>(first, available, stride, i, q);
+      break;
+    case SampleType::S32:
+      Convert<SampleType::S32>(first, available, stride, i, q);
+      break;
+    case SampleType::F32:
+      Convert<SampleType::F32>(first, available, stride, i, q);
+      break;
+  }
+}
@@ -0,0 +1,32 @@
+// -*- mode: c++; c-basic-offset: 2; indent-tabs-mode: nil; -*-
+// Part of txtempus, a LF time signal transmitter.
+// Copyright (C) 2018 Henner Zeller <h.zeller@acm.org>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#include "clock-quality.h"
+
+#include <sys/timex.h>
+
+#include <cstdint>
+
+bool ReadClockQuality(ClockQuality *quality) {
+  struct timex tx = {};  // modes = 0: only read.
+  const int state = adjtimex(&tx);
+  if (state < 0) return false;
+  quality->synchronized = state != TIME_ERROR && !(tx.status & STA_UNSYNC);
+  quality->max_error_us = tx.maxerror;
+  quality->est_error_us = tx.esterror;
+  return true;
+}
@@ -0,0 +1,354 @@
+// -*- mode: c++; c-basic-offset: 2; indent-tabs-mode: nil; -*-
+// Part of txtempus, a LF time signal transmitter.
+// Copyright (C) 2018 Henner Zeller <h.zeller@acm.org>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#include "cluster.h"
+
+#include <arpa/inet.h>
+#include <net/if.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <string>
+
+#include "carrier-power.h"
+#include "time-signal-source.h"
+
+namespace {
+constexpr char kClusterMagic[4] = {'T', 'X', 'C', 'L'};
+
+// A node not heard from for this long is gone.
+constexpr int64_t kNodeTimeoutNs = 3 * 1000000000LL;
+
+// Heartbeats from the leader needed before we trust its time base.
+constexpr int kMinTimeSamples = 4;
+
+constexpr int kMaxChanges = Cluster::kMaxChanges;
+constexpr uint8_t kUnusedChange = 0xff;  // Power of unused changes.
+
+enum MessageType : uint8_t { HEARTBEAT = 1, FRAME = 2 };
+
+struct MessageHeader {
+  char magic[4];  // kClusterMagic
+  uint8_t type;   // MessageType
+  uint8_t reserved[3];
+  uint32_t node_id;
+  uint32_t reserved2;
+  int64_t sent_ns;  // CLOCK_REALTIME of the sender.
+  char station[16];
+};
+static_assert(sizeof(MessageHeader) == 40, "Unexpected padding");
+
+struct SecondMessage {
+  uint32_t duration_ns[kMaxChanges];
+  uint8_t power[kMaxChanges];  // kUnusedChange after the last one.
+};
+
+struct FrameMessage {
+  MessageHeader header;
+  int64_t minute;
+  int64_t transmit_time;
+  SecondMessage seconds[60];
+};
+static_assert(sizeof(FrameMessage) == 1256, "Unexpected padding");
+
+int64_t ToNanos(const struct timespec &ts) {
+  return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+int64_t NowNanos(clockid_t clock) {
+  struct timespec ts;
+  clock_gettime(clock, &ts);
+  return ToNanos(ts);
+}
+
+// Number of changes in a received second, or -1 if it is not one we can
+// send: no changes, unknown power values or longer than a second.
+int ChangeCount(const SecondMessage &second) {
+  int count = 0;
+  while (count < kMaxChanges && second.power[count] != kUnusedChange) {
+    ++count;
+  }
+  if (count == 0) return -1;
+  for (int i = count; i < kMaxChanges; ++i) {
+    if (second.power[i] != kUnusedChange) return -1;
+  }
+  int64_t total_ns = 0;
+  for (int i = 0; i < count; ++i) {
+    switch ((CarrierPower)second.power[i]) {
+      case CarrierPower::OFF:
+      case CarrierPower::LOW:
+      case CarrierPower::HIGH:
+        break;
+      default:
+        return -1;
+    }
+    total_ns += second.duration_ns[i];
+  }
+  return total_ns < kNanosPerSecond ? count : -1;
+}
+
+void FillHeader(MessageType type, uint32_t node_id, const char *station,
+                MessageHeader *header) {
+  memcpy(header->magic, kClusterMagic, sizeof(header->magic));
+  header->type = type;
+  header->node_id = node_id;
+  snprintf(header->station, sizeof(header->station), "%s", station);
+  header->sent_ns = NowNanos(CLOCK_REALTIME);  // Last, as close to sending.
+}
+}  // namespace
+
+bool Cluster::Frame::SetSecond(int s,
+                               TimeSignalSource::ModulationSpan modulation) {
+  if (modulation.size() > kMaxChanges) return false;
+  seconds[s].count = modulation.size();
+  std::copy(modulation.begin(), modulation.end(), seconds[s].changes);
+  return true;
+}
+
+Cluster::Cluster(uint32_t node_id) : node_id_(node_id) {}
+
+Cluster::~Cluster() {
+  if (fd_ >= 0) close(fd_);
+}
+
+bool Cluster::Open(const char *group) {
+  std::string address = group;
+  unsigned int interface = 0;
+  if (size_t slash = address.find('/'); slash != std::string::npos) {
+    const std::string name = address.substr(slash + 1);
+    interface = if_nametoindex(name.c_str());
+    if (interface == 0) {
+      perror(name.c_str());
+      return false;
+    }
+    address.resize(slash);
+  }
+  const size_t colon = address.rfind(':');
+  const int port = colon == std::string::npos
+                       ? 0
+                       : atoi(address.c_str() + colon + 1);
+  if (port <= 0 || port > 65535) {
+    fprintf(stderr, "%s: expected <multicast-address>:<port>\n", group);
+    return false;
+  }
+  address.resize(colon);
+  group_addr_.sin_family = AF_INET;
+  group_addr_.sin_port = htons(port);
+  if (inet_pton(AF_INET, address.c_str(), &group_addr_.sin_addr) != 1 ||
+      !IN_MULTICAST(ntohl(group_addr_.sin_addr.s_addr))) {
+    fprintf(stderr, "%s: not an IPv4 multicast address\n", address.c_str());
+    return false;
+  }
+
+  fd_ = socket(AF_INET, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+  if (fd_ < 0) {
+    perror("socket");
+    return false;
+  }
+  // Several instances on the same host all receive the group's messages.
+  const int on = 1;
+  if (setsockopt(fd_, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on)) < 0 ||
+      setsockopt(fd_, SOL_SOCKET, SO_TIMESTAMPNS, &on, sizeof(on)) < 0 ||
+      setsockopt(fd_, IPPROTO_IP, IP_MULTICAST_LOOP, &on, sizeof(on)) < 0) {
+    perror("setsockopt");
+    return false;
+  }
+  if (bind(fd_, (struct sockaddr *)&group_addr_, sizeof(group_addr_)) < 0) {
+    perror("bind");
+    return false;
+  }
+  struct ip_mreqn membership = {};
+  membership.imr_multiaddr = group_addr_.sin_addr;
+  membership.imr_ifindex = interface;
+  if (setsockopt(fd_, IPPROTO_IP, IP_ADD_MEMBERSHIP, &membership,
+                 sizeof(membership)) < 0) {
+    perror("Joining multicast group");
+    return false;
+  }
+  if (interface &&
+      setsockopt(fd_, IPPROTO_IP, IP_MULTICAST_IF, &membership,
+                 sizeof(membership)) < 0) {
+    perror("IP_MULTICAST_IF");
+    return false;
+  }
+  return true;
+}
+
+void Cluster::HandleMessages() {
+  FrameMessage buffer;
+  char control[CMSG_SPACE(sizeof(struct timespec))];
+  for (;;) {
+    struct iovec iov = {&buffer, sizeof(buffer)};
+    struct msghdr msg = {};
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+    const ssize_t size = recvmsg(fd_, &msg, MSG_DONTWAIT);
+    if (size < 0) {
+      if (errno == EINTR) continue;
+      return;  // EAGAIN: all done.
+    }
+    // The kernel's receive timestamp doesn't include our wakeup latency.
+    struct timespec received;
+    bool have_timestamp = false;
+    for (struct cmsghdr *c = CMSG_FIRSTHDR(&msg); c; c = CMSG_NXTHDR(&msg, c)) {
+      if (c->cmsg_level == SOL_SOCKET && c->cmsg_type == SCM_TIMESTAMPNS) {
+        memcpy(&received, CMSG_DATA(c), sizeof(received));
+        have_timestamp = true;
+      }
+    }
+    if (!have_timestamp) clock_gettime(CLOCK_REALTIME, &received);
+    HandleMessage((const uint8_t *)&buffer, size, received);
+  }
+}
+
+void Cluster::HandleMessage(const uint8_t *buffer, size_t size,
+                            const struct timespec &received) {
+  if (size < sizeof(MessageHeader)) return;
+  const MessageHeader *header = (const MessageHeader *)buffer;
+  if (memcmp(header->magic, kClusterMagic, sizeof(header->magic)) != 0) {
+    return;
+  }
+  if (header->node_id == node_id_) return;  // Our own, looped back.
+  NoteHeard(header->node_id, NowNanos(CLOCK_MONOTONIC));
+
+  switch (header->type) {
+    case HEARTBEAT:
+      if (header->node_id != leader_id()) return;
+      if (header->node_id != time_base_id_) {  // New leader, start over.
+        time_base_id_ = header->node_id;
+        time_sample_count_ = 0;
+        next_time_sample_ = 0;
+      }
+      AddTimeSample(ToNanos(received) - header->sent_ns);
+      break;
+
+    case FRAME: {
+      if (size != sizeof(FrameMessage)) return;
+      const FrameMessage *message = (const FrameMessage *)buffer;
+      int counts[60];
+      for (int s = 0; s < 60; ++s) {
+        counts[s] = ChangeCount(message->seconds[s]);
+        if (counts[s] < 0) return;
+      }
+      const int slot = message->minute / 60 % 2;
+      Frame &frame = frames_[slot];
+      frame.minute = message->minute;
+      frame.transmit_time = message->transmit_time;
+      memcpy(frame.station, header->station, sizeof(frame.station));
+      frame.station[sizeof(frame.station) - 1] = '\0';
+      for (int s = 0; s < 60; ++s) {
+        frame.seconds[s].count = counts[s];
+        for (int i = 0; i < counts[s]; ++i) {
+          frame.seconds[s].changes[i] = {
+              (CarrierPower)message->seconds[s].power[i],
+              (int32_t)message->seconds[s].duration_ns[i]};
+        }
+      }
+      frame_sender_[slot] = header->node_id;
+      break;
+    }
+  }
+}
+
+void Cluster::AddTimeSample(int64_t offset_ns) {
+  time_samples_[next_time_sample_] = offset_ns;
+  next_time_sample_ = (next_time_sample_ + 1) % kTimeSamples;
+  if (time_sample_count_ < kTimeSamples) ++time_sample_count_;
+  // Messages can only be delayed, so the smallest difference is closest
+  // to the true offset.
+  leader_offset_ns_ =
+      *std::min_element(time_samples_, time_samples_ + time_sample_count_);
+}
+
+void Cluster::SendHeartbeat(const char *station) {
+  MessageHeader header = {};
+  FillHeader(HEARTBEAT, node_id_, station, &header);
+  sendto(fd_, &header, sizeof(header), 0, (struct sockaddr *)&group_addr_,
+         sizeof(group_addr_));
+}
+
+void Cluster::NoteHeard(uint32_t node_id, int64_t now_ns) {
+  for (int i = 0; i < node_count_; ++i) {
+    if (nodes_[i].id == node_id) {
+      nodes_[i].last_heard_ns = now_ns;
+      return;
+    }
+  }
+  ForgetSilentNodes(now_ns);
+  if (node_count_ < kMaxNodes) nodes_[node_count_++] = {node_id, now_ns};
+}
+
+void Cluster::ForgetSilentNodes(int64_t now_ns) {
+  for (int i = 0; i < node_count_; /**/) {
+    if (now_ns - nodes_[i].last_heard_ns > kNodeTimeoutNs) {
+      nodes_[i] = nodes_[--node_count_];
+    } else {
+      ++i;
+    }
+  }
+}
+
+uint32_t Cluster::leader_id() {
+  ForgetSilentNodes(NowNanos(CLOCK_MONOTONIC));
+  uint32_t leader = node_id_;
+  for (int i = 0; i < node_count_; ++i) {
+    leader = std::max(leader, nodes_[i].id);
+  }
+  return leader;
+}
+
+bool Cluster::PublishFrame(const Frame &frame) {
+  FrameMessage message = {};
+  message.minute = frame.minute;
+  message.transmit_time = frame.transmit_time;
+  for (int s = 0; s < 60; ++s) {
+    const Frame::Second &second = frame.seconds[s];
+    memset(message.seconds[s].power, kUnusedChange, kMaxChanges);
+    for (int i = 0; i < second.count; ++i) {
+      message.seconds[s].power[i] = (uint8_t)second.changes[i].power;
+      message.seconds[s].duration_ns[i] = second.changes[i].duration_ns;
+    }
+  }
+  FillHeader(FRAME, node_id_, frame.station, &message.header);
+  return sendto(fd_, &message, sizeof(message), 0,
+                (struct sockaddr *)&group_addr_,
+                sizeof(group_addr_)) == sizeof(message);
+}
+
+bool Cluster::TakeFrame(time_t minute, Frame *frame) {
+  const int slot = minute / 60 % 2;
+  if (frames_[slot].minute != minute || frame_sender_[slot] != leader_id()) {
+    return false;
+  }
+  *frame = frames_[slot];
+  return true;
+}
+
+bool Cluster::have_time_base() {
+  return time_base_id_ == leader_id() &&
+         time_sample_count_ >= kMinTimeSamples;
+}
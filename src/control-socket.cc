@@ -0,0 +1,267 @@
+// -*- mode: c++; c-basic-offset: 2; indent-tabs-mode: nil; -*-
+// Part of txtempus, a LF time signal transmitter.
+// Copyright (C) 2018 Henner Zeller <h.zeller@acm.org>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#include "control-socket.h"
+
+#include <poll.h>
+#include <pthread.h>
+#include <sched.h>
+#include <strings.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <mutex>
+#include <string>
+#include <utility>
+
+ControlSocket::ControlSocket(SourceFactory factory) : factory_(factory) {}
+
+ControlSocket::~ControlSocket() {
+  if (thread_.joinable()) {
+    const uint64_t one = 1;
+    if (write(stop_fd_, &one, sizeof(one)) == sizeof(one)) thread_.join();
+  }
+  if (stop_fd_ >= 0) close(stop_fd_);
+  if (retire_fd_ >= 0) close(retire_fd_);
+  FreeRetiredSources();
+  if (listen_fd_ >= 0) {
+    close(listen_fd_);
+    unlink(path_.c_str());
+  }
+}
+
+bool ControlSocket::Start(const char *path) {
+  struct sockaddr_un addr = {};
+  addr.sun_family = AF_UNIX;
+  if (strlen(path) >= sizeof(addr.sun_path)) {
+    fprintf(stderr, "Control socket path too long: %s\n", path);
+    return false;
+  }
+  strncpy(addr.sun_path, path, sizeof(addr.sun_path) - 1);
+
+  listen_fd_ = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  if (listen_fd_ < 0) {
+    perror("control socket");
+    return false;
+  }
+  unlink(path);  // Left over from a previous run.
+  if (bind(listen_fd_, (struct sockaddr *)&addr, sizeof(addr)) < 0 ||
+      listen(listen_fd_, 4) < 0) {
+    perror(path);
+    return false;
+  }
+  path_ = path;
+  stop_fd_ = eventfd(0, EFD_CLOEXEC);
+  retire_fd_ = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+  if (stop_fd_ < 0 || retire_fd_ < 0) {
+    perror("eventfd");
+    return false;
+  }
+  thread_ = std::thread(&ControlSocket::Run, this);
+  return true;
+}
+
+void ControlSocket::PublishStatus(const Status &status) {
+  if (!status_lock_.try_lock()) return;
+  status_ = status;
+  status_lock_.unlock();
+}
+
+bool ControlSocket::TakeChanges(Changes *changes) {
+  if (!changes_lock_.try_lock()) return false;
+  const bool result = have_changes_;
+  if (have_changes_) {
+    *changes = std::move(changes_);
+    changes_ = Changes();  // Nothing to allocate or free.
+    have_changes_ = false;
+  }
+  changes_lock_.unlock();
+  return result;
+}
+
+void ControlSocket::RetireSource(std::unique_ptr<TimeSignalSource> source) {
+  TimeSignalSource *const retired = source.release();
+  for (std::atomic<TimeSignalSource *> &slot : retired_) {
+    TimeSignalSource *expected = nullptr;
+    if (slot.compare_exchange_strong(expected, retired)) {
+      const uint64_t one = 1;
+      if (write(retire_fd_, &one, sizeof(one)) < 0) {
+        // Counter full; the thread is woken up already.
+      }
+      return;
+    }
+  }
+  delete retired;  // Socket thread stuck for minutes; better than leaking.
+}
+
+void ControlSocket::FreeRetiredSources() {
+  for (std::atomic<TimeSignalSource *> &slot : retired_) {
+    delete slot.exchange(nullptr);
+  }
+}
+
+void ControlSocket::Run() {
+  // Whatever the main thread does, we never want to compete with it.
+  struct sched_param sp = {};
+  pthread_setschedparam(pthread_self(), SCHED_OTHER, &sp);
+
+  struct pollfd fds[3] = {{listen_fd_, POLLIN, 0},
+                          {stop_fd_, POLLIN, 0},
+                          {retire_fd_, POLLIN, 0}};
+  for (;;) {
+    if (poll(fds, 3, -1) < 0) continue;  // EINTR
+    if (fds[1].revents) return;
+    if (fds[2].revents & POLLIN) {
+      uint64_t count;
+      if (read(retire_fd_, &count, sizeof(count)) == sizeof(count)) {
+        FreeRetiredSources();
+      }
+    }
+    if (fds[0].revents & POLLIN) {
+      const int client = accept4(listen_fd_, nullptr, nullptr, SOCK_CLOEXEC);
+      if (client < 0) continue;
+      HandleClient(client);
+      close(client);
+    }
+  }
+}
+
+void ControlSocket::HandleClient(int fd) {
+  // Clients are expected to be local tools; don't let one hang us forever.
+  const struct timeval timeout = {5, 0};
+  setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+
+  char buffer[256];
+  size_t filled = 0;
+  for (;;) {
+    const ssize_t r = read(fd, buffer + filled, sizeof(buffer) - 1 - filled);
+    if (r <= 0) return;
+    filled += r;
+    buffer[filled] = '\0';
+    char *line_start = buffer;
+    char *eol;
+    while ((eol = strchr(line_start, '\n')) != nullptr) {
+      *eol = '\0';
+      const std::string reply = HandleRequest(line_start) + "\n";
+      if (write(fd, reply.data(), reply.size()) != (ssize_t)reply.size()) {
+        return;
+      }
+      line_start = eol + 1;
+    }
+    filled = strlen(line_start);
+    if (filled == sizeof(buffer) - 1) return;  // Overlong line.
+    memmove(buffer, line_start, filled + 1);
+  }
+}
+
+std::string ControlSocket::HandleRequest(char *line) {
+  const size_t len = strlen(line);
+  if (len > 0 && line[len - 1] == '\r') line[len - 1] = '\0';
+  char *saveptr = nullptr;
+  const char *command = strtok_r(line, " \t", &saveptr);
+  const char *arg = strtok_r(nullptr, " \t", &saveptr);
+  if (command == nullptr) return "error: empty request\n";
+
+  if (strcasecmp(command, "status") == 0) {
+    Status s;
+    {
+      const std::lock_guard<std::mutex> l(status_lock_);
+      s = status_;
+    }
+    char frame[32];
+    struct tm tm;
+    localtime_r(&s.transmit_minute, &tm);
+    strftime(frame, sizeof(frame), "%Y-%m-%d %H:%M", &tm);
+    char buf[512];
+    snprintf(buf, sizeof(buf),
+             "station: %s\n"
+             "carrier-hz: %d\n"
+             "carrier-only: %s\n"
+             "offset-minutes: %d\n"
+             "frame: %s\n"
+             "second: %d\n"
+             "next-edge: %lld.%09ld\n"
+             "edges: %lld\n"
+             "late-edges: %lld\n"
+             "max-lateness-us: %lld\n"
+             "dropped-log-messages: %lld\n"
+             "clock-good: %s\n"
+             "clock-max-error-us: %lld\n"
+             "missed-edges: %lld\n"
+             "missed-by-station:",
+             s.station, s.carrier_hz, s.carrier_only ? "on" : "off",
+             s.offset_minutes, frame, s.second, (long long)s.next_edge.tv_sec,
+             s.next_edge.tv_nsec, (long long)s.edges, (long long)s.late_edges,
+             (long long)s.max_lateness_us, (long long)s.dropped_log_messages,
+             s.clock_good ? "yes" : "no", (long long)s.clock_max_error_us,
+             (long long)s.missed_edges);
+    std::string reply = buf;
+    for (int i = 0; i < s.stations; ++i) {
+      snprintf(buf, sizeof(buf), " %s=%lld", s.missed_by_station[i].station,
+               (long long)s.missed_by_station[i].missed);
+      reply += buf;
+    }
+    reply += "\n";
+    return reply;
+  }
+
+  if (arg == nullptr) return "error: missing argument\n";
+
+  Changes requested;
+  if (strcasecmp(command, "station") == 0) {
+    requested.time_source = factory_(arg);
+    if (!requested.time_source) return "error: unknown station\n";
+    snprintf(requested.station, sizeof(requested.station), "%s", arg);
+  } else if (strcasecmp(command, "offset") == 0) {
+    char *end;
+    requested.offset_minutes = strtol(arg, &end, 10);
+    if (*end) return "error: invalid offset\n";
+    requested.change_offset = true;
+  } else if (strcasecmp(command, "carrier-only") == 0) {
+    if (strcasecmp(arg, "on") != 0 && strcasecmp(arg, "off") != 0) {
+      return "error: expected on or off\n";
+    }
+    requested.change_carrier_only = true;
+    requested.carrier_only = (strcasecmp(arg, "on") == 0);
+  } else {
+    return "error: unknown command\n";
+  }
+
+  // Merge with what is not yet picked up by the transmit loop.
+  const std::lock_guard<std::mutex> l(changes_lock_);
+  if (requested.time_source) {
+    changes_.time_source.swap(requested.time_source);  // Frees the old one.
+    memcpy(changes_.station, requested.station, sizeof(changes_.station));
+  }
+  if (requested.change_offset) {
+    changes_.change_offset = true;
+    changes_.offset_minutes = requested.offset_minutes;
+  }
+  if (requested.change_carrier_only) {
+    changes_.change_carrier_only = true;
+    changes_.carrier_only = requested.carrier_only;
+  }
+  have_changes_ = true;
+  return "ok: applied at next minute\n";
+}
@@ -15,48 +15,135 @@
 // You should have received a copy of the GNU General Public License
 // along with this program.  If not, see <https://www.gnu.org/licenses/>.
 
+#include <array>
 #include <cstdint>
 #include <ctime>
+#include <iterator>
 
 #include "carrier-power.h"
+#include "station-spec.h"
 #include "time-signal-source.h"
 
-static uint64_t to_bcd(uint8_t n) { return (((n / 10) % 10) << 4) | (n % 10); }
-static uint64_t parity(uint64_t d, uint8_t from, uint8_t to_including) {
-  uint8_t result = 0;
-  for (int bit = from; bit <= to_including; ++bit) {
-    if (d & (1LL << bit)) result++;
-  }
-  return result & 0x1;
-}
+// https://de.wikipedia.org/wiki/DCF77
+// Little endian bits, sending the _upcoming_ minute.
+static constexpr FieldSpec kDCF77Fields[] = {
+    {FieldValue::DST, FieldEncoding::BINARY, 17, 1},
+    {FieldValue::STANDARD_TIME, FieldEncoding::BINARY, 18, 1},
+    {FieldValue::ALL_ONES, FieldEncoding::BINARY, 20, 1},  // start time bit.
+    {FieldValue::MINUTE, FieldEncoding::BCD, 21, 7},
+    {FieldValue::HOUR, FieldEncoding::BCD, 29, 6},
+    {FieldValue::DAY_OF_MONTH, FieldEncoding::BCD, 36, 6},
+    {FieldValue::DAY_OF_WEEK_ISO, FieldEncoding::BCD, 42, 3},
+    {FieldValue::MONTH, FieldEncoding::BCD, 45, 5},
+    {FieldValue::YEAR_OF_CENTURY, FieldEncoding::BCD, 50, 8},
+};
+
+static constexpr ParitySpec kDCF77Parities[] = {
+    {21, 27, 0, 28, 0},
+    {29, 34, 0, 35, 0},
+    {36, 57, 0, 58, 0},
+};
+
+static constexpr PulseSpec kDCF77Symbols[] = {
+    {2, {{CarrierPower::LOW, Millis(100)}, {CarrierPower::HIGH, 0}}},
+    {2, {{CarrierPower::LOW, Millis(200)}, {CarrierPower::HIGH, 0}}},
+};
+
+static constexpr StationSpec kDCF77Spec = {
+    /*time_offset_seconds=*/60,
+    /*utc=*/false,
+    /*msb_first=*/false,
+    /*frame_seconds=*/60,
+    /*bits_per_second=*/1,
+    kDCF77Fields,
+    std::size(kDCF77Fields),
+    kDCF77Parities,
+    std::size(kDCF77Parities),
+    /*marker_seconds=*/1ULL << 59,  // Synchronization
+    /*marker=*/{1, {{CarrierPower::HIGH, 0}}},
+    kDCF77Symbols,
+};
 
 void DCF77TimeSignalSource::PrepareMinute(time_t t) {
-  t += 60;  // We're sending the _upcoming_ minute.
-  struct tm breakdown;
-  localtime_r(&t, &breakdown);
-
-  // https://de.wikipedia.org/wiki/DCF77
-  // Little endian bits. So we store big-endian bits and start transmitting
-  // from bit 0
-  time_bits_ = 0;
-  time_bits_ |= (breakdown.tm_isdst ? 1 : 0) << 17;
-  time_bits_ |= (breakdown.tm_isdst ? 0 : 1) << 18;
-  time_bits_ |= (1 << 20);  // start time bit.
-  time_bits_ |= to_bcd(breakdown.tm_min) << 21;
-  time_bits_ |= to_bcd(breakdown.tm_hour) << 29;
-  time_bits_ |= to_bcd(breakdown.tm_mday) << 36;
-  time_bits_ |= to_bcd(breakdown.tm_wday ? breakdown.tm_wday : 7) << 42;
-  time_bits_ |= to_bcd(breakdown.tm_mon + 1) << 45;
-  time_bits_ |= to_bcd(breakdown.tm_year % 100) << 50;
-
-  time_bits_ |= parity(time_bits_, 21, 27) << 28;
-  time_bits_ |= parity(time_bits_, 29, 34) << 35;
-  time_bits_ |= parity(time_bits_, 36, 57) << 58;
+  EncodeSpecMinute<kDCF77Spec>(t, &calendars_, symbols_);
+}
+
+TimeSignalSource::ModulationSpan
+DCF77TimeSignalSource::GetModulationSpan(int second) {
+  return SpecModulationForSecond<kDCF77Spec>(symbols_, second);
+}
+
+int DCF77TimeSignalSource::GetSymbolForSecond(int second) const {
+  return SpecSymbolForSecond<kDCF77Spec>(symbols_, second);
+}
+
+// Phase modulation: each second, starting 200ms after the beginning, 512
+// chips of a pseudo-random sequence are sent as +/-15.6 degree phase
+// deviation, each chip lasting 120 carrier cycles. The sequence is
+// inverted for data bits that are one. The data bits are the same as in
+// the amplitude modulation.
+// The sequence is the 511 chip output of a 9-bit linear feedback shift
+// register with feedback from stages 5 and 9, followed by a zero chip.
+static constexpr int kPhaseChips = 512;
+static constexpr int32_t kPhaseStart = Millis(200);
+static constexpr int kCarrierCyclesPerChip = 120;
+static constexpr double kPhaseDeviationDegrees = 15.6;
+
+static const std::array<bool, kPhaseChips> &GetPseudoRandomChips() {
+  static const std::array<bool, kPhaseChips> chips = []() {
+    std::array<bool, kPhaseChips> result;
+    uint32_t shift_register = 0x1ff;
+    for (int i = 0; i < kPhaseChips - 1; ++i) {
+      result[i] = shift_register & 1;
+      const uint32_t feedback =
+          ((shift_register >> 4) ^ (shift_register >> 8)) & 1;
+      shift_register = (shift_register >> 1) | (feedback << 8);
+    }
+    result[kPhaseChips - 1] = false;
+    return result;
+  }();
+  return chips;
+}
+
+// Beginning of the given chip within the second.
+static int32_t ChipOffset(int chip) {
+  return Nanos(kPhaseStart + (int64_t)chip * kCarrierCyclesPerChip *
+                                 kNanosPerSecond /
+                                 DCF77TimeSignalSource::kCarrierHz);
+}
+
+// The phase changes of a second, one sequence for each data bit value.
+struct PhaseSequence {
+  int count;
+  PhaseChange changes[kPhaseChips + 1];
+};
+
+static const PhaseSequence &GetPhaseSequence(bool bit) {
+  static const std::array<PhaseSequence, 2> sequences = []() {
+    const std::array<bool, kPhaseChips> &chips = GetPseudoRandomChips();
+    std::array<PhaseSequence, 2> result;
+    for (int b = 0; b < 2; ++b) {
+      PhaseSequence &sequence = result[b];
+      sequence.count = 0;
+      double last_phase = 0;
+      for (int i = 0; i < kPhaseChips; ++i) {
+        const double phase = (chips[i] != (b == 1)) ? -kPhaseDeviationDegrees
+                                                    : kPhaseDeviationDegrees;
+        if (phase == last_phase) continue;
+        sequence.changes[sequence.count++] = {ChipOffset(i), phase};
+        last_phase = phase;
+      }
+      // Back to the unmodulated carrier for the rest of the second.
+      sequence.changes[sequence.count++] = {ChipOffset(kPhaseChips), 0};
+    }
+    return result;
+  }();
+  return sequences[bit];
 }
 
-TimeSignalSource::SecondModulation
-DCF77TimeSignalSource::GetModulationForSecond(int second) {
-  if (second >= 59) return {{CarrierPower::HIGH, 0}};  // Synchronization
-  const bool bit = time_bits_ & (1LL << second);
-  return {{CarrierPower::LOW, bit ? 200 : 100}, {CarrierPower::HIGH, 0}};
+// Both sequences are computed once; a second just points to one of them.
+TimeSignalSource::PhaseSpan DCF77TimeSignalSource::GetPhaseSpan(int second) {
+  const bool bit = (second < 59) && symbols_[second];
+  const PhaseSequence &sequence = GetPhaseSequence(bit);
+  return {sequence.changes, sequence.changes + sequence.count};
 }
@@ -0,0 +1,273 @@
+// -*- mode: c++; c-basic-offset: 2; indent-tabs-mode: nil; -*-
+// Part of txtempus, a LF time signal transmitter.
+// Copyright (C) 2018 Henner Zeller <h.zeller@acm.org>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#include "edge-export.h"
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <charconv>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <vector>
+
+#include "time-signal-source.h"
+
+static const char *PowerName(CarrierPower power) {
+  switch (power) {
+    case CarrierPower::OFF: return "OFF";
+    case CarrierPower::LOW: return "LOW";
+    case CarrierPower::HIGH: return "HIGH";
+  }
+  return "?";
+}
+
+EdgeExporter::EdgeExporter() : buffer_(new char[kBufferSize]) {}
+
+EdgeExporter::~EdgeExporter() { Finish(); }
+
+bool EdgeExporter::Open(const char *filename) {
+  filename_ = filename;
+  if (strcmp(filename, "-") == 0) {
+    fd_ = STDOUT_FILENO;
+    format_ = Format::JSON_LINES;
+    return true;
+  }
+  const size_t len = strlen(filename);
+  format_ = (len >= 4 && strcasecmp(filename + len - 4, ".vcd") == 0)
+                ? Format::VCD
+                : Format::JSON_LINES;
+  fd_ = open(filename, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+  if (fd_ < 0) {
+    perror(filename);
+    return false;
+  }
+  close_fd_ = true;
+  return true;
+}
+
+void EdgeExporter::Begin(const char *station, int carrier_hz,
+                         time_t first_minute, bool with_phase) {
+  first_minute_ = first_minute;
+  if (format_ == Format::JSON_LINES) {
+    Append("{\"type\":\"header\",\"station\":\"");
+    for (const char *c = station; *c; ++c) {
+      if (*c == '"' || *c == '\\') Append("\\");
+      if ((unsigned char)*c >= ' ') Append({c, 1});
+    }
+    Append("\",\"carrier_hz\":");
+    AppendInt(carrier_hz);
+    Append(",\"first_minute\":");
+    AppendInt(first_minute);
+    Append(with_phase ? ",\"phase\":true}\n" : ",\"phase\":false}\n");
+    return;
+  }
+
+  struct tm tm;
+  char start[32];
+  strftime(start, sizeof(start), "%Y-%m-%d %H:%M UTC",
+           gmtime_r(&first_minute, &tm));
+  Append("$comment txtempus ");
+  Append(station);
+  Append(" ");
+  AppendInt(carrier_hz);
+  Append(" Hz, time 0 is ");
+  Append(start);
+  Append("; power 0: off, 1: low, 2: high $end\n");
+  Append("$timescale 1ns $end\n$scope module txtempus $end\n");
+  // Variables with their one character identifiers.
+  Append("$var wire 2 p power $end\n");
+  Append("$var wire 1 c carrier $end\n");
+  if (with_phase) Append("$var real 64 f phase $end\n");
+  Append("$var integer 8 s second $end\n");
+  Append("$var integer 8 y symbol $end\n");
+  Append("$var integer 64 m transmit_time $end\n");
+  Append("$upscope $end\n$enddefinitions $end\n#0\n$dumpvars\n");
+  Append("bx p\nxc\nbx s\nbx y\nbx m\n");
+  if (with_phase) Append("r0 f\n");
+  Append("$end\n");
+  vcd_time_ = 0;
+  vcd_power_known_ = false;
+  vcd_phase_ = 0;
+  vcd_symbol_ = -2;
+}
+
+void EdgeExporter::AddMinute(time_t minute, time_t transmit_time,
+                             const int symbols[60],
+                             const std::vector<ModulationEdge> &edges) {
+  if (format_ == Format::VCD) {
+    AddVCDMinute((int64_t)(minute - first_minute_) * kNanosPerSecond,
+                 transmit_time, symbols, edges);
+  } else {
+    AddJSONMinute(minute, transmit_time, symbols, edges);
+  }
+  edges_ += edges.size();
+}
+
+void EdgeExporter::AddVCDMinute(int64_t minute_ns, time_t transmit_time,
+                                const int symbols[60],
+                                const std::vector<ModulationEdge> &edges) {
+  VCDTime(minute_ns);
+  Append("b");
+  AppendBinary(transmit_time);
+  Append(" m\n");
+  // Second boundaries and the edges, merged in chronological order.
+  size_t e = 0;
+  for (int s = 0; s < 60; ++s) {
+    VCDTime(minute_ns + (int64_t)s * kNanosPerSecond);
+    Append("b");
+    AppendBinary(s);
+    Append(" s\n");
+    if (symbols[s] != vcd_symbol_) {
+      vcd_symbol_ = symbols[s];
+      if (vcd_symbol_ < 0) {
+        Append("bx y\n");
+      } else {
+        Append("b");
+        AppendBinary(vcd_symbol_);
+        Append(" y\n");
+      }
+    }
+    const int64_t next_second_ns = (int64_t)(s + 1) * kNanosPerSecond;
+    while (e < edges.size() &&
+           (s == 59 || edges[e].offset_ns < next_second_ns)) {
+      VCDEdge(minute_ns, edges[e++]);
+    }
+  }
+}
+
+void EdgeExporter::VCDEdge(int64_t minute_ns, const ModulationEdge &edge) {
+  if (edge.type == ModulationEdge::Type::PHASE) {
+    if (edge.phase_degrees == vcd_phase_) return;
+    VCDTime(minute_ns + edge.offset_ns);
+    vcd_phase_ = edge.phase_degrees;
+    Append("r");
+    AppendDouble(vcd_phase_);
+    Append(" f\n");
+    return;
+  }
+  if (vcd_power_known_ && edge.power == vcd_power_) return;
+  VCDTime(minute_ns + edge.offset_ns);
+  Append("b");
+  AppendBinary((uint64_t)edge.power);
+  Append(" p\n");
+  const bool was_on = vcd_power_ != CarrierPower::OFF;
+  const bool on = edge.power != CarrierPower::OFF;
+  if (!vcd_power_known_ || on != was_on) Append(on ? "1c\n" : "0c\n");
+  vcd_power_ = edge.power;
+  vcd_power_known_ = true;
+}
+
+void EdgeExporter::VCDTime(int64_t t) {
+  if (t == vcd_time_) return;
+  vcd_time_ = t;
+  Append("#");
+  AppendInt(t);
+  Append("\n");
+}
+
+void EdgeExporter::AddJSONMinute(time_t minute, time_t transmit_time,
+                                 const int symbols[60],
+                                 const std::vector<ModulationEdge> &edges) {
+  const int64_t minute_ns = (int64_t)minute * kNanosPerSecond;
+  Append("{\"type\":\"minute\",\"t\":");
+  AppendInt(minute_ns);
+  Append(",\"transmit_time\":");
+  AppendInt(transmit_time);
+  Append(",\"symbols\":[");
+  for (int s = 0; s < 60; ++s) {
+    if (s) Append(",");
+    AppendInt(symbols[s]);
+  }
+  Append("]}\n");
+  for (const ModulationEdge &edge : edges) {
+    Append("{\"type\":");
+    if (edge.type == ModulationEdge::Type::PHASE) {
+      Append("\"phase\",\"t\":");
+      AppendInt(minute_ns + edge.offset_ns);
+      Append(",\"degrees\":");
+      AppendDouble(edge.phase_degrees);
+      Append("}\n");
+    } else {
+      Append("\"power\",\"t\":");
+      AppendInt(minute_ns + edge.offset_ns);
+      Append(",\"power\":\"");
+      Append(PowerName(edge.power));
+      Append(edge.power == CarrierPower::OFF ? "\",\"carrier\":false}\n"
+                                             : "\",\"carrier\":true}\n");
+    }
+  }
+}
+
+bool EdgeExporter::Finish() {
+  if (fd_ < 0) return !write_error_;
+  Flush();
+  if (close_fd_ && close(fd_) < 0 && !write_error_) {
+    perror(filename_);
+    write_error_ = true;
+  }
+  fd_ = -1;
+  return !write_error_;
+}
+
+void EdgeExporter::Append(std::string_view s) {
+  if (fill_ + s.size() > kBufferSize) Flush();
+  memcpy(buffer_.get() + fill_, s.data(), s.size());
+  fill_ += s.size();
+}
+
+void EdgeExporter::AppendInt(int64_t value) {
+  char number[24];
+  const auto result = std::to_chars(number, number + sizeof(number), value);
+  Append({number, (size_t)(result.ptr - number)});
+}
+
+void EdgeExporter::AppendBinary(uint64_t value) {
+  char bits[64];
+  char *pos = bits + sizeof(bits);
+  do {
+    *--pos = '0' + (value & 1);
+    value >>= 1;
+  } while (value);
+  Append({pos, (size_t)(bits + sizeof(bits) - pos)});
+}
+
+// Shortest representation that reads back exactly, independent of locale.
+void EdgeExporter::AppendDouble(double value) {
+  char number[32];
+  const auto result = std::to_chars(number, number + sizeof(number), value);
+  Append({number, (size_t)(result.ptr - number)});
+}
+
+void EdgeExporter::Flush() {
+  const char *pos = buffer_.get();
+  const char *const end = pos + fill_;
+  fill_ = 0;
+  while (pos < end && !write_error_ && fd_ >= 0) {
+    const ssize_t written = write(fd_, pos, end - pos);
+    if (written < 0) {
+      if (errno == EINTR) continue;
+      perror(filename_);
+      write_error_ = true;
+      break;
+    }
+    pos += written;
+  }
+}
@@ -0,0 +1,53 @@
+// -*- mode: c++; c-basic-offset: 2; indent-tabs-mode: nil; -*-
+// Part of txtempus, a LF time signal transmitter.
+// Copyright (C) 2018 Henner Zeller <h.zeller@acm.org>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#include "edge-schedule.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <ctime>
+#include <vector>
+
+#include "carrier-power.h"
+#include "time-signal-source.h"
+
+void AppendMinuteEdges(TimeSignalSource *source, time_t minute,
+                       bool with_phase, std::vector<ModulationEdge> *edges) {
+  source->PrepareMinute(minute);
+  for (int second = 0; second < 60; ++second) {
+    const size_t first = edges->size();
+    const int64_t second_ns = (int64_t)second * kNanosPerSecond;
+    int64_t elapsed_ns = 0;
+    for (const ModulationDuration &m : source->GetModulationSpan(second)) {
+      edges->push_back({second_ns + elapsed_ns, ModulationEdge::Type::POWER,
+                        m.power, 0});
+      if (m.duration_ns == 0) break;
+      elapsed_ns += m.duration_ns;
+    }
+    if (with_phase) {
+      for (const PhaseChange &p : source->GetPhaseSpan(second)) {
+        edges->push_back({second_ns + p.offset_ns,
+                          ModulationEdge::Type::PHASE, CarrierPower::HIGH,
+                          p.phase_degrees});
+      }
+    }
+    std::stable_sort(edges->begin() + first, edges->end(),
+                     [](const ModulationEdge &a, const ModulationEdge &b) {
+                       return a.offset_ns < b.offset_ns;
+                     });
+  }
+}
@@ -0,0 +1,164 @@
+// -*- mode: c++; c-basic-offset: 2; indent-tabs-mode: nil; -*-
+// Part of txtempus, a LF time signal transmitter.
+// Copyright (C) 2018 Henner Zeller <h.zeller@acm.org>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+
+#include "encoder-sweep.h"
+
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <ctime>
+#include <memory>
+#include <new>
+#include <vector>
+
+#include "frame-decoder.h"
+#include "time-signal-source.h"
+
+// Minutes each worker takes at once.
+static constexpr int64_t kChunkMinutes = 24 * 60;
+
+// The modulation of each second of a minute, pointing into the source; it
+// stays valid until the source prepares another minute.
+class Frame {
+ public:
+  explicit Frame(const char *service)
+      : source_(CreateTimeSignalSource(service)) {}
+
+  void Encode(time_t minute) {
+    source_->PrepareMinute(minute);
+    for (int s = 0; s < 60; ++s) seconds_[s] = source_->GetModulationSpan(s);
+  }
+
+  const TimeSignalSource::ModulationSpan *seconds() const { return seconds_; }
+
+ private:
+  std::unique_ptr<TimeSignalSource> source_;
+  TimeSignalSource::ModulationSpan seconds_[60];
+};
+
+static bool SameFrame(const Frame &frame_a, const Frame &frame_b) {
+  for (int s = 0; s < 60; ++s) {
+    const TimeSignalSource::ModulationSpan a = frame_a.seconds()[s];
+    const TimeSignalSource::ModulationSpan b = frame_b.seconds()[s];
+    if (a.size() != b.size()) return false;
+    for (size_t i = 0; i < a.size(); ++i) {
+      if (a[i].power != b[i].power || a[i].duration_ns != b[i].duration_ns) {
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+static void PrintMinute(time_t t) {
+  char buf[32];
+  struct tm tm;
+  localtime_r(&t, &tm);
+  strftime(buf, sizeof(buf), "%Y-%m-%d %H:%M %Z", &tm);
+  printf("%s (%lld)", buf, (long long)t);
+}
+
+// State shared between the worker processes.
+struct SweepState {
+  std::atomic<int64_t> next_chunk{0};
+  std::atomic<int64_t> failures{0};
+  std::atomic<int64_t> ambiguous{0};
+  std::atomic<int> reported{0};
+};
+
+static void SweepWorker(const char *service, time_t from, int64_t minutes,
+                        int max_reports, SweepState *state) {
+  Frame frame(service), decoded_frame(service);
+  std::unique_ptr<FrameDecoder> decoder = CreateFrameDecoder(service);
+  for (;;) {
+    const int64_t first = state->next_chunk.fetch_add(kChunkMinutes);
+    if (first >= minutes) break;
+    const int64_t end = std::min(first + kChunkMinutes, minutes);
+    for (int64_t m = first; m < end; ++m) {
+      const time_t t = from + m * 60;
+      frame.Encode(t);
+      DecodedMinute decoded;
+      const bool ok = decoder->DecodeMinute(frame.seconds(), t, &decoded);
+      if (ok && decoded.minute == t) continue;
+      if (ok) {
+        decoded_frame.Encode(decoded.minute);
+        if (SameFrame(frame, decoded_frame)) {
+          state->ambiguous++;
+          continue;
+        }
+      }
+      state->failures++;
+      if (state->reported++ >= max_reports) continue;
+      printf("  %s: ", service);
+      PrintMinute(t);
+      if (ok) {
+        printf(" decodes as ");
+        PrintMinute(decoded.minute);
+        printf("\n");
+      } else {
+        printf(" does not decode\n");
+      }
+      fflush(stdout);
+    }
+  }
+}
+
+// The workers are processes, not threads: localtime_r() and mktime(), which
+// encoders and decoders still call at the start of each day or hour, hold a
+// process wide lock in glibc, so threads would wait for each other there.
+SweepResult SweepEncoder(const char *service, time_t from, time_t to,
+                         int workers, int max_reports) {
+  const int64_t minutes = (to - from) / 60;
+  void *shared = mmap(nullptr, sizeof(SweepState), PROT_READ | PROT_WRITE,
+                      MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+  if (shared == MAP_FAILED) {
+    perror("mmap");
+    SweepResult result;
+    result.minutes = minutes;
+    result.failures = minutes;
+    return result;
+  }
+  SweepState *const state = new (shared) SweepState();
+
+  fflush(stdout);  // Don't inherit buffered output.
+  std::vector<pid_t> children;
+  for (int i = 1; i < workers; ++i) {
+    const pid_t pid = fork();
+    if (pid == 0) {
+      SweepWorker(service, from, minutes, max_reports, state);
+      _exit(0);
+    }
+    if (pid < 0) break;  // Do with fewer.
+    children.push_back(pid);
+  }
+  SweepWorker(service, from, minutes, max_reports, state);
+  for (pid_t pid : children) waitpid(pid, nullptr, 0);
+
+  SweepResult result;
+  result.minutes = minutes;
+  result.failures = state->failures;
+  result.ambiguous = state->ambiguous;
+  state->~SweepState();
+  munmap(shared, sizeof(SweepState));
+  return result;
+}
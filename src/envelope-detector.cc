@@ -0,0 +1,116 @@
+// -*- mode: c++; c-basic-offset: 2; indent-tabs-mode: nil; -*-
+// Part of txtempus, a LF time signal transmitter.
+// Copyright (C) 2018 Henner Zeller <h.zeller@acm.org>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+
+#include "envelope-detector.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <thread>
+#include <vector>
+
+#include "capture-file.h"
+
+// Number of blocks processed at once; with GCC vector extensions, this
+// maps to the SIMD registers available (e.g. two SSE or NEON registers, or
+// one AVX register).
+static constexpr int kLanes = 8;
+typedef float FloatLanes __attribute__((vector_size(kLanes * sizeof(float))));
+
+double AliasedFrequency(double frequency_hz, int sample_rate, bool complex) {
+  double f = fmod(frequency_hz, sample_rate);
+  if (f < 0) f += sample_rate;
+  if (complex) return (f >= sample_rate / 2.0) ? f - sample_rate : f;
+  return (f > sample_rate / 2.0) ? sample_rate - f : f;
+}
+
+// Run the Goertzel recurrence over kLanes blocks, with the samples
+// interleaved: sample n of lane k is at samples[n * kLanes + k].
+// Returns the last two states of the recurrence for each lane.
+static void Goertzel(const float *samples, int block_frames,
+                     float coefficient, FloatLanes *s1_out,
+                     FloatLanes *s2_out) {
+  FloatLanes s1 = {}, s2 = {};
+  for (int n = 0; n < block_frames; ++n) {
+    FloatLanes x;
+    memcpy(&x, samples + n * kLanes, sizeof(x));
+    const FloatLanes s0 = x + coefficient * s1 - s2;
+    s2 = s1;
+    s1 = s0;
+  }
+  *s1_out = s1;
+  *s2_out = s2;
+}
+
+static void EnvelopeOfBlocks(const CaptureFile &capture, double omega,
+                             int block_frames, int64_t first_block,
+                             int64_t end_block, float *out) {
+  const float coefficient = 2 * cos(omega);
+  const float c = cos(omega), s = sin(omega);
+  const bool complex = capture.is_complex();
+  // Scale to the amplitude of the carrier.
+  const float scale = (complex ? 1.0f : 2.0f) / block_frames;
+
+  std::vector<float> i_samples(kLanes * block_frames);
+  std::vector<float> q_samples(complex ? kLanes * block_frames : 0);
+  for (int64_t block = first_block; block < end_block; block += kLanes) {
+    for (int lane = 0; lane < kLanes; ++lane) {
+      capture.GetFrames((block + lane) * block_frames, block_frames, kLanes,
+                        i_samples.data() + lane,
+                        complex ? q_samples.data() + lane : nullptr);
+    }
+    // X = s1 - exp(-j omega) * s2; the common phase factor doesn't matter.
+    FloatLanes s1, s2;
+    Goertzel(i_samples.data(), block_frames, coefficient, &s1, &s2);
+    FloatLanes re = s1 - c * s2;
+    FloatLanes im = s * s2;
+    if (complex) {
+      // X = X_i + j X_q
+      Goertzel(q_samples.data(), block_frames, coefficient, &s1, &s2);
+      re -= s * s2;
+      im += s1 - c * s2;
+    }
+    const FloatLanes power = re * re + im * im;
+    for (int lane = 0; lane < kLanes && block + lane < end_block; ++lane) {
+      out[block + lane - first_block] = sqrtf(power[lane]) * scale;
+    }
+  }
+}
+
+std::vector<float> ComputeEnvelope(const CaptureFile &capture,
+                                   double frequency_hz, int block_frames,
+                                   int threads) {
+  const int64_t blocks = capture.frames() / block_frames;
+  std::vector<float> envelope(blocks);
+  const double omega = 2 * M_PI * frequency_hz / capture.sample_rate();
+  if (threads < 1) threads = 1;
+
+  // Each thread gets a contiguous range of blocks, a multiple of kLanes.
+  const int64_t per_thread =
+      ((blocks + threads - 1) / threads + kLanes - 1) / kLanes * kLanes;
+  std::vector<std::thread> workers;
+  for (int64_t first = 0; first < blocks; first += per_thread) {
+    const int64_t end = std::min(first + per_thread, blocks);
+    workers.emplace_back(EnvelopeOfBlocks, std::cref(capture), omega,
+                         block_frames, first, end, envelope.data() + first);
+  }
+  for (std::thread &t : workers) t.join();
+  return envelope;
+}
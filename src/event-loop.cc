@@ -0,0 +1,136 @@
+// -*- mode: c++; c-basic-offset: 2; indent-tabs-mode: nil; -*-
+// Part of txtempus, a LF time signal transmitter.
+// Copyright (C) 2018 Henner Zeller <h.zeller@acm.org>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#include "event-loop.h"
+
+#include <signal.h>  // NOLINT(modernize-deprecated-headers) sigset_t
+#include <sys/epoll.h>
+#include <sys/signalfd.h>
+#include <sys/timerfd.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <ctime>
+#include <functional>
+#include <memory>
+#include <utility>
+
+EventLoop::EventLoop() = default;
+
+EventLoop::~EventLoop() {
+  if (signal_fd_ >= 0) close(signal_fd_);
+  if (timer_fd_ >= 0) close(timer_fd_);
+  if (epoll_fd_ >= 0) close(epoll_fd_);
+}
+
+bool EventLoop::Init(std::initializer_list<int> signals) {
+  epoll_fd_ = epoll_create1(EPOLL_CLOEXEC);
+  if (epoll_fd_ < 0) {
+    perror("epoll_create1");
+    return false;
+  }
+
+  timer_fd_ = timerfd_create(CLOCK_REALTIME, TFD_NONBLOCK | TFD_CLOEXEC);
+  if (timer_fd_ < 0) {
+    perror("timerfd_create");
+    return false;
+  }
+  AddSource(timer_fd_, [this]() { HandleTimer(); });
+
+  sigset_t mask;
+  sigemptyset(&mask);
+  for (int signo : signals) sigaddset(&mask, signo);
+  if (sigprocmask(SIG_BLOCK, &mask, nullptr) < 0) {
+    perror("sigprocmask");
+    return false;
+  }
+  signal_fd_ = signalfd(-1, &mask, SFD_NONBLOCK | SFD_CLOEXEC);
+  if (signal_fd_ < 0) {
+    perror("signalfd");
+    return false;
+  }
+  AddSource(signal_fd_, [this]() { HandleSignal(); });
+  return true;
+}
+
+bool EventLoop::AddReadHandler(int fd, std::function<void()> handler) {
+  return AddSource(fd, std::move(handler)) != nullptr;
+}
+
+EventLoop::Source *EventLoop::AddSource(int fd,
+                                        std::function<void()> handler) {
+  sources_.emplace_back(new Source{fd, std::move(handler)});
+  struct epoll_event ev = {};
+  ev.events = EPOLLIN;
+  ev.data.ptr = sources_.back().get();
+  if (epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, fd, &ev) < 0) {
+    perror("epoll_ctl");
+    sources_.pop_back();
+    return nullptr;
+  }
+  return sources_.back().get();
+}
+
+bool EventLoop::WaitUntil(const struct timespec &deadline) {
+  deadline_ = deadline;
+  deadline_reached_ = false;
+  ArmTimer();
+  while (!deadline_reached_ && !stopped_) Dispatch(-1);
+  return !stopped_;
+}
+
+bool EventLoop::DispatchPending() {
+  Dispatch(0);
+  return !stopped_;
+}
+
+void EventLoop::Dispatch(int timeout_ms) {
+  struct epoll_event events[8];
+  const int count = epoll_wait(epoll_fd_, events, 8, timeout_ms);
+  for (int i = 0; i < count; ++i) {
+    static_cast<Source *>(events[i].data.ptr)->handler();
+  }
+}
+
+void EventLoop::ArmTimer() {
+  struct itimerspec spec = {};
+  spec.it_value = deadline_;
+  // With TFD_TIMER_CANCEL_ON_SET, we learn about the clock being set.
+  timerfd_settime(timer_fd_, TFD_TIMER_ABSTIME | TFD_TIMER_CANCEL_ON_SET,
+                  &spec, nullptr);
+}
+
+void EventLoop::HandleTimer() {
+  uint64_t expirations;
+  if (read(timer_fd_, &expirations, sizeof(expirations)) >= 0) {
+    deadline_reached_ = true;
+    return;
+  }
+  if (errno == ECANCELED) {
+    if (clock_change_handler_) clock_change_handler_();
+    ArmTimer();  // The deadline is absolute, so still valid.
+  }
+}
+
+void EventLoop::HandleSignal() {
+  struct signalfd_siginfo info;
+  while (read(signal_fd_, &info, sizeof(info)) == sizeof(info)) {
+    if (signal_handler_) signal_handler_(info.ssi_signo);
+  }
+}
@@ -0,0 +1,116 @@
+// -*- mode: c++; c-basic-offset: 2; indent-tabs-mode: nil; -*-
+// Part of txtempus, a LF time signal transmitter.
+// Copyright (C) 2018 Henner Zeller <h.zeller@acm.org>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#include "flight-recorder.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+
+FlightRecorder::~FlightRecorder() {
+  if (map_) munmap(map_, map_size_);
+}
+
+bool FlightRecorder::Open(const char *filename, uint64_t capacity) {
+  const int fd = open(filename, O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+  if (fd < 0) {
+    perror(filename);
+    return false;
+  }
+  struct stat st;
+  if (fstat(fd, &st) < 0) {
+    perror(filename);
+    close(fd);
+    return false;
+  }
+  size_t size = st.st_size;
+  const bool created = (size == 0);
+  if (created) {
+    size = sizeof(FlightRecorderHeader) + capacity * sizeof(FlightRecord);
+    // Allocate the blocks now; running out of disk space later would be a
+    // SIGBUS in the transmit loop.
+    const int err = posix_fallocate(fd, 0, size);
+    if (err != 0) {
+      fprintf(stderr, "%s: %s\n", filename, strerror(err));
+      close(fd);
+      return false;
+    }
+  }
+  if (!Map(fd, size, true, created, filename)) return false;
+  if (created) {
+    memcpy(header_->magic, kFlightRecorderMagic, sizeof(header_->magic));
+    header_->byte_order = kFlightRecorderByteOrder;
+    header_->record_size = sizeof(FlightRecord);
+    header_->capacity = capacity;
+    header_->count = 0;
+  }
+  records_ = reinterpret_cast<FlightRecord *>(header_ + 1);
+  return true;
+}
+
+bool FlightRecorder::OpenReadOnly(const char *filename) {
+  const int fd = open(filename, O_RDONLY | O_CLOEXEC);
+  if (fd < 0) {
+    perror(filename);
+    return false;
+  }
+  struct stat st;
+  if (fstat(fd, &st) < 0) {
+    perror(filename);
+    close(fd);
+    return false;
+  }
+  return Map(fd, st.st_size, false, false, filename);
+}
+
+bool FlightRecorder::Map(int fd, size_t size, bool writable, bool created,
+                         const char *filename) {
+  void *map = MAP_FAILED;
+  if (size >= sizeof(FlightRecorderHeader)) {
+    map = mmap(nullptr, size, writable ? PROT_READ | PROT_WRITE : PROT_READ,
+               MAP_SHARED | MAP_POPULATE, fd, 0);
+  }
+  close(fd);
+  if (map == MAP_FAILED) {
+    fprintf(stderr, "%s: can't map flight recorder\n", filename);
+    return false;
+  }
+  map_ = map;
+  map_size_ = size;
+  header_ = static_cast<FlightRecorderHeader *>(map);
+  if (created) return true;
+
+  if (memcmp(header_->magic, kFlightRecorderMagic, sizeof(header_->magic)) !=
+          0 ||
+      header_->byte_order != kFlightRecorderByteOrder ||
+      header_->record_size != sizeof(FlightRecord) || header_->capacity == 0 ||
+      (size - sizeof(FlightRecorderHeader)) / sizeof(FlightRecord) <
+          header_->capacity) {
+    fprintf(stderr, "%s: not a flight recorder file for this machine\n",
+            filename);
+    munmap(map_, map_size_);
+    map_ = nullptr;
+    header_ = nullptr;
+    return false;
+  }
+  return true;
+}
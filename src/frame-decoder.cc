@@ -0,0 +1,504 @@
+// -*- mode: c++; c-basic-offset: 2; indent-tabs-mode: nil; -*-
+// Part of txtempus, a LF time signal transmitter.
+// Copyright (C) 2018 Henner Zeller <h.zeller@acm.org>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+
+#include "frame-decoder.h"
+
+#include <strings.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <ctime>
+#include <initializer_list>
+#include <memory>
+
+#include "carrier-power.h"
+#include "time-signal-source.h"
+
+using ModulationSpan = TimeSignalSource::ModulationSpan;
+
+CarrierPower PowerAt(ModulationSpan modulation, int ms) {
+  const int64_t ns = ms * 1000000LL;
+  int64_t end = 0;
+  for (const ModulationDuration &m : modulation) {
+    end += m.duration_ns;
+    if (m.duration_ns == 0 || ns < end) return m.power;
+  }
+  return modulation.empty() ? CarrierPower::HIGH : modulation.back().power;
+}
+
+namespace {
+// Number of samples taken before the given time into the second.
+int SamplesBefore(int64_t ns) {
+  return std::min<int64_t>((ns + 49999999) / 100000000, 10);
+}
+
+// The decoders look at the carrier 50ms, 150ms, .. 950ms into each second,
+// like a receiver sampling it every 100ms. Bit n of the samples of a second
+// is set if the carrier is reduced 50ms + n * 100ms into it.
+uint16_t SampleSecond(ModulationSpan modulation) {
+  uint16_t samples = 0;
+  int64_t end = 0;
+  int before = 0;  // Samples before the current change.
+  for (size_t i = 0; i < modulation.size(); ++i) {
+    const ModulationDuration &m = modulation[i];
+    const bool last = m.duration_ns == 0 || i + 1 == modulation.size();
+    end += m.duration_ns;
+    const int until = last ? 10 : SamplesBefore(end);
+    if (m.power != CarrierPower::HIGH) {
+      samples |= (1 << until) - (1 << before);
+    }
+    if (last) break;
+    before = until;
+  }
+  return samples;
+}
+
+void SampleMinute(const ModulationSpan *seconds, uint16_t samples[60]) {
+  for (int s = 0; s < 60; ++s) samples[s] = SampleSecond(seconds[s]);
+}
+
+bool Reduced(uint16_t samples, int ms) { return (samples >> (ms / 100)) & 1; }
+
+// BCD digit with its bits in the given seconds, least significant first.
+// Returns -1 if it is not a valid digit.
+int Digit(const bool *bits, std::initializer_list<int> seconds) {
+  int value = 0;
+  int weight = 1;
+  for (int s : seconds) {
+    if (bits[s]) value += weight;
+    weight <<= 1;
+  }
+  return value <= 9 ? value : -1;
+}
+
+// Combine decimal digits, most significant first. Returns -1 if any of them
+// is invalid.
+int Number(std::initializer_list<int> digits) {
+  int result = 0;
+  for (int d : digits) {
+    if (d < 0) return -1;
+    result = result * 10 + d;
+  }
+  return result;
+}
+
+// Returns 1 if the number of ones in the given seconds is odd.
+int Parity(const bool *bits, int from, int to_including) {
+  int result = 0;
+  for (int s = from; s <= to_including; ++s) result ^= bits[s];
+  return result;
+}
+
+// -- Calendar arithmetic, done here rather than with the C library so that
+// it doesn't share assumptions with the encoders.
+bool IsLeapYear(int year) {
+  return year % 4 == 0 && (year % 100 != 0 || year % 400 == 0);
+}
+
+int DaysInMonth(int year, int month) {
+  static constexpr int kDays[12] = {31, 28, 31, 30, 31, 30,
+                                    31, 31, 30, 31, 30, 31};
+  return kDays[month - 1] + (month == 2 && IsLeapYear(year));
+}
+
+// Days since 1970-01-01 of the given date. Years are counted from March 1st,
+// so that the leap day is at the end; 400 years ("era") have 146097 days.
+int64_t DaysSinceEpoch(int year, int month, int mday) {
+  const int y = year - (month <= 2);
+  const int era = (y >= 0 ? y : y - 399) / 400;
+  const int year_of_era = y - era * 400;
+  const int day_of_year =
+      (153 * (month > 2 ? month - 3 : month + 9) + 2) / 5 + mday - 1;
+  const int day_of_era = year_of_era * 365 + year_of_era / 4 -
+                         year_of_era / 100 + day_of_year;
+  return era * 146097LL + day_of_era - 719468;  // 719468: 0000-03-01 .. 1970
+}
+
+// Day of the week, 0 = Sunday.
+int Weekday(int year, int month, int mday) {
+  const int64_t days = DaysSinceEpoch(year, month, mday);
+  return ((days + 4) % 7 + 7) % 7;  // 1970-01-01 was a Thursday.
+}
+
+// Month and day of month of the given day of the year.
+bool DayOfYearToDate(int year, int yday, int *month, int *mday) {
+  if (yday < 1 || yday > (IsLeapYear(year) ? 366 : 365)) return false;
+  for (*month = 1; yday > DaysInMonth(year, *month); ++*month) {
+    yday -= DaysInMonth(year, *month);
+  }
+  *mday = yday;
+  return true;
+}
+
+// Year (UTC) of the given time.
+int YearOf(time_t t) {
+  const int64_t days = (t >= 0 ? t : t - 86399) / 86400;
+  int year = 1970 + days * 400 / 146097;  // Close, if not exact.
+  while (DaysSinceEpoch(year + 1, 1, 1) <= days) ++year;
+  while (DaysSinceEpoch(year, 1, 1) > days) --year;
+  return year;
+}
+
+// Expand a two-digit year to the century closest to the reference time.
+int ExpandYear(int two_digit_year, time_t reference) {
+  const int reference_year = YearOf(reference);
+  int year = reference_year - reference_year % 100 + two_digit_year;
+  if (year - reference_year > 50) year -= 100;
+  if (reference_year - year > 50) year += 100;
+  return year;
+}
+
+bool ValidDate(int year, int month, int mday) {
+  return month >= 1 && month <= 12 && mday >= 1 &&
+         mday <= DaysInMonth(year, month);
+}
+
+bool ValidTime(int hour, int minute) {
+  return hour >= 0 && hour < 24 && minute >= 0 && minute < 60;
+}
+
+time_t UTCToEpoch(int year, int month, int mday, int hour, int minute) {
+  return DaysSinceEpoch(year, month, mday) * 86400 + hour * 3600 + minute * 60;
+}
+
+// Converts local time with mktime(). That is slow, and a receiver mostly
+// sees one minute after the other, so the UTC offset of an hour is kept
+// for its other minutes if the first and the last minute of the hour have
+// the same offset, i.e. if the time zone doesn't change within it.
+class LocalTimeConverter {
+ public:
+  // Convert the given local time. Returns 'false' if it does not exist as
+  // such, e.g. because the DST flag does not fit to the time zone.
+  bool ToEpoch(int year, int month, int mday, int hour, int minute, int dst,
+               time_t *result) {
+    const time_t local = UTCToEpoch(year, month, mday, hour, minute);
+    const time_t local_hour = local - minute * 60;
+    if (local_hour == cached_hour_ && dst == cached_dst_) {
+      *result = local - cached_offset_;
+      return true;
+    }
+    if (!MakeTime(year, month, mday, hour, minute, dst, result)) return false;
+    time_t first, last;
+    if (MakeTime(year, month, mday, hour, 0, dst, &first) &&
+        MakeTime(year, month, mday, hour, 59, dst, &last) &&
+        local_hour - first == local - *result &&
+        local_hour + 59 * 60 - last == local - *result) {
+      cached_hour_ = local_hour;
+      cached_dst_ = dst;
+      cached_offset_ = local - *result;
+    }
+    return true;
+  }
+
+ private:
+  static bool MakeTime(int year, int month, int mday, int hour, int minute,
+                       int dst, time_t *result) {
+    struct tm tm = {};
+    tm.tm_year = year - 1900;
+    tm.tm_mon = month - 1;
+    tm.tm_mday = mday;
+    tm.tm_hour = hour;
+    tm.tm_min = minute;
+    tm.tm_isdst = dst;
+    *result = mktime(&tm);
+    return tm.tm_year == year - 1900 && tm.tm_mon == month - 1 &&
+           tm.tm_mday == mday && tm.tm_hour == hour && tm.tm_min == minute;
+  }
+
+  time_t cached_hour_ = -1;  // Local time, as UTCToEpoch() computes it.
+  int cached_dst_ = 0;
+  time_t cached_offset_ = 0;
+};
+
+// DCF77: 100ms (0) or 200ms (1) reduced carrier at the beginning of each
+// second, no reduction in second 59. Bits are sent least significant first
+// and describe the upcoming minute in German local time.
+class DCF77Decoder : public FrameDecoder {
+ public:
+  bool DecodeMinute(const ModulationSpan *seconds, time_t reference,
+                    DecodedMinute *result) final {
+    uint16_t samples[60];
+    SampleMinute(seconds, samples);
+    bool bits[60] = {};
+    for (int s = 0; s < 59; ++s) {
+      if (!Reduced(samples[s], 50) || Reduced(samples[s], 250)) return false;
+      bits[s] = Reduced(samples[s], 150);
+    }
+    if (Reduced(samples[59], 50)) return false;
+    if (bits[0] || !bits[20] || bits[17] == bits[18]) return false;
+    if (Parity(bits, 21, 28) || Parity(bits, 29, 35) || Parity(bits, 36, 58)) {
+      return false;
+    }
+    const int minute = Number({Digit(bits, {25, 26, 27}),  //
+                               Digit(bits, {21, 22, 23, 24})});
+    const int hour = Number({Digit(bits, {33, 34}),  //
+                             Digit(bits, {29, 30, 31, 32})});
+    const int mday = Number({Digit(bits, {40, 41}),  //
+                             Digit(bits, {36, 37, 38, 39})});
+    const int wday = Digit(bits, {42, 43, 44});  // 1 = Monday .. 7 = Sunday
+    const int month = Number({Digit(bits, {49}),  //
+                              Digit(bits, {45, 46, 47, 48})});
+    const int year_digits = Number({Digit(bits, {54, 55, 56, 57}),
+                                    Digit(bits, {50, 51, 52, 53})});
+    if (year_digits < 0 || wday < 1 || !ValidTime(hour, minute)) return false;
+    const int year = ExpandYear(year_digits, reference);
+    if (!ValidDate(year, month, mday)) return false;
+    if (Weekday(year, month, mday) != wday % 7) return false;
+    time_t t;
+    if (!local_time_.ToEpoch(year, month, mday, hour, minute, bits[17], &t)) {
+      return false;
+    }
+    result->minute = t - 60;
+    result->dst = bits[17];
+    return true;
+  }
+
+ private:
+  LocalTimeConverter local_time_;
+};
+
+// Common to WWVB and JJY: a marker each 10 seconds, ending with the second
+// 9, 19, ... and at second 0. Padded BCD digits, most significant bit first.
+int PaddedMinute(const bool *bits) {
+  return Number({Digit(bits, {3, 2, 1}), Digit(bits, {8, 7, 6, 5})});
+}
+int PaddedHour(const bool *bits) {
+  return Number({Digit(bits, {13, 12}), Digit(bits, {18, 17, 16, 15})});
+}
+int PaddedDayOfYear(const bool *bits) {
+  return Number({Digit(bits, {23, 22}), Digit(bits, {28, 27, 26, 25}),
+                 Digit(bits, {33, 32, 31, 30})});
+}
+bool IsMarkerSecond(int s) { return s == 0 || s % 10 == 9; }
+bool PaddingIsZero(const bool *bits) {
+  for (int s : {4, 10, 11, 14, 20, 21, 24, 34, 35}) {
+    if (bits[s]) return false;
+  }
+  return true;
+}
+
+// WWVB: reduced carrier at the beginning of each second for 200ms (0),
+// 500ms (1) or 800ms (marker). Describes the current minute in UTC.
+class WWVBDecoder : public FrameDecoder {
+ public:
+  bool DecodeMinute(const ModulationSpan *seconds, time_t reference,
+                    DecodedMinute *result) final {
+    uint16_t samples[60];
+    SampleMinute(seconds, samples);
+    bool bits[60] = {};
+    for (int s = 0; s < 60; ++s) {
+      if (!Reduced(samples[s], 50) || Reduced(samples[s], 950)) return false;
+      if (Reduced(samples[s], 650) != IsMarkerSecond(s)) return false;
+      bits[s] = !IsMarkerSecond(s) && Reduced(samples[s], 350);
+    }
+    if (!PaddingIsZero(bits) || bits[44] || bits[54]) return false;
+    const int minute = PaddedMinute(bits);
+    const int hour = PaddedHour(bits);
+    const int yday = PaddedDayOfYear(bits);
+    const int year_digits = Number({Digit(bits, {48, 47, 46, 45}),
+                                    Digit(bits, {53, 52, 51, 50})});
+    if (year_digits < 0 || !ValidTime(hour, minute)) return false;
+    const int year = ExpandYear(year_digits, reference);
+    if (bits[55] != IsLeapYear(year)) return false;
+    int month, mday;
+    if (!DayOfYearToDate(year, yday, &month, &mday)) return false;
+    result->minute = UTCToEpoch(year, month, mday, hour, minute);
+    result->dst = bits[58];
+    return true;
+  }
+};
+
+// JJY: full carrier at the beginning of each second for 800ms (0),
+// 500ms (1) or 200ms (marker). Describes the current minute in Japanese
+// local time, without any DST information.
+class JJYDecoder : public FrameDecoder {
+ public:
+  bool DecodeMinute(const ModulationSpan *seconds, time_t reference,
+                    DecodedMinute *result) final {
+    uint16_t samples[60];
+    SampleMinute(seconds, samples);
+    bool bits[60] = {};
+    for (int s = 0; s < 60; ++s) {
+      if (Reduced(samples[s], 50) || !Reduced(samples[s], 950)) return false;
+      if (Reduced(samples[s], 350) != IsMarkerSecond(s)) return false;
+      bits[s] = !IsMarkerSecond(s) && Reduced(samples[s], 650);
+    }
+    if (!PaddingIsZero(bits)) return false;
+    for (int s = 55; s < 59; ++s) {
+      if (bits[s]) return false;
+    }
+    if (bits[36] != Parity(bits, 12, 18) || bits[37] != Parity(bits, 1, 8)) {
+      return false;
+    }
+    const int minute = PaddedMinute(bits);
+    const int hour = PaddedHour(bits);
+    const int yday = PaddedDayOfYear(bits);
+    const int year_digits = Number({Digit(bits, {44, 43, 42, 41}),
+                                    Digit(bits, {48, 47, 46, 45})});
+    const int wday = Digit(bits, {52, 51, 50});  // 0 = Sunday
+    if (year_digits < 0 || wday < 0 || !ValidTime(hour, minute)) return false;
+    const int year = ExpandYear(year_digits, reference);
+    int month, mday;
+    if (!DayOfYearToDate(year, yday, &month, &mday)) return false;
+    if (Weekday(year, month, mday) != wday) return false;
+    time_t t;
+    if (!local_time_.ToEpoch(year, month, mday, hour, minute, -1, &t)) {
+      return false;
+    }
+    result->minute = t;
+    result->dst = -1;
+    return true;
+  }
+
+ private:
+  LocalTimeConverter local_time_;
+};
+
+// MSF: carrier off for 500ms in second 0. Each other second has carrier off
+// for the first 100ms, followed by the bits A and B for 100ms each (off = 1).
+// Describes the upcoming minute in UK local time.
+class MSFDecoder : public FrameDecoder {
+ public:
+  bool DecodeMinute(const ModulationSpan *seconds, time_t reference,
+                    DecodedMinute *result) final {
+    uint16_t samples[60];
+    SampleMinute(seconds, samples);
+    if (!Reduced(samples[0], 50) || !Reduced(samples[0], 450) ||
+        Reduced(samples[0], 650)) {
+      return false;
+    }
+    bool a[60] = {}, b[60] = {};
+    for (int s = 1; s < 60; ++s) {
+      if (!Reduced(samples[s], 50) || Reduced(samples[s], 350)) return false;
+      a[s] = Reduced(samples[s], 150);
+      b[s] = Reduced(samples[s], 250);
+    }
+    // Minute identifier 01111110 in A.
+    if (a[52] || a[59]) return false;
+    for (int s = 53; s < 59; ++s) {
+      if (!a[s]) return false;
+    }
+    // Odd parity, including the parity bit in B.
+    if (!(Parity(a, 17, 24) ^ b[54]) || !(Parity(a, 25, 35) ^ b[55]) ||
+        !(Parity(a, 36, 38) ^ b[56]) || !(Parity(a, 39, 51) ^ b[57])) {
+      return false;
+    }
+    const int year_digits = Number({Digit(a, {20, 19, 18, 17}),  //
+                                    Digit(a, {24, 23, 22, 21})});
+    const int month = Number({Digit(a, {25}), Digit(a, {29, 28, 27, 26})});
+    const int mday = Number({Digit(a, {31, 30}), Digit(a, {35, 34, 33, 32})});
+    const int wday = Digit(a, {38, 37, 36});  // 0 = Sunday
+    const int hour = Number({Digit(a, {40, 39}), Digit(a, {44, 43, 42, 41})});
+    const int minute =
+        Number({Digit(a, {47, 46, 45}), Digit(a, {51, 50, 49, 48})});
+    if (year_digits < 0 || wday < 0 || !ValidTime(hour, minute)) return false;
+    const int year = ExpandYear(year_digits, reference);
+    if (!ValidDate(year, month, mday)) return false;
+    if (Weekday(year, month, mday) != wday) return false;
+    time_t t;
+    if (!local_time_.ToEpoch(year, month, mday, hour, minute, b[58], &t)) {
+      return false;
+    }
+    result->minute = t - 60;
+    result->dst = b[58];
+    return true;
+  }
+
+ private:
+  LocalTimeConverter local_time_;
+};
+
+// BPC: three 20 second frames per minute. Each second but the first of a
+// frame starts with 100ms to 400ms reduced carrier, carrying a symbol of two
+// bits. Describes the current minute in Chinese local time.
+class BPCDecoder : public FrameDecoder {
+ public:
+  bool DecodeMinute(const ModulationSpan *seconds, time_t reference,
+                    DecodedMinute *result) final {
+    uint16_t samples[60];
+    SampleMinute(seconds, samples);
+    int symbols[60] = {};
+    for (int s = 0; s < 60; ++s) {
+      if (s % 20 == 0) {
+        if (Reduced(samples[s], 50)) return false;
+        continue;
+      }
+      if (!Reduced(samples[s], 50) || Reduced(samples[s], 450)) return false;
+      symbols[s] = Reduced(samples[s], 150) + Reduced(samples[s], 250) +
+                   Reduced(samples[s], 350);
+    }
+    // All frames have the same content apart from their number and the
+    // parity covering it.
+    for (int frame = 0; frame < 3; ++frame) {
+      const int *const frame_symbols = symbols + frame * 20;
+      if (frame_symbols[1] != frame) return false;
+      for (int s = 2; s < 20; ++s) {
+        if (s != 10 && frame_symbols[s] != symbols[s]) return false;
+      }
+      if ((frame_symbols[10] & 2) != (symbols[10] & 2)) return false;
+      bool frame_bits[40] = {};  // Two per second, least significant first.
+      for (int s = 0; s < 20; ++s) {
+        frame_bits[2 * s] = frame_symbols[s] & 1;
+        frame_bits[2 * s + 1] = frame_symbols[s] & 2;
+      }
+      if (Parity(frame_bits, 2, 19) != frame_bits[20] ||
+          Parity(frame_bits, 22, 37) != frame_bits[38]) {
+        return false;
+      }
+    }
+    if (symbols[2] != 0) return false;
+    const bool pm = symbols[10] & 2;
+    const int hour_12 = symbols[3] * 4 + symbols[4];
+    const int hour = hour_12 + (pm ? 12 : 0);
+    const int minute = (symbols[5] * 4 + symbols[6]) * 4 + symbols[7];
+    const int wday = symbols[8] * 4 + symbols[9];  // 1 = Monday .. 7 = Sunday
+    const int mday = (symbols[11] * 4 + symbols[12]) * 4 + symbols[13];
+    const int month = symbols[14] * 4 + symbols[15];
+    const int year_digits = (symbols[19] & 2 ? 64 : 0) +
+                            (symbols[16] * 4 + symbols[17]) * 4 + symbols[18];
+    if (year_digits > 99 || wday < 1 || hour_12 > 11 ||
+        !ValidTime(hour, minute)) {
+      return false;
+    }
+    const int year = ExpandYear(year_digits, reference);
+    if (!ValidDate(year, month, mday)) return false;
+    if (Weekday(year, month, mday) != wday % 7) return false;
+    time_t t;
+    if (!local_time_.ToEpoch(year, month, mday, hour, minute, -1, &t)) {
+      return false;
+    }
+    result->minute = t;
+    result->dst = -1;
+    return true;
+  }
+
+ private:
+  LocalTimeConverter local_time_;
+};
+}  // namespace
+
+std::unique_ptr<FrameDecoder> CreateFrameDecoder(const char *name) {
+  if (strcasecmp(name, "DCF77") == 0) return std::make_unique<DCF77Decoder>();
+  if (strcasecmp(name, "WWVB") == 0) return std::make_unique<WWVBDecoder>();
+  if (strcasecmp(name, "JJY40") == 0 || strcasecmp(name, "JJY60") == 0) {
+    return std::make_unique<JJYDecoder>();
+  }
+  if (strcasecmp(name, "MSF") == 0) return std::make_unique<MSFDecoder>();
+  if (strcasecmp(name, "BPC") == 0) return std::make_unique<BPCDecoder>();
+  return nullptr;
+}
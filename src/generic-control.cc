@@ -0,0 +1,207 @@
+// -*- mode: c++; c-basic-offset: 2; indent-tabs-mode: nil; -*-
+// Part of txtempus, a LF time signal transmitter.
+// Copyright (C) 2018 Henner Zeller <h.zeller@acm.org>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#include "generic/generic-control.h"
+
+#include <fcntl.h>
+#include <linux/gpio.h>
+#include <sys/ioctl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+#include "carrier-power.h"
+#include "hardware-control.h"
+
+// Defaults; set by cmake/generic-control.cmake
+#ifndef GENERIC_GPIO_CHIP
+#define GENERIC_GPIO_CHIP "/dev/gpiochip0"
+#endif
+#ifndef GENERIC_ATTENUATION_LINE
+#define GENERIC_ATTENUATION_LINE 17
+#endif
+#ifndef GENERIC_PWM_CHIP
+#define GENERIC_PWM_CHIP "/sys/class/pwm/pwmchip0"
+#endif
+#ifndef GENERIC_PWM_CHANNEL
+#define GENERIC_PWM_CHANNEL 0
+#endif
+
+static const char *GetEnvOr(const char *name, const char *fallback) {
+  const char *value = getenv(name);
+  return (value && *value) ? value : fallback;
+}
+
+static bool WriteSysfs(const std::string &filename, const char *value) {
+  const int fd = open(filename.c_str(), O_WRONLY | O_TRUNC);
+  if (fd < 0) {
+    perror(filename.c_str());
+    return false;
+  }
+  const ssize_t len = strlen(value);
+  const bool success = (write(fd, value, len) == len);
+  if (!success) perror(filename.c_str());
+  close(fd);
+  return success;
+}
+
+static bool WriteSysfs(const std::string &filename, long value) {
+  char buf[32];
+  snprintf(buf, sizeof(buf), "%ld", value);
+  return WriteSysfs(filename, buf);
+}
+
+GenericControl::~GenericControl() {
+  if (pwm_enable_fd_ >= 0) close(pwm_enable_fd_);
+  if (line_fd_ >= 0) close(line_fd_);  // Releases the line request.
+}
+
+bool GenericControl::Init() {
+  const char *chip = GetEnvOr("TXTEMPUS_GPIO_CHIP", GENERIC_GPIO_CHIP);
+  const int line = atoi(GetEnvOr("TXTEMPUS_GPIO_LINE", "-1"));
+  const char *pwm_chip = GetEnvOr("TXTEMPUS_PWM_CHIP", GENERIC_PWM_CHIP);
+  const int channel = atoi(GetEnvOr("TXTEMPUS_PWM_CHANNEL", "-1"));
+
+  if (strcmp(chip, "none") == 0) {
+    fprintf(stderr, "No attenuation line; sending reduced power as full.\n");
+  } else if (!RequestAttenuationLine(
+                 chip, line >= 0 ? line : GENERIC_ATTENUATION_LINE)) {
+    return false;
+  }
+  return OpenPwmChannel(pwm_chip,
+                        channel >= 0 ? channel : GENERIC_PWM_CHANNEL);
+}
+
+bool GenericControl::RequestAttenuationLine(const char *chip, int line) {
+  const int chip_fd = open(chip, O_RDWR | O_CLOEXEC);
+  if (chip_fd < 0) {
+    perror(chip);
+    return false;
+  }
+
+  // Open drain: driving a zero pulls down the divider, a one leaves it
+  // floating. Same electrical behavior as switching between output and
+  // input on the other platforms, but only needs a value change per edge.
+  struct gpio_v2_line_request request = {};
+  request.offsets[0] = line;
+  request.num_lines = 1;
+  strncpy(request.consumer, "txtempus", sizeof(request.consumer) - 1);
+  request.config.flags =
+      GPIO_V2_LINE_FLAG_OUTPUT | GPIO_V2_LINE_FLAG_OPEN_DRAIN;
+  request.config.num_attrs = 1;
+  request.config.attrs[0].attr.id = GPIO_V2_LINE_ATTR_ID_OUTPUT_VALUES;
+  request.config.attrs[0].attr.values = 1;  // Start not attenuated.
+  request.config.attrs[0].mask = 1;
+
+  const int result = ioctl(chip_fd, GPIO_V2_GET_LINE_IOCTL, &request);
+  close(chip_fd);  // The line request fd stays valid on its own.
+  if (result < 0) {
+    fprintf(stderr, "%s: can't request line %d: %s\n", chip, line,
+            strerror(errno));
+    return false;
+  }
+  line_fd_ = request.fd;
+  attenuated_ = false;
+  return true;
+}
+
+bool GenericControl::OpenPwmChannel(const std::string &chip_dir, int channel) {
+  pwm_dir_ = chip_dir + "/pwm" + std::to_string(channel);
+  struct stat s;
+  if (stat(pwm_dir_.c_str(), &s) != 0) {
+    if (!WriteSysfs(chip_dir + "/export", channel)) return false;
+    // Give udev a moment to create the channel and fix permissions.
+    for (int i = 0; i < 100 && access((pwm_dir_ + "/enable").c_str(), W_OK);
+         ++i) {
+      usleep(10000);
+    }
+  }
+  pwm_enable_fd_ = open((pwm_dir_ + "/enable").c_str(), O_WRONLY | O_CLOEXEC);
+  if (pwm_enable_fd_ < 0) {
+    perror((pwm_dir_ + "/enable").c_str());
+    return false;
+  }
+  // Might still be running from a previous invocation.
+  output_enabled_ = true;
+  EnableClockOutput(false);
+  return true;
+}
+
+double GenericControl::StartClock(double frequency_hertz) {
+  if (frequency_hertz <= 0) return -1;
+  const long period_ns = lround(1e9 / frequency_hertz);
+  if (period_ns < 2) return -1;
+
+  StopClock();
+  // The duty cycle always needs to be smaller than the period, so we can't
+  // just switch to the new period while the old duty cycle is larger.
+  if (!WriteSysfs(pwm_dir_ + "/duty_cycle", 0L) ||
+      !WriteSysfs(pwm_dir_ + "/period", period_ns) ||
+      !WriteSysfs(pwm_dir_ + "/duty_cycle", period_ns / 2)) {
+    return -1;
+  }
+  clock_running_ = true;
+  EnableClockOutput(true);
+  return 1e9 / period_ns;
+}
+
+void GenericControl::StopClock() {
+  EnableClockOutput(false);
+  clock_running_ = false;
+}
+
+void GenericControl::EnableClockOutput(bool on) {
+  on = on && clock_running_;
+  if (on == output_enabled_) return;
+  // sysfs attributes don't care about the file position, but pwrite()
+  // keeps us from having to seek back.
+  if (pwrite(pwm_enable_fd_, on ? "1" : "0", 1, 0) == 1) {
+    output_enabled_ = on;
+  }
+}
+
+void GenericControl::SetAttenuation(bool attenuate) {
+  if (attenuate == attenuated_ || line_fd_ < 0) return;
+  struct gpio_v2_line_values values = {};
+  values.bits = attenuate ? 0 : 1;
+  values.mask = 1;
+  if (ioctl(line_fd_, GPIO_V2_LINE_SET_VALUES_IOCTL, &values) == 0) {
+    attenuated_ = attenuate;
+  }
+}
+
+void GenericControl::SetTxPower(CarrierPower power) {
+  switch (power) {
+    case CarrierPower::OFF:
+      EnableClockOutput(false);
+      break;
+    case CarrierPower::LOW:
+      SetAttenuation(true);
+      EnableClockOutput(true);
+      break;
+    case CarrierPower::HIGH:
+      SetAttenuation(false);
+      EnableClockOutput(true);
+      break;
+  }
+}
@@ -1,6 +1,6 @@
 // -*- mode: c++; c-basic-offset: 2; indent-tabs-mode: nil; -*-
 // Part of txtempus, a LF time signal transmitter.
-// Copyright (C) 2013 Henner Zeller <h.zeller@acm.org>
+// Copyright (C) 2018 Henner Zeller <h.zeller@acm.org>
 //
 // This program is free software: you can redistribute it and/or modify
 // it under the terms of the GNU General Public License as published by
@@ -17,20 +17,126 @@
 
 #include "hardware-control.h"
 
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
 #include <memory>
+#include <string>
 
-#include "carrier-power.h"
-#include "hardware-control-implementation.h"  // Chosen by CMake -DPLATFORM
+#include "hardware-backends.h"
 
-HardwareControl::HardwareControl()
-    : pimpl(std::unique_ptr<Implementation>(new Implementation())) {}
-HardwareControl::~HardwareControl() = default;
-bool HardwareControl::Init() { return pimpl->Init(); }
-double HardwareControl::StartClock(double frequency_hertz) {
-  return pimpl->StartClock(frequency_hertz);
+namespace {
+// Platforms compiled in, in the order they are checked.
+constexpr const char *kPlatforms[] = {
+#ifdef TXTEMPUS_HAVE_RPI
+    "rpi",
+#endif
+#ifdef TXTEMPUS_HAVE_SUNXIH3
+    "sunxih3",
+#endif
+#ifdef TXTEMPUS_HAVE_JETSON
+    "jetson",
+#endif
+#ifdef TXTEMPUS_HAVE_GENERIC
+    "generic",
+#endif
+};
+
+bool HavePlatform(const char *name) {
+  for (const char *platform : kPlatforms) {
+    if (strcmp(platform, name) == 0) return true;
+  }
+  return false;
+}
+
+// Read a small file. The device tree has lists of nul terminated strings,
+// so these are replaced with spaces to be searchable.
+std::string ReadFile(const char *filename) {
+  std::string result;
+  FILE *f = fopen(filename, "r");
+  if (!f) return result;
+  char buffer[4096];
+  size_t r;
+  while ((r = fread(buffer, 1, sizeof(buffer), f)) > 0) {
+    result.append(buffer, r);
+  }
+  fclose(f);
+  for (char &c : result) {
+    if (c == '\0') c = ' ';
+  }
+  return result;
+}
+
+// Platform from the device tree or /proc/cpuinfo, nullptr if unknown.
+const char *DetectBoard() {
+  // The Pi 5 (BCM2712) has its clocks and GPIO behind the RP1 chip, not
+  // where the rpi backend expects them, so it is a generic board for us.
+  const std::string compatible = ReadFile("/proc/device-tree/compatible");
+  if (compatible.find("brcm,bcm2712") != std::string::npos) return "generic";
+  if (compatible.find("raspberrypi") != std::string::npos ||
+      compatible.find("brcm,bcm2") != std::string::npos) {
+    return "rpi";
+  }
+  if (compatible.find("allwinner,sun8i-h3") != std::string::npos) {
+    return "sunxih3";
+  }
+  if (compatible.find("nvidia,tegra") != std::string::npos) return "jetson";
+
+  // Older kernels without device tree in /proc.
+  const std::string cpuinfo = ReadFile("/proc/cpuinfo");
+  if (cpuinfo.find("Raspberry Pi 5") != std::string::npos) return "generic";
+  if (cpuinfo.find("Raspberry Pi") != std::string::npos ||
+      cpuinfo.find("BCM2") != std::string::npos) {
+    return "rpi";
+  }
+  if (cpuinfo.find("sun8i") != std::string::npos) return "sunxih3";
+  return nullptr;
 }
-void HardwareControl::StopClock() { pimpl->StopClock(); }
-void HardwareControl::EnableClockOutput(bool b) { pimpl->EnableClockOutput(b); }
-void HardwareControl::SetTxPower(CarrierPower power) {
-  pimpl->SetTxPower(power);
+}  // namespace
+
+const char *HardwareControl::DetectPlatform() {
+  const char *forced = getenv("TXTEMPUS_PLATFORM");
+  if (forced && *forced) return forced;
+  static const char *const detected = []() -> const char * {
+    const char *board = DetectBoard();
+    if (board && HavePlatform(board)) return board;
+    if (HavePlatform("generic")) return "generic";
+    return kPlatforms[0];  // CMakeLists.txt makes sure there is one.
+  }();
+  return detected;
+}
+
+const char *HardwareControl::AvailablePlatforms() {
+  static const std::string list = []() {
+    std::string result;
+    for (const char *platform : kPlatforms) {
+      if (!result.empty()) result.append(",");
+      result.append(platform);
+    }
+    return result;
+  }();
+  return list.c_str();
+}
+
+std::unique_ptr<HardwareControl> HardwareControl::Create(
+    const char *platform) {
+#ifdef TXTEMPUS_HAVE_RPI
+  if (strcmp(platform, "rpi") == 0) return std::make_unique<RpiControl>();
+#endif
+#ifdef TXTEMPUS_HAVE_SUNXIH3
+  if (strcmp(platform, "sunxih3") == 0) {
+    return std::make_unique<SunxiH3Control>();
+  }
+#endif
+#ifdef TXTEMPUS_HAVE_JETSON
+  if (strcmp(platform, "jetson") == 0) {
+    return std::make_unique<JetsonControl>();
+  }
+#endif
+#ifdef TXTEMPUS_HAVE_GENERIC
+  if (strcmp(platform, "generic") == 0) {
+    return std::make_unique<GenericControl>();
+  }
+#endif
+  return nullptr;
 }
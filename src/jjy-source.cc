@@ -17,55 +17,69 @@
 
 #include <cstdint>
 #include <ctime>
+#include <iterator>
 
 #include "carrier-power.h"
+#include "station-spec.h"
 #include "time-signal-source.h"
 
-// Similar to WWVB, JJY uses BCD, but usually has a zero bit between the digits.
-// So let's call it 'padded' BCD.
-static uint64_t to_padded5_bcd(int n) {
-  return (((n / 100) % 10) << 10) | (((n / 10) % 10) << 5) | (n % 10);
-}
+// https://en.wikipedia.org/wiki/JJY
+// Big endian bits in local time; if in JP, this is Japan Standard Time.
+// Similar to WWVB, JJY uses BCD, but usually has a zero bit between the
+// digits; only the year and weekday are regular BCD.
+//
+// There is a different 'service announcement' encoding in minute 15 and 45,
+// but let's just ignore that for now. Consumer clocks probably don't care.
+static constexpr FieldSpec kJJYFields[] = {
+    {FieldValue::MINUTE, FieldEncoding::PADDED_BCD, 1, 8},
+    {FieldValue::HOUR, FieldEncoding::PADDED_BCD, 12, 7},
+    {FieldValue::DAY_OF_YEAR, FieldEncoding::PADDED_BCD, 22, 12},
+    {FieldValue::YEAR_OF_CENTURY, FieldEncoding::BCD, 41, 8},
+    {FieldValue::DAY_OF_WEEK, FieldEncoding::BCD, 50, 3},
+};
 
-// Regular BCD for the year encoding.
-static uint64_t to_bcd(int n) {
-  return (((n / 100) % 10) << 8) | (((n / 10) % 10) << 4) | (n % 10);
-}
+static constexpr ParitySpec kJJYParities[] = {
+    {12, 18, 0, 36, 0},  // PA1
+    {1, 8, 0, 37, 0},    // PA2
+};
 
-static uint64_t parity(uint64_t d, uint8_t from, uint8_t to_including) {
-  uint8_t result = 0;
-  for (int bit = from; bit <= to_including; ++bit) {
-    if (d & (1LL << bit)) result++;
-  }
-  return result & 0x1;
-}
+static constexpr PulseSpec kJJYSymbols[] = {
+    {2, {{CarrierPower::HIGH, Millis(800)}, {CarrierPower::LOW, 0}}},
+    {2, {{CarrierPower::HIGH, Millis(500)}, {CarrierPower::LOW, 0}}},
+};
 
-void JJYTimeSignalSource::PrepareMinute(time_t t) {
-  struct tm breakdown;
-  localtime_r(&t, &breakdown);  // If in JP, this is Japan Standard Time
+// JJY40 and JJY60 only differ in their carrier frequency.
+static constexpr StationSpec kJJYSpec = {
+    /*time_offset_seconds=*/0,
+    /*utc=*/false,
+    /*msb_first=*/true,
+    /*frame_seconds=*/60,
+    /*bits_per_second=*/1,
+    kJJYFields,
+    std::size(kJJYFields),
+    kJJYParities,
+    std::size(kJJYParities),
+    /*marker_seconds=*/(1ULL << 0) | (1ULL << 9) | (1ULL << 19) |
+        (1ULL << 29) | (1ULL << 39) | (1ULL << 49) | (1ULL << 59),
+    /*marker=*/{2, {{CarrierPower::HIGH, Millis(200)}, {CarrierPower::LOW, 0}}},
+    kJJYSymbols,
+};
 
-  // https://en.wikipedia.org/wiki/JJY
-  // The JJY format uses Bit-Bigendianess, so we'll start with the first
-  // bit left in our integer in bit 59.
-  time_bits_ = 0;  // All the unused bits are zero.
-  time_bits_ |= to_padded5_bcd(breakdown.tm_min) << (59 - 8);
-  time_bits_ |= to_padded5_bcd(breakdown.tm_hour) << (59 - 18);
-  time_bits_ |= to_padded5_bcd(breakdown.tm_yday + 1) << (59 - 33);
-  time_bits_ |= to_bcd(breakdown.tm_year % 100) << (59 - 48);
-  time_bits_ |= to_bcd(breakdown.tm_wday) << (59 - 52);
-
-  time_bits_ |= parity(time_bits_, 59 - 18, 59 - 12) << (59 - 36);  // PA1
-  time_bits_ |= parity(time_bits_, 59 - 8, 59 - 1) << (59 - 37);    // PA2
+template <int kCarrierHz>
+void JJYTimeSignalSource<kCarrierHz>::PrepareMinute(time_t t) {
+  EncodeSpecMinute<kJJYSpec>(t, &calendars_, symbols_);
+}
 
-  // There is a different 'service announcement' encoding in minute 15 and 45,
-  // but let's just ignore that for now. Consumer clocks probably don't care.
+template <int kCarrierHz>
+TimeSignalSource::ModulationSpan
+JJYTimeSignalSource<kCarrierHz>::GetModulationSpan(int sec) {
+  return SpecModulationForSecond<kJJYSpec>(symbols_, sec);
 }
 
-TimeSignalSource::SecondModulation JJYTimeSignalSource::GetModulationForSecond(
-    int sec) {
-  if (sec == 0 || sec % 10 == 9 || sec > 59) {
-    return {{CarrierPower::HIGH, 200}, {CarrierPower::LOW, 0}};
-  }
-  const bool bit = time_bits_ & (1LL << (59 - sec));
-  return {{CarrierPower::HIGH, bit ? 500 : 800}, {CarrierPower::LOW, 0}};
+template <int kCarrierHz>
+int JJYTimeSignalSource<kCarrierHz>::GetSymbolForSecond(int sec) const {
+  return SpecSymbolForSecond<kJJYSpec>(symbols_, sec);
 }
+
+template class JJYTimeSignalSource<40000>;
+template class JJYTimeSignalSource<60000>;
@@ -0,0 +1,84 @@
+// -*- mode: c++; c-basic-offset: 2; indent-tabs-mode: nil; -*-
+// Part of txtempus, a LF time signal transmitter.
+// Copyright (C) 2018 Henner Zeller <h.zeller@acm.org>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#include "latency-stats.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+
+LatencyStats::LatencyStats(size_t expected_samples) {
+  samples_.reserve(expected_samples);
+}
+
+int64_t LatencyStats::Percentile(double fraction) {
+  if (samples_.empty()) return 0;
+  if (!sorted_) {
+    std::sort(samples_.begin(), samples_.end());
+    sorted_ = true;
+  }
+  size_t index = fraction * samples_.size();
+  if (index >= samples_.size()) index = samples_.size() - 1;
+  return samples_[index];
+}
+
+size_t LatencyStats::CountAbove(int64_t ns) const {
+  return std::count_if(samples_.begin(), samples_.end(),
+                       [ns](int64_t s) { return s > ns; });
+}
+
+void LatencyStats::Print(FILE *out, const char *title) {
+  fprintf(out, "%s: %zu samples\n", title, samples_.size());
+  if (samples_.empty()) return;
+
+  double sum = 0;
+  for (int64_t s : samples_) sum += s;
+  fprintf(out, "  min %.2fus  avg %.2fus  max %.2fus\n",
+          Percentile(0) / 1e3, sum / samples_.size() / 1e3,
+          Percentile(1) / 1e3);
+  fprintf(out, "  p50 %.2fus  p90 %.2fus  p99 %.2fus  p99.9 %.2fus\n",
+          Percentile(0.5) / 1e3, Percentile(0.9) / 1e3, Percentile(0.99) / 1e3,
+          Percentile(0.999) / 1e3);
+
+  // 1-2-5 steps from 1us to 10ms; the last bucket takes everything above.
+  static constexpr int64_t kBucketLimitsNs[] = {
+      1000,    2000,    5000,    10000,   20000,   50000,   100000,
+      200000,  500000,  1000000, 2000000, 5000000, 10000000};
+  static constexpr int kBuckets = sizeof(kBucketLimitsNs) / sizeof(int64_t);
+  static constexpr int kBarWidth = 50;
+  size_t counts[kBuckets + 1] = {};
+  for (int64_t s : samples_) {
+    int b = 0;
+    while (b < kBuckets && s >= kBucketLimitsNs[b]) ++b;
+    counts[b]++;
+  }
+  const size_t largest = *std::max_element(counts, counts + kBuckets + 1);
+  for (int b = 0; b <= kBuckets; ++b) {
+    if (counts[b] == 0) continue;
+    char label[32];
+    if (b < kBuckets) {
+      snprintf(label, sizeof(label), "< %lldus",
+               (long long)kBucketLimitsNs[b] / 1000);
+    } else {
+      snprintf(label, sizeof(label), ">= %lldus",
+               (long long)kBucketLimitsNs[kBuckets - 1] / 1000);
+    }
+    const int bar = (counts[b] * kBarWidth + largest - 1) / largest;
+    fprintf(out, "  %10s %8zu %.*s\n", label, counts[b], bar,
+            "##################################################");
+  }
+}
@@ -0,0 +1,163 @@
+// -*- mode: c++; c-basic-offset: 2; indent-tabs-mode: nil; -*-
+// Part of txtempus, a LF time signal transmitter.
+// Copyright (C) 2018 Henner Zeller <h.zeller@acm.org>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+
+#include "log-ring.h"
+
+#include <pthread.h>
+#include <sched.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstdarg>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <thread>
+
+LogRing::LogRing() {
+  for (int i = 0; i < kSlots; ++i) {
+    slots_[i].sequence.store(i, std::memory_order_relaxed);
+  }
+}
+
+LogRing::~LogRing() { Stop(); }
+
+void LogRing::Start(int fd) {
+  wake_fd_ = eventfd(0, EFD_CLOEXEC);
+  if (wake_fd_ < 0) {
+    perror("eventfd");
+    StartDirect(fd);
+    return;
+  }
+  fd_ = fd;
+  running_ = true;
+  thread_ = std::thread(&LogRing::Run, this);
+}
+
+void LogRing::StartDirect(int fd) {
+  fd_ = fd;
+  direct_ = true;
+  while (Drain()) {  // Whatever was logged before.
+  }
+}
+
+void LogRing::Stop() {
+  if (!thread_.joinable()) return;
+  running_ = false;
+  Wake();
+  thread_.join();
+  while (Drain()) {
+  }
+  const int wake_fd = wake_fd_;
+  wake_fd_ = -1;
+  close(wake_fd);
+}
+
+void LogRing::Wake() {
+  const uint64_t one = 1;
+  if (write(wake_fd_, &one, sizeof(one)) < 0) {
+    // Only fails if the counter overflows, then the thread is awake anyway.
+  }
+}
+
+// A slot is free for writing message number "pos" if its sequence is "pos",
+// and ready to be drained if it is "pos + 1". After draining, it becomes
+// free for the message one round later.
+void LogRing::Printf(const char *format, ...) {
+  if (direct_) {
+    char text[kSlotSize];
+    va_list ap;
+    va_start(ap, format);
+    const int length = vsnprintf(text, sizeof(text), format, ap);
+    va_end(ap);
+    if (length > 0) WriteAll(text, std::min(length, kSlotSize - 1));
+    return;
+  }
+  uint64_t pos = head_.load(std::memory_order_relaxed);
+  Slot *slot;
+  for (;;) {
+    slot = &slots_[pos & (kSlots - 1)];
+    const int64_t diff =
+        (int64_t)(slot->sequence.load(std::memory_order_acquire) - pos);
+    if (diff == 0) {
+      if (head_.compare_exchange_weak(pos, pos + 1,
+                                      std::memory_order_relaxed)) {
+        break;
+      }
+    } else if (diff < 0) {  // Not drained yet: full.
+      dropped_.fetch_add(1, std::memory_order_relaxed);
+      return;
+    } else {  // Another thread got this one first.
+      pos = head_.load(std::memory_order_relaxed);
+    }
+  }
+  va_list ap;
+  va_start(ap, format);
+  const int length = vsnprintf(slot->text, kSlotSize, format, ap);
+  va_end(ap);
+  slot->length = (length < 0) ? 0 : (length >= kSlotSize) ? kSlotSize - 1
+                                                          : length;
+  slot->sequence.store(pos + 1, std::memory_order_release);
+  if (pending_.fetch_add(1, std::memory_order_acq_rel) == 0 && wake_fd_ >= 0) {
+    Wake();
+  }
+}
+
+bool LogRing::Drain() {
+  // Collect what is ready, so that it goes out in a single write().
+  char buffer[16 * kSlotSize];
+  size_t size = 0;
+  int count = 0;
+  while (size + kSlotSize <= sizeof(buffer)) {
+    Slot *slot = &slots_[tail_ & (kSlots - 1)];
+    if (slot->sequence.load(std::memory_order_acquire) != tail_ + 1) break;
+    memcpy(buffer + size, slot->text, slot->length);
+    size += slot->length;
+    slot->sequence.store(tail_ + kSlots, std::memory_order_release);
+    ++tail_;
+    ++count;
+  }
+  pending_.fetch_sub(count, std::memory_order_acq_rel);
+  WriteAll(buffer, size);
+  return size > 0;
+}
+
+void LogRing::WriteAll(const char *data, size_t size) {
+  for (size_t written = 0; written < size; /**/) {
+    const ssize_t w = write(fd_, data + written, size - written);
+    if (w < 0 && errno == EINTR) continue;
+    if (w <= 0) break;  // Nowhere to write to; nothing we can do about it.
+    written += w;
+  }
+}
+
+void LogRing::Run() {
+  // Whatever the main thread does, we never want to compete with it.
+  struct sched_param sp = {};
+  pthread_setschedparam(pthread_self(), SCHED_OTHER, &sp);
+  while (running_) {
+    Drain();
+    if (pending_.load(std::memory_order_acquire) > 0) continue;
+    // Whoever makes pending_ go from 0 to 1 from now on wakes us up.
+    uint64_t count;
+    if (read(wake_fd_, &count, sizeof(count)) < 0 && errno != EINTR) break;
+  }
+}
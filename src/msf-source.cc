@@ -17,55 +17,88 @@
 
 #include <cstdint>
 #include <ctime>
+#include <iterator>
 
 #include "carrier-power.h"
+#include "station-spec.h"
 #include "time-signal-source.h"
 
-static uint64_t to_bcd(uint8_t n) { return (((n / 10) % 10) << 4) | (n % 10); }
-static uint64_t odd_parity(uint64_t d, uint8_t from, uint8_t to_including) {
-  uint8_t result = 0;
-  for (int bit = from; bit <= to_including; ++bit) {
-    if (d & (1LL << bit)) result++;
-  }
-  return (result & 0x1) == 0;
-}
+// https://en.wikipedia.org/wiki/Time_from_NPL_(MSF)
+// Big endian bits of the _upcoming_ minute in local time, e.g. British
+// standard time. Each second carries two bits, A (symbol bit 1) and
+// B (symbol bit 0).
+static constexpr int kBitA = 1;
+static constexpr int kBitB = 0;
 
-void MSFTimeSignalSource::PrepareMinute(time_t t) {
-  t += 60;  // We're sending the _upcoming_ minute.
-  struct tm breakdown;
-  localtime_r(&t, &breakdown);  // Local time, e.g. British standard time.
+static constexpr FieldSpec kMSFFields[] = {
+    {FieldValue::YEAR_OF_CENTURY, FieldEncoding::BCD, 17, 8, kBitA},
+    {FieldValue::MONTH, FieldEncoding::BCD, 25, 5, kBitA},
+    {FieldValue::DAY_OF_MONTH, FieldEncoding::BCD, 30, 6, kBitA},
+    {FieldValue::DAY_OF_WEEK, FieldEncoding::BCD, 36, 3, kBitA},
+    {FieldValue::HOUR, FieldEncoding::BCD, 39, 6, kBitA},
+    {FieldValue::MINUTE, FieldEncoding::BCD, 45, 7, kBitA},
+    // Identifying the upcoming minute transition; A is zero in second 59.
+    {FieldValue::ALL_ONES, FieldEncoding::BINARY, 53, 6, kBitA},
+    // First couple of B bits: DUT; not being set.
+    // Second 53: summer time warning. Not set.
+    {FieldValue::DST, FieldEncoding::BINARY, 58, 1, kBitB},
+};
+
+static constexpr ParitySpec kMSFParities[] = {
+    {17, 24, kBitA, 54, kBitB, /*odd=*/true},  // Year
+    {25, 35, kBitA, 55, kBitB, /*odd=*/true},  // Day
+    {36, 38, kBitA, 56, kBitB, /*odd=*/true},  // Weekday
+    {39, 51, kBitA, 57, kBitB, /*odd=*/true},  // Time
+};
 
-  // https://en.wikipedia.org/wiki/Time_from_NPL_(MSF)
-  // The MSF format uses Bit-Bigendianess, so we'll start with the first
-  // bit left in our integer in bit 59.
+// Indexed by (A << 1) | B.
+static constexpr PulseSpec kMSFSymbols[] = {
+    {4,
+     {{CarrierPower::OFF, Millis(100)},
+      {CarrierPower::HIGH, Millis(100)},
+      {CarrierPower::HIGH, Millis(100)},
+      {CarrierPower::HIGH, 0}}},
+    {4,
+     {{CarrierPower::OFF, Millis(100)},
+      {CarrierPower::HIGH, Millis(100)},
+      {CarrierPower::OFF, Millis(100)},
+      {CarrierPower::HIGH, 0}}},
+    {4,
+     {{CarrierPower::OFF, Millis(100)},
+      {CarrierPower::OFF, Millis(100)},
+      {CarrierPower::HIGH, Millis(100)},
+      {CarrierPower::HIGH, 0}}},
+    {4,
+     {{CarrierPower::OFF, Millis(100)},
+      {CarrierPower::OFF, Millis(100)},
+      {CarrierPower::OFF, Millis(100)},
+      {CarrierPower::HIGH, 0}}},
+};
 
-  a_bits_ =
-      0b1111110;  // Last bits of a, identifying upcoming minute transition
-  a_bits_ |= to_bcd(breakdown.tm_year % 100) << (59 - 24);
-  a_bits_ |= to_bcd(breakdown.tm_mon + 1) << (59 - 29);
-  a_bits_ |= to_bcd(breakdown.tm_mday) << (59 - 35);
-  a_bits_ |= to_bcd(breakdown.tm_wday) << (59 - 38);
-  a_bits_ |= to_bcd(breakdown.tm_hour) << (59 - 44);
-  a_bits_ |= to_bcd(breakdown.tm_min) << (59 - 51);
+static constexpr StationSpec kMSFSpec = {
+    /*time_offset_seconds=*/60,
+    /*utc=*/false,
+    /*msb_first=*/true,
+    /*frame_seconds=*/60,
+    /*bits_per_second=*/2,
+    kMSFFields,
+    std::size(kMSFFields),
+    kMSFParities,
+    std::size(kMSFParities),
+    /*marker_seconds=*/1ULL << 0,
+    /*marker=*/{2, {{CarrierPower::OFF, Millis(500)}, {CarrierPower::HIGH, 0}}},
+    kMSFSymbols,
+};
 
-  b_bits_ = 0;
-  // First couple of bits: DUT; not being set.
-  // (59 - 53): summer time warning. Not set.
-  b_bits_ |= odd_parity(a_bits_, 59 - 24, 59 - 17) << (59 - 54);  // Year parity
-  b_bits_ |= odd_parity(a_bits_, 59 - 35, 59 - 25) << (59 - 55);  // Day parity
-  b_bits_ |= odd_parity(a_bits_, 59 - 38, 59 - 36)
-             << (59 - 56);  // Weekday parity
-  b_bits_ |= odd_parity(a_bits_, 59 - 51, 59 - 39) << (59 - 57);  // Time parity
-  b_bits_ |= breakdown.tm_isdst << (59 - 58);
+void MSFTimeSignalSource::PrepareMinute(time_t t) {
+  EncodeSpecMinute<kMSFSpec>(t, &calendars_, symbols_);
 }
 
-TimeSignalSource::SecondModulation MSFTimeSignalSource::GetModulationForSecond(
+TimeSignalSource::ModulationSpan MSFTimeSignalSource::GetModulationSpan(
     int second) {
-  if (second == 0) return {{CarrierPower::OFF, 500}, {CarrierPower::HIGH, 0}};
-  const bool a = a_bits_ & (1LL << (59 - second));
-  const bool b = b_bits_ & (1LL << (59 - second));
-  return {{CarrierPower::OFF, 100},
-          {a ? CarrierPower::OFF : CarrierPower::HIGH, 100},
-          {b ? CarrierPower::OFF : CarrierPower::HIGH, 100},
-          {CarrierPower::HIGH, 0}};
+  return SpecModulationForSecond<kMSFSpec>(symbols_, second);
+}
+
+int MSFTimeSignalSource::GetSymbolForSecond(int second) const {
+  return SpecSymbolForSecond<kMSFSpec>(symbols_, second);
 }
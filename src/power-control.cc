@@ -0,0 +1,112 @@
+// -*- mode: c++; c-basic-offset: 2; indent-tabs-mode: nil; -*-
+// Part of txtempus, a LF time signal transmitter.
+// Copyright (C) 2018 Henner Zeller <h.zeller@acm.org>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#include "power-control.h"
+
+#include <fcntl.h>
+#include <glob.h>
+#include <unistd.h>
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+
+// Writing this value to /dev/cpu_dma_latency is the same as not having a
+// request (PM_QOS_CPU_LATENCY_DEFAULT_VALUE in the kernel).
+static constexpr int32_t kNoLatencyLimit = 2000 * 1000000;
+
+static constexpr char kPolicyGlob[] =
+    "/sys/devices/system/cpu/cpufreq/policy*/scaling_governor";
+
+LatencyQoS::~LatencyQoS() {
+  if (fd_ >= 0) close(fd_);  // Closing drops the request in any case.
+}
+
+bool LatencyQoS::Open(int max_latency_us) {
+  max_latency_us_ = max_latency_us;
+  fd_ = open("/dev/cpu_dma_latency", O_WRONLY | O_CLOEXEC);
+  if (fd_ < 0) {
+    perror("/dev/cpu_dma_latency");
+    return false;
+  }
+  // The request is active as long as the file is open; start relaxed.
+  const int32_t value = kNoLatencyLimit;
+  if (write(fd_, &value, sizeof(value)) != sizeof(value)) {
+    perror("Writing /dev/cpu_dma_latency");
+    return false;
+  }
+  return true;
+}
+
+void LatencyQoS::Hold(bool on) {
+  if (fd_ < 0 || on == holding_) return;
+  const int32_t value = on ? max_latency_us_ : kNoLatencyLimit;
+  if (write(fd_, &value, sizeof(value)) == sizeof(value)) holding_ = on;
+}
+
+static bool ReadGovernor(const char *file, std::string *governor) {
+  FILE *f = fopen(file, "r");
+  if (!f) return false;
+  char buffer[64];
+  const bool success = fgets(buffer, sizeof(buffer), f) != nullptr;
+  fclose(f);
+  if (!success) return false;
+  buffer[strcspn(buffer, "\n")] = '\0';
+  *governor = buffer;
+  return true;
+}
+
+static bool WriteGovernor(const std::string &file, const std::string &value) {
+  const int fd = open(file.c_str(), O_WRONLY | O_CLOEXEC);
+  if (fd < 0) return false;
+  const bool success =
+      write(fd, value.data(), value.size()) == (ssize_t)value.size();
+  close(fd);
+  return success;
+}
+
+GovernorPin::~GovernorPin() { Pin(false); }
+
+bool GovernorPin::Init() {
+  glob_t files;
+  if (glob(kPolicyGlob, 0, nullptr, &files) != 0) {
+    fprintf(stderr, "No cpufreq policies found\n");
+    return false;
+  }
+  for (size_t i = 0; i < files.gl_pathc; ++i) {
+    Policy policy;
+    policy.governor_file = files.gl_pathv[i];
+    if (!ReadGovernor(files.gl_pathv[i], &policy.original)) continue;
+    if (access(files.gl_pathv[i], W_OK) != 0) {
+      perror(files.gl_pathv[i]);
+      globfree(&files);
+      return false;
+    }
+    policies_.push_back(policy);
+  }
+  globfree(&files);
+  return !policies_.empty();
+}
+
+void GovernorPin::Pin(bool on) {
+  if (on == pinned_) return;
+  for (const Policy &policy : policies_) {
+    WriteGovernor(policy.governor_file, on ? "performance" : policy.original);
+  }
+  pinned_ = on;
+}
@@ -0,0 +1,155 @@
+// -*- mode: c++; c-basic-offset: 2; indent-tabs-mode: nil; -*-
+// Part of txtempus, a LF time signal transmitter.
+// Copyright (C) 2018 Henner Zeller <h.zeller@acm.org>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#include "pps-discipline.h"
+
+#include <fcntl.h>
+#include <linux/pps.h>
+#include <sys/ioctl.h>
+#include <unistd.h>
+
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+
+static constexpr int64_t kNanosPerSecond = 1000000000LL;
+
+// A sample further off the prediction than this is considered an outlier...
+static constexpr int64_t kMaxDeviationNs = 1000000;
+// ... unless there are that many in a row; then the clock was stepped.
+static constexpr int kMaxRejectedInARow = 3;
+
+// Without pulses for longer than this, we don't trust the model anymore.
+static constexpr int64_t kMaxHoldoverSeconds = 60;
+
+bool PPSModel::AddSample(const struct timespec &assert_time) {
+  // The pulse marks the true second closest to our system time.
+  int64_t second = assert_time.tv_sec;
+  int64_t offset = assert_time.tv_nsec;
+  if (offset >= kNanosPerSecond / 2) {
+    second += 1;
+    offset -= kNanosPerSecond;
+  }
+
+  if (locked()) {
+    const int64_t predicted =
+        offset_ns_ + rate_ * (second - reference_second_) * kNanosPerSecond;
+    if (llabs(offset - predicted) > kMaxDeviationNs) {
+      if (++rejected_in_a_row_ < kMaxRejectedInARow) return false;
+      count_ = 0;  // Start over.
+      next_ = 0;
+    }
+  }
+  rejected_in_a_row_ = 0;
+
+  second_[next_] = second;
+  sample_offset_ns_[next_] = offset;
+  next_ = (next_ + 1) % kMaxSamples;
+  if (count_ < kMaxSamples) ++count_;
+  reference_second_ = second;
+  Fit();
+  return true;
+}
+
+// Least squares fit of a line through the offsets, relative to the newest
+// sample to keep numbers small.
+void PPSModel::Fit() {
+  double sum_x = 0, sum_y = 0, sum_xx = 0, sum_xy = 0;
+  for (int i = 0; i < count_; ++i) {
+    const double x = second_[i] - reference_second_;
+    const double y = sample_offset_ns_[i];
+    sum_x += x;
+    sum_y += y;
+    sum_xx += x * x;
+    sum_xy += x * y;
+  }
+  const double n = count_;
+  const double denominator = n * sum_xx - sum_x * sum_x;
+  if (count_ < 2 || denominator == 0) {
+    offset_ns_ = sum_y / n;
+    rate_ = 0;
+    return;
+  }
+  const double slope = (n * sum_xy - sum_x * sum_y) / denominator;
+  offset_ns_ = (sum_y - slope * sum_x) / n;
+  rate_ = slope / kNanosPerSecond;
+}
+
+struct timespec PPSModel::ToSystemTime(const struct timespec &true_time) const {
+  if (!locked() || true_time.tv_sec - reference_second_ > kMaxHoldoverSeconds) {
+    return true_time;
+  }
+  const double elapsed_ns =
+      (true_time.tv_sec - reference_second_) * (double)kNanosPerSecond +
+      true_time.tv_nsec;
+  int64_t nanos =
+      true_time.tv_nsec + offset_ns_ + (int64_t)(rate_ * elapsed_ns);
+  struct timespec result;
+  result.tv_sec = true_time.tv_sec + nanos / kNanosPerSecond;
+  nanos %= kNanosPerSecond;
+  if (nanos < 0) {
+    nanos += kNanosPerSecond;
+    result.tv_sec -= 1;
+  }
+  result.tv_nsec = nanos;
+  return result;
+}
+
+PPSSource::~PPSSource() {
+  if (fd_ >= 0) close(fd_);
+}
+
+bool PPSSource::Open(const char *device) {
+  fd_ = open(device, O_RDWR | O_CLOEXEC);
+  if (fd_ < 0) {
+    perror(device);
+    return false;
+  }
+  int capabilities = 0;
+  if (ioctl(fd_, PPS_GETCAP, &capabilities) < 0) {
+    fprintf(stderr, "%s: not a PPS device\n", device);
+    return false;
+  }
+  if (!(capabilities & PPS_CAPTUREASSERT)) {
+    fprintf(stderr, "%s: can't capture assert events\n", device);
+    return false;
+  }
+  struct pps_kparams params = {};
+  if (ioctl(fd_, PPS_GETPARAMS, &params) == 0 &&
+      !(params.mode & PPS_CAPTUREASSERT)) {
+    params.api_version = PPS_API_VERS;
+    params.mode |= PPS_CAPTUREASSERT;
+    if (ioctl(fd_, PPS_SETPARAMS, &params) < 0) {
+      perror("Enabling PPS assert capture");
+      return false;
+    }
+  }
+  return true;
+}
+
+bool PPSSource::Update() {
+  struct pps_fdata data = {};  // Zero timeout: don't wait.
+  if (ioctl(fd_, PPS_FETCH, &data) < 0) return false;
+  if (data.info.assert_sequence == last_sequence_) return false;
+  last_sequence_ = data.info.assert_sequence;
+  struct timespec assert_time;
+  assert_time.tv_sec = data.info.assert_tu.sec;
+  assert_time.tv_nsec = data.info.assert_tu.nsec;
+  model_.AddSample(assert_time);
+  return true;
+}
@@ -15,7 +15,7 @@
 // You should have received a copy of the GNU General Public License
 // along with this program.  If not, see <https://www.gnu.org/licenses/>.
 
-#include "rpi/hardware-control-implementation.h"
+#include "rpi/rpi-control.h"
 
 #define __STDC_FORMAT_MACROS
 #include <fcntl.h>
@@ -24,6 +24,7 @@
 #include <sys/types.h>
 #include <unistd.h>
 
+#include <algorithm>
 #include <cassert>
 #include <cmath>
 #include <cstddef>
@@ -34,6 +35,7 @@
 #include <ctime>
 
 #include "carrier-power.h"
+#include "cycle-counter.h"
 #include "hardware-control.h"
 
 // -- Implementation for Raspberry Pi Series --
@@ -76,9 +78,9 @@
 #define CLK_CMGP2_CTL 32
 #define CLK_CMGP2_DIV 33
 
-/*static*/ const uint32_t GPIO::kAttenuationGPIOBit = (1 << 17);
+/*static*/ const uint32_t RpiControl::kAttenuationGPIOBit = (1 << 17);
 
-/*static*/ const uint32_t GPIO::kValidBits =
+/*static*/ const uint32_t RpiControl::kValidBits =
     ((1 << 0) | (1 << 1) |  // RPi 1 - Revision 1 accessible
      (1 << 2) | (1 << 3) |  // RPi 1 - Revision 2 accessible
      (1 << 4) | (1 << 7) | (1 << 8) | (1 << 9) | (1 << 10) | (1 << 11) |
@@ -88,7 +90,7 @@
      (1 << 5) | (1 << 6) | (1 << 12) | (1 << 13) | (1 << 16) | (1 << 19) |
      (1 << 20) | (1 << 21) | (1 << 26));
 
-uint32_t GPIO::RequestOutput(uint32_t outputs) {
+uint32_t RpiControl::RequestOutput(uint32_t outputs) {
   assert(gpio_port_);     // Call Init() first.
   outputs &= kValidBits;  // Sanitize: only bits on GPIO header allowed.
   for (uint32_t b = 0; b <= 27; ++b) {
@@ -100,7 +102,7 @@ uint32_t GPIO::RequestOutput(uint32_t outputs) {
   return outputs;
 }
 
-uint32_t GPIO::RequestInput(uint32_t inputs) {
+uint32_t RpiControl::RequestInput(uint32_t inputs) {
   assert(gpio_port_);    // Call Init() first.
   inputs &= kValidBits;  // Sanitize: only bits on GPIO header allowed.
   for (uint32_t b = 0; b <= 27; ++b) {
@@ -112,7 +114,7 @@ uint32_t GPIO::RequestInput(uint32_t inputs) {
 }
 
 // BCM2835-ARM-Peripherals.pdf, page 105 onwards.
-double GPIO::StartClock(double requested_freq) {
+double RpiControl::StartClock(double requested_freq) {
   // Figure out best clock source to get closest to the requested
   // frequency with MASH=1. We check starting from the highest frequency to
   // find lowest jitter opportunity first.
@@ -160,13 +162,21 @@ double GPIO::StartClock(double requested_freq) {
   clock_reg_[div] = CLK_PASSWD | CLK_DIV_DIVI(divI) | CLK_DIV_DIVF(divF);
   usleep(10);
 
-  clock_reg_[ctl] = CLK_PASSWD | CLK_CTL_MASH(mash) | CLK_CTL_SRC(src);
+  clock_ctl_ = CLK_CTL_MASH(mash) | CLK_CTL_SRC(src);
+  clock_reg_[ctl] = CLK_PASSWD | clock_ctl_;
   usleep(10);
 
   clock_reg_[ctl] |= CLK_PASSWD | CLK_CTL_ENAB;
 
   EnableClockOutput(true);
 
+  clock_source_frequency_ = kClockSources[best_clock_source].frequency;
+  divider_ = divI * 1024 + divF;
+  phase_degrees_ = 0;
+  keyed_on_ = true;
+  carrier_period_ns_ = 1e9 * divider_ / 1024 / clock_source_frequency_;
+  keying_latency_ns_ = carrier_period_ns_ / 2;  // Until we measured it.
+
 #if 0
   // There have been reports of different clock source frequencies. This
   // helps figuring out which source was picked.
@@ -180,7 +190,7 @@ double GPIO::StartClock(double requested_freq) {
   return kClockSources[best_clock_source].frequency / (divI + divF / 1024.0);
 }
 
-void GPIO::StopClock() {
+void RpiControl::StopClock() {
   const uint32_t ctl = CLK_CMGP0_CTL;
   clock_reg_[ctl] = CLK_PASSWD | CLK_CTL_KILL;
 
@@ -189,9 +199,82 @@ void GPIO::StopClock() {
     usleep(10);
   }
   EnableClockOutput(false);
+  divider_ = 0;
+  keyed_on_ = false;
+  shifting_ = false;
+}
+
+// Clearing ENAB lets the clock generator finish its current cycle before it
+// stops, and setting it starts with a full cycle; BUSY tells us when that
+// happened. That is at most one carrier cycle, so we busy wait.
+void RpiControl::KeyCarrier(bool on) {
+  if (divider_ == 0 || on == keyed_on_) return;
+  const uint64_t start = ReadCycleCounter();
+  const uint64_t timeout =
+      start + 4 * carrier_period_ns_ * CycleCounterFrequency() / 1000000000;
+  clock_reg_[CLK_CMGP0_CTL] =
+      CLK_PASSWD | clock_ctl_ | (on ? CLK_CTL_ENAB : 0);
+  uint64_t now;
+  do {
+    now = ReadCycleCounter();
+  } while (((clock_reg_[CLK_CMGP0_CTL] & CLK_CTL_BUSY) != 0) != on &&
+           now < timeout);
+  const int64_t took_ns = (now - start) * 1000000000 / CycleCounterFrequency();
+  keying_latency_ns_ += (took_ns - keying_latency_ns_) / 8;
+  keyed_on_ = on;
+}
+
+// Duration of a phase shift. Short enough to fit between DCF77 PN chips.
+static constexpr int kPhaseShiftMicros = 250;
+
+static uint32_t DividerRegister(int divider) {
+  return CLK_PASSWD | CLK_DIV_DIVI(divider / 1024) |
+         CLK_DIV_DIVF(divider % 1024);
+}
+
+bool RpiControl::SetCarrierPhase(double degrees) {
+  if (divider_ == 0) return false;  // Clock not started.
+  FinishPhaseShift();  // In case the caller didn't.
+  const double cycles = (degrees - phase_degrees_) / 360.0;
+  if (cycles == 0) return true;
+
+  // Advancing the phase needs a higher frequency, i.e. smaller divider.
+  // Detune just enough to accumulate the phase difference in about
+  // kPhaseShiftMicros; rounding to the divider resolution changes that a bit.
+  const double frequency = clock_source_frequency_ * 1024 / divider_;
+  const double wanted_frequency = frequency + cycles * 1e6 / kPhaseShiftMicros;
+  int step_divider = round(clock_source_frequency_ * 1024 / wanted_frequency);
+  step_divider = std::max(2 * 1024, std::min(4095 * 1024, step_divider));
+  if (step_divider == divider_) step_divider += (cycles > 0) ? -1 : 1;
+  const double step_frequency = clock_source_frequency_ * 1024 / step_divider;
+  const int64_t duration_ns = 1e9 * cycles / (step_frequency - frequency);
+
+  // Too short to sleep accurately, but waiting for it would keep the
+  // transmit loop busy for most of the time with DCF77's hundreds of chips
+  // per second: the caller ends the shift at PhaseShiftEnd().
+  clock_gettime(CLOCK_MONOTONIC, &shift_start_);
+  clock_reg_[CLK_CMGP0_DIV] = DividerRegister(step_divider);
+  clock_gettime(CLOCK_REALTIME, &shift_end_);
+  shift_end_.tv_nsec += duration_ns;
+  shift_end_.tv_sec += shift_end_.tv_nsec / 1000000000;
+  shift_end_.tv_nsec %= 1000000000;
+  shift_degrees_per_second_ = 360.0 * (step_frequency - frequency);
+  shifting_ = true;
+  return true;
 }
 
-void GPIO::EnableClockOutput(bool on) {
+void RpiControl::FinishPhaseShift() {
+  if (!shifting_) return;
+  clock_reg_[CLK_CMGP0_DIV] = DividerRegister(divider_);
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  const int64_t detuned_ns = (now.tv_sec - shift_start_.tv_sec) * 1000000000LL +
+                             (now.tv_nsec - shift_start_.tv_nsec);
+  phase_degrees_ += shift_degrees_per_second_ * detuned_ns / 1e9;
+  shifting_ = false;
+}
+
+void RpiControl::EnableClockOutput(bool on) {
   if (on) {
     ALT0_GPIO(4);  // Pinmux GPIO4 into outputting clock.
   } else {
@@ -306,7 +389,7 @@ static uint32_t *mmap_bcm_register(off_t register_offset) {
   return result;
 }
 
-bool GPIO::Init() {
+bool RpiControl::Init() {
   gpio_port_ = mmap_bcm_register(GPIO_REGISTER_OFFSET);
   if (gpio_port_ == nullptr) {
     fprintf(stderr, "Need to be root\n");
@@ -318,20 +401,3 @@ bool GPIO::Init() {
 
   return gpio_port_ != MAP_FAILED && clock_reg_ != MAP_FAILED;
 }
-
-void GPIO::SetTxPower(CarrierPower power) {
-  switch (power) {
-    case CarrierPower::OFF:
-      EnableClockOutput(false);
-      break;
-    case CarrierPower::LOW:
-      RequestOutput(kAttenuationGPIOBit);  // Pull down.
-      ClearBits(kAttenuationGPIOBit);
-      EnableClockOutput(true);
-      break;
-    case CarrierPower::HIGH:
-      RequestInput(kAttenuationGPIOBit);  // High-Z
-      EnableClockOutput(true);
-      break;
-  }
-}
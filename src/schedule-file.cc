@@ -0,0 +1,174 @@
+// -*- mode: c++; c-basic-offset: 2; indent-tabs-mode: nil; -*-
+// Part of txtempus, a LF time signal transmitter.
+// Copyright (C) 2018 Henner Zeller <h.zeller@acm.org>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+
+#include "schedule-file.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+#include "carrier-power.h"
+
+namespace {
+// A symbol is a list of changes, terminated by one with zero duration
+// whose power lasts for the rest of the second.
+bool ValidSymbol(const ScheduleSymbol &symbol) {
+  int64_t total_ns = 0;
+  for (const auto &change : symbol.changes) {
+    switch ((CarrierPower)change.power) {
+      case CarrierPower::OFF:
+      case CarrierPower::LOW:
+      case CarrierPower::HIGH:
+        break;
+      default:
+        return false;
+    }
+    if (change.duration_ns == 0) return true;
+    total_ns += change.duration_ns;
+    if (total_ns >= kNanosPerSecond) return false;
+  }
+  return false;  // No terminating change.
+}
+}  // namespace
+
+ScheduleFileSource::~ScheduleFileSource() {
+  if (map_) munmap(const_cast<uint8_t *>(map_), map_size_);
+}
+
+bool ScheduleFileSource::Open(const char *filename) {
+  const int fd = open(filename, O_RDONLY | O_CLOEXEC);
+  if (fd < 0) {
+    perror(filename);
+    return false;
+  }
+  struct stat st;
+  if (fstat(fd, &st) < 0 || (size_t)st.st_size < sizeof(ScheduleFileHeader)) {
+    fprintf(stderr, "%s: not a schedule file\n", filename);
+    close(fd);
+    return false;
+  }
+  void *map = mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if (map == MAP_FAILED) {
+    perror("mmap");
+    return false;
+  }
+  map_ = static_cast<const uint8_t *>(map);
+  map_size_ = st.st_size;
+
+  header_ = reinterpret_cast<const ScheduleFileHeader *>(map_);
+  if (memcmp(header_->magic, kScheduleMagic, sizeof(kScheduleMagic) - 1) ==
+          0 &&
+      header_->magic[7] != kScheduleMagic[7]) {
+    fprintf(stderr, "%s: old schedule file version; please regenerate\n",
+            filename);
+    return false;
+  }
+  if (memcmp(header_->magic, kScheduleMagic, sizeof(kScheduleMagic)) != 0 ||
+      header_->byte_order != kScheduleByteOrder) {
+    fprintf(stderr, "%s: not a schedule file for this machine\n", filename);
+    return false;
+  }
+  const int bits = header_->bits_per_second;
+  if (bits < 1 || bits > kScheduleMaxBitsPerSecond ||
+      !memchr(header_->station, '\0', sizeof(header_->station))) {
+    fprintf(stderr, "%s: inconsistent schedule file\n", filename);
+    return false;
+  }
+  const int symbols_per_second = 1 << bits;
+  const int seconds_per_word = 64 / bits;
+  const uint64_t symbols_size =
+      60 * symbols_per_second * sizeof(ScheduleSymbol);
+  const uint64_t frames_size =
+      (uint64_t)header_->minutes * header_->words_per_frame * sizeof(uint64_t);
+  if (header_->words_per_frame * seconds_per_word < 60 ||
+      header_->symbols_offset % 8 != 0 || header_->frames_offset % 8 != 0 ||
+      header_->symbols_offset + symbols_size > map_size_ ||
+      header_->frames_offset + frames_size > map_size_) {
+    fprintf(stderr, "%s: inconsistent schedule file\n", filename);
+    return false;
+  }
+  symbols_ =
+      reinterpret_cast<const ScheduleSymbol *>(map_ + header_->symbols_offset);
+  frames_ = reinterpret_cast<const uint64_t *>(map_ + header_->frames_offset);
+
+  // Check everything the transmit loop reads once here, so that playback
+  // can index the tables without further checks.
+  for (int i = 0; i < 60 * symbols_per_second; ++i) {
+    if (!ValidSymbol(symbols_[i])) {
+      fprintf(stderr, "%s: invalid symbol %d for second %d\n", filename,
+              i % symbols_per_second, i / symbols_per_second);
+      return false;
+    }
+  }
+  // Each second's value is a symbol index for that second; bits that don't
+  // belong to any of the 60 seconds have to be clear.
+  std::vector<uint64_t> value_mask(header_->words_per_frame);
+  for (int s = 0; s < 60; ++s) {
+    value_mask[s / seconds_per_word] |= uint64_t(symbols_per_second - 1)
+                                        << (s % seconds_per_word * bits);
+  }
+  for (uint32_t m = 0; m < header_->minutes; ++m) {
+    const uint64_t *frame = frames_ + (uint64_t)m * header_->words_per_frame;
+    for (int i = 0; i < header_->words_per_frame; ++i) {
+      if (frame[i] & ~value_mask[i]) {
+        fprintf(stderr, "%s: invalid symbol index in frame %u\n", filename,
+                m);
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+void ScheduleFileSource::PrepareMinute(time_t t) {
+  const int64_t index = (t - header_->first_minute) / 60;
+  if (t < header_->first_minute || index >= header_->minutes) {
+    frame_ = nullptr;
+    return;
+  }
+  frame_ = frames_ + index * header_->words_per_frame;
+  const int bits = header_->bits_per_second;
+  const int seconds_per_word = 64 / bits;
+  for (int second = 0; second < 60; ++second) {
+    const uint64_t word = frame_[second / seconds_per_word];
+    const int value =
+        (word >> (second % seconds_per_word * bits)) & ((1 << bits) - 1);
+    const ScheduleSymbol &symbol = symbols_[(second << bits) + value];
+    int count = 0;
+    for (const auto &change : symbol.changes) {
+      modulation_[second][count++] = {(CarrierPower)change.power,
+                                      (int32_t)change.duration_ns};
+      if (change.duration_ns == 0) break;
+    }
+    changes_[second] = count;
+  }
+}
+
+TimeSignalSource::ModulationSpan ScheduleFileSource::GetModulationSpan(
+    int second) {
+  static constexpr ModulationDuration kCarrierOnly = {CarrierPower::HIGH, 0};
+  if (!frame_ || second >= 60) return {&kCarrierOnly, &kCarrierOnly + 1};
+  return {modulation_[second], modulation_[second] + changes_[second]};
+}
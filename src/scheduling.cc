@@ -0,0 +1,62 @@
+// -*- mode: c++; c-basic-offset: 2; indent-tabs-mode: nil; -*-
+// Part of txtempus, a LF time signal transmitter.
+// Copyright (C) 2018 Henner Zeller <h.zeller@acm.org>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#include "scheduling.h"
+
+#include <sched.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <cstdint>
+
+#ifndef SCHED_DEADLINE
+#define SCHED_DEADLINE 6
+#endif
+
+// Not provided by older glibc and <linux/sched/types.h> clashes with
+// <sched.h>, so here is our own copy of the kernel ABI.
+struct SchedAttr {
+  uint32_t size;
+  uint32_t sched_policy;
+  uint64_t sched_flags;
+  int32_t sched_nice;
+  uint32_t sched_priority;
+  uint64_t sched_runtime;
+  uint64_t sched_deadline;
+  uint64_t sched_period;
+};
+
+bool SetFifoScheduling(int priority) {
+  struct sched_param sp = {};
+  sp.sched_priority = priority;
+  return sched_setscheduler(0, SCHED_FIFO, &sp) == 0;
+}
+
+bool SetDeadlineScheduling(int64_t runtime_ns, int64_t deadline_ns,
+                           int64_t period_ns) {
+#ifdef SYS_sched_setattr
+  struct SchedAttr attr = {};
+  attr.size = sizeof(attr);
+  attr.sched_policy = SCHED_DEADLINE;
+  attr.sched_runtime = runtime_ns;
+  attr.sched_deadline = deadline_ns;
+  attr.sched_period = period_ns;
+  return syscall(SYS_sched_setattr, 0, &attr, 0) == 0;
+#else
+  return false;
+#endif
+}
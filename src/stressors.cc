@@ -0,0 +1,115 @@
+// -*- mode: c++; c-basic-offset: 2; indent-tabs-mode: nil; -*-
+// Part of txtempus, a LF time signal transmitter.
+// Copyright (C) 2018 Henner Zeller <h.zeller@acm.org>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#include "stressors.h"
+
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+// Large enough to not fit in the caches of typical boards.
+static constexpr size_t kMemoryBufferSize = 16 << 20;
+
+static constexpr size_t kIOChunkSize = 1 << 20;
+static constexpr int kIOChunksPerFile = 64;
+
+Stressors::~Stressors() { Stop(); }
+
+bool Stressors::Start(const char *spec) {
+  const int cpus = std::max(1u, std::thread::hardware_concurrency());
+  std::vector<std::string> names;
+  for (const char *pos = spec; *pos; /**/) {
+    const size_t len = strcspn(pos, ",");
+    names.emplace_back(pos, len);
+    pos += len;
+    if (*pos == ',') ++pos;
+  }
+  for (const std::string &name : names) {
+    if (name != "cpu" && name != "mem" && name != "io") {
+      fprintf(stderr, "Unknown stressor '%s'\n", name.c_str());
+      return false;
+    }
+  }
+
+  running_ = true;
+  for (const std::string &name : names) {
+    if (name == "cpu") {
+      for (int i = 0; i < cpus; ++i) {
+        threads_.emplace_back(&Stressors::CpuLoad, this);
+      }
+    } else if (name == "mem") {
+      for (int i = 0; i < cpus; ++i) {
+        threads_.emplace_back(&Stressors::MemoryLoad, this);
+      }
+    } else if (name == "io") {
+      char filename[] = "/tmp/txtempus-stress-XXXXXX";
+      const int fd = mkstemp(filename);
+      if (fd < 0) {
+        perror("Creating io stressor file");
+        Stop();
+        return false;
+      }
+      unlink(filename);
+      threads_.emplace_back(&Stressors::IOLoad, this, fd);
+    }
+  }
+  return true;
+}
+
+void Stressors::Stop() {
+  running_ = false;
+  for (std::thread &t : threads_) t.join();
+  threads_.clear();
+}
+
+void Stressors::CpuLoad() {
+  volatile uint64_t x = 1;
+  while (running_.load(std::memory_order_relaxed)) {
+    for (int i = 0; i < 100000; ++i) x = x * 6364136223846793005ULL + 1;
+  }
+}
+
+void Stressors::MemoryLoad() {
+  std::vector<char> a(kMemoryBufferSize, 1);
+  std::vector<char> b(kMemoryBufferSize, 2);
+  while (running_.load(std::memory_order_relaxed)) {
+    memcpy(a.data(), b.data(), kMemoryBufferSize);
+    std::swap(a, b);
+  }
+}
+
+void Stressors::IOLoad(int fd) {
+  std::vector<char> chunk(kIOChunkSize, 'x');
+  int chunks = 0;
+  while (running_.load(std::memory_order_relaxed)) {
+    if (write(fd, chunk.data(), chunk.size()) < 0) break;
+    fdatasync(fd);
+    if (++chunks == kIOChunksPerFile) {
+      lseek(fd, 0, SEEK_SET);
+      chunks = 0;
+    }
+  }
+  close(fd);
+}
@@ -27,8 +27,9 @@
 #include <iostream>
 
 #include "carrier-power.h"
+#include "cycle-counter.h"
 #include "hardware-control.h"
-#include "sunxih3/hardware-control-implementation.h"
+#include "sunxih3/sunxih3-control.h"
 
 static constexpr bool kDebug = false;
 
@@ -72,7 +73,7 @@ static constexpr bool kDebug = false;
 // PWM Control register default value - OFF
 #define PWM_DEFAULT_OFF 0x0
 
-bool H3BOARD::Init() {
+bool SunxiH3Control::Init() {
   // PWM presacaling values
   PwmCh0Prescale = {{120, 0b0000},   {180, 0b0001},   {360, 0b0011},
                     {480, 0b0100},   {12000, 0b1000}, {24000, 0b1001},
@@ -93,7 +94,7 @@ bool H3BOARD::Init() {
 }
 
 // Disable pullups on PA6 and enable it os PA5
-void H3BOARD::ConfigurePins() {
+void SunxiH3Control::ConfigurePins() {
   uint32_t mask, value;
   assert(registers);  // Call Init() first.
 
@@ -114,7 +115,7 @@ void H3BOARD::ConfigurePins() {
 }
 
 // Set the pin as output - LoZ state - PA6 pulls down if set to zero
-void H3BOARD::SetOutput(gpio_pin pin) {
+void SunxiH3Control::SetOutput(gpio_pin pin) {
   uint32_t shift, mask, value;
   assert(registers);  // Call Init() first.
 
@@ -129,7 +130,7 @@ void H3BOARD::SetOutput(gpio_pin pin) {
 }
 
 // Set the pin as Input - HiZ state
-void H3BOARD::SetInput(gpio_pin pin) {
+void SunxiH3Control::SetInput(gpio_pin pin) {
   uint32_t shift, mask, value;
   assert(registers);  // Call Init() first.
 
@@ -140,7 +141,7 @@ void H3BOARD::SetInput(gpio_pin pin) {
   registers[PA_CFG0_REG] = (registers[PA_CFG0_REG] & ~mask) | value;
 }
 
-void H3BOARD::EnableClockOutput(bool enable) {
+void SunxiH3Control::EnableClockOutput(bool enable) {
   uint32_t mask;
   assert(registers);  // Call Init() first.
 
@@ -152,7 +153,7 @@ void H3BOARD::EnableClockOutput(bool enable) {
   }
 }
 
-H3BOARD::pwm_params H3BOARD::CalculatePWMParams(double requested_freq) {
+SunxiH3Control::pwm_params SunxiH3Control::CalculatePWMParams(double requested_freq) {
   pwm_params params;
   params.prescale = -1;
   unsigned error = 1e9;
@@ -177,7 +178,7 @@ H3BOARD::pwm_params H3BOARD::CalculatePWMParams(double requested_freq) {
 }
 
 // Setup the PWM
-double H3BOARD::StartClock(double requested_freq) {
+double SunxiH3Control::StartClock(double requested_freq) {
   pwm_params params;
   uint32_t pwm_control, pwm_period;
 
@@ -206,10 +207,15 @@ double H3BOARD::StartClock(double requested_freq) {
   EnableClockOutput(true);
   if (kDebug) std::cerr << "Output enabled\n";
 
+  period_ = params.period;
+  keyed_on_ = true;
+  carrier_period_ns_ = 1e9 / params.frequency;
+  keying_latency_ns_ = carrier_period_ns_ / 2;  // Until we measured it.
+
   return params.frequency;
 }
 
-void H3BOARD::StopClock() {
+void SunxiH3Control::StopClock() {
   uint32_t pwm_control_mask;
 
   pwm_control_mask = 0b1 << PWM_CH0_EN;
@@ -220,10 +226,12 @@ void H3BOARD::StopClock() {
   pwm_control_mask = 0b1 << SCLK_CH0_GATING;
   registers[PWM_CTRL_REG] &= ~pwm_control_mask;
 
+  period_ = 0;
+  keyed_on_ = false;
   if (kDebug) std::cerr << "Clock stopped\n";
 }
 
-uint32_t *H3BOARD::map_register(off_t register_offset) {
+uint32_t *SunxiH3Control::map_register(off_t register_offset) {
   int mem_fd;
   if (mem_fd = open("/dev/mem", O_RDWR | O_SYNC); mem_fd < 0) {
     perror("can't open /dev/mem: ");
@@ -248,24 +256,34 @@ uint32_t *H3BOARD::map_register(off_t register_offset) {
   return result;
 }
 
-void H3BOARD::SetTxPower(CarrierPower power) {
-  switch (power) {
-    case CarrierPower::OFF:
-      EnableClockOutput(false);
-      break;
-    case CarrierPower::LOW:
-      SetOutput(PA6);
-      EnableClockOutput(true);
-      break;
-    case CarrierPower::HIGH:
-      SetInput(PA6);  // High-Z
-      EnableClockOutput(true);
-      break;
-  }
-}
-
 // Wait until PWM register is not busy
-void H3BOARD::WaitPwmPeriodReady() {
+void SunxiH3Control::WaitPwmPeriodReady() {
   if (kDebug) std::cerr << "Waiting for PWM period register availability\n";
   while (registers[PWM_CTRL_REG] & (0b1 << PWM0_RDY)) usleep(10);
 }
+
+// Busy wait here: PWM0_RDY clears at the end of the current period, which is
+// what the caller needs to know to compensate for. While it is still set
+// from a previous write, the period register ignores writes, so it has to
+// be clear before we write as well.
+void SunxiH3Control::KeyCarrier(bool on) {
+  if (period_ == 0 || on == keyed_on_) return;
+  const uint64_t start = ReadCycleCounter();
+  const uint64_t max_wait =
+      4 * carrier_period_ns_ * CycleCounterFrequency() / 1000000000;
+  uint64_t now = start;
+  while ((registers[PWM_CTRL_REG] & (0b1 << PWM0_RDY)) &&
+         now < start + max_wait) {
+    now = ReadCycleCounter();
+  }
+  const uint64_t timeout = now + max_wait;
+  const int active_cycles = on ? period_ / 2 : 0;
+  registers[PWM_CH0_PERIOD] = period_ << PWM_CH0_ENTIRE_CYS |
+                              active_cycles << PWM_CH0_ENTIRE_ACT_CYS;
+  do {
+    now = ReadCycleCounter();
+  } while ((registers[PWM_CTRL_REG] & (0b1 << PWM0_RDY)) && now < timeout);
+  const int64_t took_ns = (now - start) * 1000000000 / CycleCounterFrequency();
+  keying_latency_ns_ += (took_ns - keying_latency_ns_) / 8;
+  keyed_on_ = on;
+}
@@ -0,0 +1,54 @@
+// -*- mode: c++; c-basic-offset: 2; indent-tabs-mode: nil; -*-
+// Part of txtempus, a LF time signal transmitter.
+// Copyright (C) 2018 Henner Zeller <h.zeller@acm.org>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+
+#include "time-signal-source.h"
+
+#include <strings.h>
+
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+
+int32_t DurationOutsideSecond(int64_t ns) {
+  fprintf(stderr, "Modulation time %lldns is not within a second\n",
+          (long long)ns);
+  abort();
+}
+
+std::unique_ptr<TimeSignalSource> CreateTimeSignalSource(const char *name) {
+  if (strcasecmp(name, "DCF77") == 0) {
+    return std::make_unique<DCF77TimeSignalSource>();
+  }
+  if (strcasecmp(name, "WWVB") == 0) {
+    return std::make_unique<WWVBTimeSignalSource>();
+  }
+  if (strcasecmp(name, "JJY40") == 0) {
+    return std::make_unique<JJY40TimeSignalSource>();
+  }
+  if (strcasecmp(name, "JJY60") == 0) {
+    return std::make_unique<JJY60TimeSignalSource>();
+  }
+  if (strcasecmp(name, "MSF") == 0) {
+    return std::make_unique<MSFTimeSignalSource>();
+  }
+  if (strcasecmp(name, "BPC") == 0) {
+    return std::make_unique<BPCTimeSignalSource>();
+  }
+  return nullptr;
+}
@@ -0,0 +1,90 @@
+// -*- mode: c++; c-basic-offset: 2; indent-tabs-mode: nil; -*-
+// Part of txtempus, a LF time signal transmitter.
+// Copyright (C) 2018 Henner Zeller <h.zeller@acm.org>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#include "trace-points.h"
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <cstdint>
+#include <ctime>
+
+int trace_marker_fd = -1;
+
+bool OpenTraceMarker() {
+  static const char *const kLocations[] = {
+      "/sys/kernel/tracing/trace_marker",
+      "/sys/kernel/debug/tracing/trace_marker",
+  };
+  for (const char *location : kLocations) {
+    trace_marker_fd = open(location, O_WRONLY | O_CLOEXEC);
+    if (trace_marker_fd >= 0) return true;
+  }
+  return false;
+}
+
+// We are called from the realtime loop, so avoid the generality of printf()
+// and just assemble the records from strings and numbers.
+static char *AppendString(char *out, const char *str) {
+  while (*str) *out++ = *str++;
+  return out;
+}
+
+static char *AppendNumber(char *out, int64_t value, int min_digits = 1) {
+  if (value < 0) {
+    *out++ = '-';
+    value = -value;
+  }
+  char digits[20];
+  int count = 0;
+  do {
+    digits[count++] = '0' + value % 10;
+    value /= 10;
+  } while (value || count < min_digits);
+  while (count) *out++ = digits[--count];
+  return out;
+}
+
+static void WriteRecord(const char *buffer, const char *end) {
+  // Nothing sensible to do if that fails.
+  if (write(trace_marker_fd, buffer, end - buffer) < 0) return;
+}
+
+void WriteTraceMinute(time_t transmit_time) {
+  char buffer[64];
+  char *pos = AppendString(buffer, "txtempus minute ");
+  pos = AppendNumber(pos, transmit_time);
+  WriteRecord(buffer, pos);
+}
+
+void WriteTraceEdge(int power) {
+  char buffer[64];
+  char *pos = AppendString(buffer, "txtempus edge ");
+  pos = AppendNumber(pos, power);
+  WriteRecord(buffer, pos);
+}
+
+void WriteTraceWakeup(const struct timespec &target, int64_t late_ns) {
+  char buffer[96];
+  char *pos = AppendString(buffer, "txtempus wakeup ");
+  pos = AppendNumber(pos, target.tv_sec);
+  *pos++ = '.';
+  pos = AppendNumber(pos, target.tv_nsec, 9);
+  pos = AppendString(pos, " late=");
+  pos = AppendNumber(pos, late_ns);
+  WriteRecord(buffer, pos);
+}
@@ -0,0 +1,74 @@
+// -*- mode: c++; c-basic-offset: 2; indent-tabs-mode: nil; -*-
+// Part of txtempus, a LF time signal transmitter.
+// Copyright (C) 2018 Henner Zeller <h.zeller@acm.org>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#include "transmit-schedule.h"
+
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+
+static constexpr int kMinutesPerDay = 24 * 60;
+
+bool TransmitSchedule::AddWindows(const char *spec) {
+  while (*spec) {
+    int start_h, start_m, end_h, end_m, consumed = 0;
+    if (sscanf(spec, "%d:%d-%d:%d%n", &start_h, &start_m, &end_h, &end_m,
+               &consumed) != 4) {
+      return false;
+    }
+    if (start_h < 0 || start_h > 24 || start_m < 0 || start_m > 59 ||
+        end_h < 0 || end_h > 24 || end_m < 0 || end_m > 59) {
+      return false;
+    }
+    windows_.push_back({(start_h * 60 + start_m) % kMinutesPerDay,
+                        (end_h * 60 + end_m) % kMinutesPerDay});
+    spec += consumed;
+    if (*spec == ',') {
+      ++spec;
+    } else if (*spec) {
+      return false;
+    }
+  }
+  return true;
+}
+
+bool TransmitSchedule::IsActive(time_t t) const {
+  if (windows_.empty()) return true;
+  struct tm tm;
+  localtime_r(&t, &tm);
+  const int minute = tm.tm_hour * 60 + tm.tm_min;
+  for (const Window &w : windows_) {
+    if (w.start_minute == w.end_minute) return true;  // All day.
+    if (w.start_minute < w.end_minute) {
+      if (minute >= w.start_minute && minute < w.end_minute) return true;
+    } else {  // Wrapping around midnight.
+      if (minute >= w.start_minute || minute < w.end_minute) return true;
+    }
+  }
+  return false;
+}
+
+time_t TransmitSchedule::NextActiveMinute(time_t t) const {
+  t -= t % 60;
+  // Simply stepping through the minutes is cheap enough for something we do
+  // once per window and is not confused by daylight saving time switches.
+  // Two days are enough to cover a 25-hour day.
+  for (int i = 0; i < 2 * kMinutesPerDay; ++i, t += 60) {
+    if (IsActive(t)) return t;
+  }
+  return -1;
+}
@@ -0,0 +1,694 @@
+// -*- mode: c++; c-basic-offset: 2; indent-tabs-mode: nil; -*-
+// Part of txtempus, a LF time signal transmitter.
+// Copyright (C) 2018 Henner Zeller <h.zeller@acm.org>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+
+#include "transmitter.h"
+
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <csignal>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <iterator>
+#include <vector>
+
+#include "clock-quality.h"
+#include "edge-schedule.h"
+#include "flight-recorder.h"
+#include "hardware-backends.h"
+#include "latency-stats.h"
+#include "power-control.h"
+#include "pps-discipline.h"
+#include "schedule-file.h"
+#include "scheduling.h"
+#include "trace-points.h"
+
+// When waking up for a transmit window, start the carrier this many seconds
+// before the first minute so that everything is settled.
+static constexpr int kWarmupSeconds = 5;
+
+// With a latency QoS limit, it is held from this long before an edge on.
+static constexpr int64_t kLatencyQoSLeadMicros = 2000;
+
+// Truncate "t" so that it is multiple of "d"
+static time_t TruncateTo(time_t t, int d) { return t - t % d; }
+
+static struct timespec AddNanos(struct timespec ts, int64_t ns) {
+  ns += ts.tv_nsec;
+  ts.tv_sec += ns / 1000000000;
+  ts.tv_nsec = ns % 1000000000;
+  if (ts.tv_nsec < 0) {
+    ts.tv_nsec += 1000000000;
+    ts.tv_sec -= 1;
+  }
+  return ts;
+}
+
+Transmitter::Transmitter(const Options &options, HardwareControl *hardware,
+                         std::unique_ptr<TimeSignalSource> source,
+                         const char *station)
+    : options_(options),
+      hardware_(hardware),
+      time_source_(std::move(source)),
+      time_offset_s_(options.time_offset_s + options.offset_minutes * 60),
+      carrier_only_(options.carrier_only),
+      phase_modulation_(options.phase_modulation) {
+  snprintf(status_.station, sizeof(status_.station), "%s", station);
+  status_.carrier_hz = time_source_->GetCarrierFrequencyHz();
+  status_.carrier_only = carrier_only_;
+  status_.offset_minutes = options.offset_minutes;
+}
+
+bool Transmitter::Init() {
+  if (!event_loop_.Init({SIGTERM, SIGINT})) return false;
+  event_loop_.OnSignal([this](int signo) {
+    // Don't wait for the end of the current sleep, stop right away.
+    interrupted_ = signo;
+    if (carrier_running_) StopCarrier(hardware_);
+    carrier_running_ = false;
+    event_loop_.Stop();
+  });
+  event_loop_.OnClockChange([this]() {
+    if (options_.verbose) {
+      log_ring_.Printf("\nClock was set. Resynchronizing.\n");
+    }
+    clock_changed_ = true;
+  });
+  // A dry run isn't paced by the clock and would overrun the ring.
+  if (options_.dryrun) {
+    log_ring_.StartDirect(STDERR_FILENO);
+  } else {
+    log_ring_.Start(STDERR_FILENO);
+  }
+  return true;
+}
+
+// Wait until the given time. Returns 'false' if we got interrupted.
+bool Transmitter::WaitUntil(const struct timespec &ts) {
+  if (options_.dryrun) return event_loop_.DispatchPending();
+  return event_loop_.WaitUntil(ts);
+}
+
+// System clock deadline for an edge at the given true time.
+struct timespec Transmitter::EdgeDeadline(
+    const struct timespec &edge_time) const {
+  if (options_.pps) return options_.pps->model().ToSystemTime(edge_time);
+  return AddNanos(edge_time, leader_offset_ns_);
+}
+
+// Keep the PPS model up to date; called once per second.
+void Transmitter::UpdatePPS() {
+  if (!options_.pps) return;
+  const bool was_locked = options_.pps->model().locked();
+  options_.pps->Update();
+  const PPSModel &model = options_.pps->model();
+  if (options_.verbose && model.locked() != was_locked) {
+    if (model.locked()) {
+      log_ring_.Printf("\nPPS locked: offset %+.3fms, rate %+.3fppm\n",
+                       model.offset_ns() / 1e6, model.rate_ppm());
+    } else {
+      log_ring_.Printf("\nPPS lost lock\n");
+    }
+  }
+}
+
+// Wait until the given edge and keep track of how late we got there.
+// Returns the lateness in nanoseconds.
+// With a latency QoS limit, the CPU may only go into deep idle states while
+// the edge is still far away.
+int64_t Transmitter::WaitForEdge(const struct timespec &ts) {
+  status_.next_edge = ts;
+  if (options_.control) options_.control->PublishStatus(status_);
+  if (options_.latency_qos && !options_.dryrun) {
+    const struct timespec lead = AddNanos(ts, -kLatencyQoSLeadMicros * 1000);
+    struct timespec now;
+    clock_gettime(CLOCK_REALTIME, &now);
+    if (now.tv_sec < lead.tv_sec ||
+        (now.tv_sec == lead.tv_sec && now.tv_nsec < lead.tv_nsec)) {
+      options_.latency_qos->Hold(false);
+      if (!WaitUntil(lead)) return 0;
+    }
+    options_.latency_qos->Hold(true);
+  }
+  // Catching up with edges already in the past (e.g. in the first minute)
+  // doesn't tell anything about wakeup latency.
+  bool already_due = false;
+  if (options_.wakeup_stats) {
+    struct timespec now;
+    clock_gettime(CLOCK_REALTIME, &now);
+    already_due = now.tv_sec > ts.tv_sec ||
+                  (now.tv_sec == ts.tv_sec && now.tv_nsec >= ts.tv_nsec);
+  }
+  if (!WaitUntil(ts) || options_.dryrun) return 0;
+  struct timespec now;
+  clock_gettime(CLOCK_REALTIME, &now);
+  const int64_t late_ns = (now.tv_sec - ts.tv_sec) * 1000000000LL +
+                          (now.tv_nsec - ts.tv_nsec);
+  TraceWakeup(ts, late_ns);
+  if (options_.wakeup_stats && !already_due) {
+    options_.wakeup_stats->Add(late_ns);
+  }
+  const int64_t late_us = late_ns / 1000;
+  status_.edges++;
+  if (late_us > kLateEdgeMicros) status_.late_edges++;
+  if (late_us > status_.max_lateness_us) status_.max_lateness_us = late_us;
+  return late_ns;
+}
+
+// Check if the system clock is good enough to be sent; if not, only the
+// carrier is transmitted. Changes are logged. Returns 'true' if good.
+bool Transmitter::CheckClockQuality() {
+  ClockQuality quality;
+  if (!ReadClockQuality(&quality)) return true;  // Can't tell; trust it.
+  const bool good = quality.synchronized &&
+                    quality.max_error_us <= options_.max_clock_error_us;
+  status_.clock_max_error_us = quality.max_error_us;
+  if (good != status_.clock_good) {
+    if (good) {
+      log_ring_.Printf("\nClock synchronized (max error %.1fms), sending "
+                       "time\n",
+                       quality.max_error_us / 1000.0);
+    } else if (!quality.synchronized) {
+      log_ring_.Printf("\nClock not synchronized, sending carrier only\n");
+    } else {
+      log_ring_.Printf("\nClock max error %.1fms too large, sending carrier "
+                       "only\n",
+                       quality.max_error_us / 1000.0);
+    }
+  }
+  status_.clock_good = good;
+  return good;
+}
+
+// Count a missed edge, overall and for the station currently transmitted.
+void Transmitter::CountMiss() {
+  status_.missed_edges++;
+  int i = 0;
+  while (i < status_.stations &&
+         strcmp(status_.missed_by_station[i].station, status_.station) != 0) {
+    ++i;
+  }
+  if (i == status_.stations) {
+    if (i == ControlSocket::Status::kMaxStations) return;
+    memcpy(status_.missed_by_station[i].station, status_.station,
+           sizeof(status_.station));
+    status_.stations++;
+  }
+  status_.missed_by_station[i].missed++;
+}
+
+// Shortest time between two consecutive modulation edges of the time source
+// within a minute, i.e. how often the transmit loop has to wake up at most.
+// With phase modulation, the phase changes count as edges as well.
+int Transmitter::ShortestEdgeIntervalUs(time_t minute) {
+  std::vector<ModulationEdge> edges;
+  AppendMinuteEdges(time_source_.get(), minute, phase_modulation_, &edges);
+  edges.push_back({60 * 1000000000LL, ModulationEdge::Type::POWER,
+                   CarrierPower::HIGH, 0});
+  int64_t shortest = 1000000000;
+  int64_t previous = 0;
+  for (const ModulationEdge &edge : edges) {
+    if (edge.offset_ns > previous) {
+      shortest = std::min(shortest, edge.offset_ns - previous);
+    }
+    previous = edge.offset_ns;
+  }
+  return shortest / 1000;
+}
+
+// Choose scheduling for the transmit loop. With a SCHED_DEADLINE runtime
+// budget given, we ask for one activation per edge, to be done before it
+// would count as late; if that is not possible, we fall back to SCHED_FIFO.
+// Returns a description of what we got.
+const char *Transmitter::SetupScheduling(time_t minute) {
+  if (options_.deadline_runtime_us > 0) {
+    const int64_t period_ns = ShortestEdgeIntervalUs(minute) * 1000LL;
+    const int64_t deadline_ns = std::min(period_ns, kLateEdgeMicros * 1000);
+    const int64_t runtime_ns = std::min<int64_t>(
+        deadline_ns, options_.deadline_runtime_us * 1000LL);
+    if (SetDeadlineScheduling(runtime_ns, deadline_ns, period_ns)) {
+      if (options_.verbose) {
+        log_ring_.Printf(
+            "SCHED_DEADLINE runtime=%lldus deadline=%lldus period=%lldus\n",
+            (long long)runtime_ns / 1000, (long long)deadline_ns / 1000,
+            (long long)period_ns / 1000);
+      }
+      return "SCHED_DEADLINE";
+    }
+    log_ring_.Printf("SCHED_DEADLINE not possible (%s); using SCHED_FIFO\n",
+                     strerror(errno));
+  }
+  // Make sure the kernel knows that we're serious about accuracy of sleeps.
+  if (SetFifoScheduling(99)) return "SCHED_FIFO 99";
+  return "SCHED_OTHER (no permission for realtime scheduling)";
+}
+
+void Transmitter::StartCarrier(HardwareControl *hw, int frequency) {
+  if (options_.dryrun || options_.benchmark) return;
+  double f = hw->StartClock(frequency);
+  if (options_.verbose) {
+    log_ring_.Printf("Requesting %d Hz, getting %.3f Hz carrier\n", frequency,
+                     f);
+    if (hw->KeyingLatencyNs() > 0) {
+      log_ring_.Printf("Keying at carrier cycle end, ~%lldns early\n",
+                       (long long)hw->KeyingLatencyNs());
+    }
+  }
+}
+
+void Transmitter::StopCarrier(HardwareControl *hw) {
+  if (options_.dryrun || options_.benchmark) return;
+  hw->StopClock();
+}
+
+template <class Hardware>
+void Transmitter::SetTxPower(Hardware *hw, CarrierPower power) {
+  if (options_.dryrun || options_.benchmark) return;
+  if (carrier_only_) power = CarrierPower::HIGH;
+  TraceEdgeIssue((int)power);
+  hw->SetTxPower(power);
+  tx_power_ = power;
+}
+
+// How much earlier to call SetTxPower() for the given power so that the
+// carrier, which is keyed on or off at the end of a cycle, switches on time.
+template <class Hardware>
+int64_t Transmitter::KeyingLeadNs(const Hardware *hw,
+                                  CarrierPower power) const {
+  if (options_.dryrun || options_.benchmark || carrier_only_) return 0;
+  if ((power == CarrierPower::OFF) == (tx_power_ == CarrierPower::OFF)) {
+    return 0;  // Only the attenuation changes, which is immediate.
+  }
+  return hw->KeyingLatencyNs();
+}
+
+template <class Hardware>
+void Transmitter::SetCarrierPhase(Hardware *hw, double degrees) {
+  if (options_.dryrun || options_.benchmark) return;
+  hw->SetCarrierPhase(degrees);
+}
+
+// End a running phase shift on time if that is before the given deadline,
+// otherwise right away.
+template <class Hardware>
+void Transmitter::FinishPhaseShiftBefore(Hardware *hw,
+                                         const struct timespec &deadline) {
+  struct timespec end;
+  if (!hw->PhaseShiftEnd(&end)) return;
+  if (end.tv_sec < deadline.tv_sec ||
+      (end.tv_sec == deadline.tv_sec && end.tv_nsec < deadline.tv_nsec)) {
+    WaitUntil(end);
+  }
+  hw->FinishPhaseShift();
+}
+
+void Transmitter::PrintLocalTime(time_t t) {
+  char buf[32];
+  struct tm tm;
+  localtime_r(&t, &tm);
+  strftime(buf, sizeof(buf), "%Y-%m-%d %H:%M:%S", &tm);
+  log_ring_.Printf("%s", buf);
+}
+
+// Show a full modulation of one second as little ASCII-art.
+void Transmitter::PrintModulationChart(
+    TimeSignalSource::ModulationSpan mod) {
+  static const int kMsPerDash = 100;
+  char chart[1000 / kMsPerDash + 1];
+  int pos = 0;
+  int running_ms = 0;
+  int target_ms = 0;
+  bool power = false;
+  for (const ModulationDuration &m : mod) {
+    power = (m.power == CarrierPower::HIGH);
+    target_ms += m.duration_ns / 1000000;
+    for (/**/; running_ms < target_ms; running_ms += kMsPerDash) {
+      chart[pos++] = power ? '#' : '_';
+    }
+  }
+  for (/**/; running_ms < 1000; running_ms += kMsPerDash) {
+    chart[pos++] = power ? '#' : '_';
+  }
+  chart[pos] = '\0';
+  log_ring_.Printf(" [%s]\n", chart);
+}
+
+// Phase modulation can have hundreds of changes per second, so just
+// summarize them.
+void Transmitter::PrintPhaseSummary(TimeSignalSource::PhaseSpan phase) {
+  if (phase.empty()) return;
+  double min_phase = 0, max_phase = 0;
+  for (const PhaseChange &p : phase) {
+    min_phase = std::min(min_phase, p.phase_degrees);
+    max_phase = std::max(max_phase, p.phase_degrees);
+  }
+  log_ring_.Printf(
+      "       phase: %zu change%s %.3f..%.3fms, %+.1f..%+.1f deg\n",
+      phase.size(), phase.size() == 1 ? " " : "s",
+      phase.front().offset_ns / 1e6, phase.back().offset_ns / 1e6,
+      min_phase, max_phase);
+}
+
+// One minute after the other until "minutes" are done or we get stopped.
+template <class Hardware>
+void Transmitter::TransmitLoop(Hardware *hw) {
+  Cluster *const cluster = options_.cluster;
+  ControlSocket *const control = options_.control;
+  FlightRecorder *const recorder = options_.recorder;
+  GovernorPin *const governor = options_.governor;
+  int ttl = options_.minutes;
+
+  struct timespec target_wait;
+  struct timespec edge_time;  // True time of the edge; see EdgeDeadline().
+
+  // Seconds of the current minute that are already over when we start are
+  // not sent; we'd only be late for all their edges.
+  int first_second = 0;
+  if (!options_.dryrun) {
+    first_second = std::min<int>(time(nullptr) - options_.start_minute + 1, 60);
+  }
+  for (time_t minute_start = options_.start_minute; !interrupted_ && ttl;
+       minute_start += 60) {
+    if (first_second >= 60) {
+      // Started in the last second of the minute; nothing left to send.
+      first_second = 0;
+      continue;
+    }
+    if (!options_.schedule.IsActive(minute_start)) {
+      // Between transmit windows, keep the carrier off and just sleep until
+      // shortly before the next window to be warmed up at its first minute.
+      if (carrier_running_) StopCarrier(hw);
+      carrier_running_ = false;
+      if (options_.latency_qos) options_.latency_qos->Hold(false);
+      if (governor) governor->Pin(false);
+      minute_start = options_.schedule.NextActiveMinute(minute_start);
+      if (minute_start < 0) break;
+      first_second = 0;
+      if (options_.verbose) {
+        log_ring_.Printf("Idle until ");
+        PrintLocalTime(minute_start);
+        log_ring_.Printf("\n");
+      }
+      target_wait.tv_sec = minute_start - kWarmupSeconds;
+      target_wait.tv_nsec = 0;
+      WaitUntil(target_wait);
+      if (interrupted_) break;
+    }
+
+    // Changes requested via the control socket are applied at the minute
+    // boundary. Only reprogram the clock if we actually need a new frequency.
+    ControlSocket::Changes changes;
+    if (control && control->TakeChanges(&changes)) {
+      if (changes.time_source) {
+        const int old_frequency = time_source_->GetCarrierFrequencyHz();
+        time_source_.swap(changes.time_source);
+        control->RetireSource(std::move(changes.time_source));
+        memcpy(status_.station, changes.station, sizeof(status_.station));
+        status_.carrier_hz = time_source_->GetCarrierFrequencyHz();
+        if (carrier_running_ && status_.carrier_hz != old_frequency) {
+          StartCarrier(hw, status_.carrier_hz);
+        }
+        if (options_.deadline_runtime_us > 0) {  // Edge pattern changed?
+          scheduling_ = SetupScheduling(minute_start + time_offset_s_);
+        }
+      }
+      if (changes.change_offset) {
+        time_offset_s_ = options_.time_offset_s + changes.offset_minutes * 60;
+        status_.offset_minutes = changes.offset_minutes;
+      }
+      if (changes.change_carrier_only) {
+        carrier_only_ = changes.carrier_only;
+        status_.carrier_only = carrier_only_;
+      }
+    }
+
+    if (!carrier_running_) {
+      if (governor) governor->Pin(true);
+      StartCarrier(hw, time_source_->GetCarrierFrequencyHz());
+      SetTxPower(hw, CarrierPower::HIGH);
+      carrier_running_ = true;
+      if (phase_modulation_ && !options_.dryrun && !options_.benchmark &&
+          !hw->SetCarrierPhase(0)) {
+        log_ring_.Printf("Phase modulation not supported on this platform\n");
+        phase_modulation_ = false;
+      }
+    }
+
+    // In a group, the leader publishes the next minute ahead of time. The
+    // followers send that instead of their own encoding, on the leader's
+    // clock, as long as they agree on the station.
+    bool following = false;
+    leader_offset_ns_ = 0;
+    if (cluster) {
+      if (cluster->leader_id() != leader_id_) {
+        leader_id_ = cluster->leader_id();
+        if (options_.verbose && cluster->IsLeader()) {
+          log_ring_.Printf("\nLeading group as node %u\n", leader_id_);
+        } else if (options_.verbose) {
+          log_ring_.Printf("\nFollowing node %u\n", leader_id_);
+        }
+      }
+      if (!cluster->IsLeader() && cluster->have_time_base() &&
+          cluster->TakeFrame(minute_start, &leader_frame_)) {
+        following = strcmp(leader_frame_.station, status_.station) == 0;
+        if (!following && options_.verbose) {
+          log_ring_.Printf("\nLeader sends %s, not following\n",
+                           leader_frame_.station);
+        }
+      }
+      if (following) leader_offset_ns_ = cluster->leader_offset_ns();
+    }
+
+    const time_t transmit_time = following
+                                     ? leader_frame_.transmit_time
+                                     : minute_start + time_offset_s_;
+    if (cluster && cluster->IsLeader()) {
+      leader_frame_.minute = minute_start + 60;
+      leader_frame_.transmit_time = transmit_time + 60;
+      snprintf(leader_frame_.station, sizeof(leader_frame_.station), "%s",
+               status_.station);
+      time_source_->PrepareMinute(leader_frame_.transmit_time);
+      bool fits = true;
+      for (int s = 0; s < 60; ++s) {
+        fits &= leader_frame_.SetSecond(
+            s, time_source_->GetModulationSpan(s));
+      }
+      if (!fits) {
+        log_ring_.Printf("\nToo many changes per second for the group\n");
+      } else if (!cluster->PublishFrame(leader_frame_)) {
+        log_ring_.Printf("\nCould not publish frame to the group\n");
+      }
+    }
+    if (options_.verbose) PrintLocalTime(transmit_time);
+    if (options_.verbose && following) {
+      log_ring_.Printf(" (node %u, %+.3fms)", leader_id_,
+                       leader_offset_ns_ / 1e6);
+    }
+    if (options_.dryrun) log_ring_.Printf(" -> tx-modulation\n");
+    TraceMinutePrepare(transmit_time);
+    time_source_->PrepareMinute(transmit_time);
+    auto *file_source = dynamic_cast<ScheduleFileSource *>(time_source_.get());
+    if (file_source && !file_source->has_frame()) {
+      log_ring_.Printf("\nNot in schedule file, sending unmodulated carrier\n");
+    }
+    status_.transmit_minute = transmit_time;
+
+    // Don't send a time we're not sure about; receivers would keep it until
+    // their next sync.
+    const bool clock_gated =
+        options_.max_clock_error_us >= 0 && !options_.dryrun &&
+        !CheckClockQuality();
+    static constexpr ModulationDuration kCarrierOnly[] = {
+        {CarrierPower::HIGH, 0}};
+
+    // Set if an edge was missed and the rest of the minute is not sent.
+    bool blanked = false;
+    // Only minutes of which we sent something count towards "minutes".
+    bool sent_any = false;
+    for (int second = first_second; second < 60 && !interrupted_ && !blanked;
+         ++second) {
+      const TimeSignalSource::ModulationSpan modulation =
+          clock_gated ? TimeSignalSource::ModulationSpan(
+                            std::begin(kCarrierOnly), std::end(kCarrierOnly))
+          : following ? leader_frame_.seconds[second].modulation()
+                      : time_source_->GetModulationSpan(second);
+
+      // With MissPolicy::STRETCH, the rest of the second is shifted by the
+      // lateness of missed edges.
+      int64_t stretch_ns = 0;
+
+      // How the last edge went, for the flight recorder.
+      int64_t late_ns = 0;       // Wakeup after its deadline.
+      int64_t edge_late_ns = 0;  // Edge after its true time.
+      bool missed = false;
+      auto Record = [&](FlightEdge edge, int16_t value) {
+        uint8_t clock_status = missed ? kFlightMissed : 0;
+        if (clock_gated) clock_status |= kFlightClockGated;
+        if (options_.pps) {
+          clock_status |= kFlightPPSUsed;
+          if (options_.pps->model().locked()) clock_status |= kFlightPPSLocked;
+        }
+        if (!recorder) return;
+        recorder->Add(edge_time.tv_sec * 1000000000LL + edge_time.tv_nsec,
+                      edge_late_ns, transmit_time, edge, value, clock_status);
+      };
+
+      // Wait for the edge at the given offset into the minute, minus the
+      // lead the hardware needs, and apply the miss policy if we got there
+      // too late. Returns 'false' if the rest of the second is not to be
+      // sent.
+      auto WaitForEdgeAt = [&](int64_t offset_ns, int64_t lead_ns) {
+        edge_time = AddNanos({minute_start, 0}, offset_ns);
+        target_wait = AddNanos(EdgeDeadline(edge_time), stretch_ns - lead_ns);
+        FinishPhaseShiftBefore(hw, target_wait);
+        late_ns = WaitForEdge(target_wait);
+        // The keying lead is spent before the edge, the stretch is not.
+        edge_late_ns = stretch_ns + late_ns;
+        missed = false;
+        if (interrupted_) return false;
+        // The benchmark is there to measure the tail, so never stop
+        // sampling; its statistics show the edges that would be missed.
+        if (options_.benchmark || clock_changed_ ||
+            late_ns <= options_.lateness_budget_us * 1000LL) {
+          return true;
+        }
+        missed = true;
+        CountMiss();
+        switch (options_.miss_policy) {
+          case MissPolicy::STRETCH:
+            stretch_ns += late_ns;
+            return true;
+          case MissPolicy::BLANK:
+            SetTxPower(hw, CarrierPower::HIGH);
+            Record(FlightEdge::BLANK, (int16_t)CarrierPower::HIGH);
+            log_ring_.Printf("\nMissed edge by %lldus, sending carrier only "
+                             "until next minute\n",
+                             (long long)late_ns / 1000);
+            blanked = true;
+            return false;
+          case MissPolicy::ABORT:
+            log_ring_.Printf("\nMissed edge by %lldus, aborting\n",
+                             (long long)late_ns / 1000);
+            aborted_ = true;
+            interrupted_ = SIGABRT;
+            return false;
+        }
+        return false;
+      };
+
+      // First, let's wait until we reach the beginning of that second
+      UpdatePPS();
+      const int64_t second_ns = (int64_t)second * kNanosPerSecond;
+      status_.second = second;
+      status_.dropped_log_messages = log_ring_.dropped();
+      if (!WaitForEdgeAt(second_ns,
+                         KeyingLeadNs(hw, modulation.front().power))) {
+        break;
+      }
+      if (clock_changed_) {
+        // Our idea of the current minute is off, restart at the next one.
+        clock_changed_ = false;
+        minute_start = TruncateTo(time(nullptr), 60);
+        break;
+      }
+
+      sent_any = true;
+      if (options_.verbose) log_ring_.Printf("\b\b\b:%02d", second);
+
+      // Phase changes are interleaved with the amplitude edges; apply all
+      // that are due before the given offset into the second.
+      const TimeSignalSource::PhaseSpan phase =
+          (phase_modulation_ && !clock_gated)
+              ? time_source_->GetPhaseSpan(second)
+              : TimeSignalSource::PhaseSpan();
+      auto next_phase = phase.begin();
+      auto ApplyPhaseChangesBefore = [&](int64_t offset_ns) {
+        for (/**/;
+             next_phase != phase.end() && next_phase->offset_ns < offset_ns;
+             ++next_phase) {
+          if (next_phase->offset_ns > 0 &&
+              !WaitForEdgeAt(second_ns + next_phase->offset_ns, 0)) {
+            return false;
+          }
+          SetCarrierPhase(hw, next_phase->phase_degrees);
+          // The first change tells which bit the second carries; recording
+          // each of hundreds of chips would fill the recorder in minutes.
+          if (next_phase == phase.begin()) {
+            Record(FlightEdge::PHASE, next_phase->phase_degrees * 10);
+          }
+        }
+        return true;
+      };
+
+      // Depending on the time source, there can be multiple amplitude
+      // modulation changes per second.
+      int64_t offset_ns = 0;
+      bool keep_going = true;
+      for (size_t i = 0; i < modulation.size(); ++i) {
+        const ModulationDuration &m = modulation[i];
+        SetTxPower(hw, m.power);
+        Record(FlightEdge::AMPLITUDE, (int16_t)m.power);
+        if (m.duration_ns == 0) break;  // last one.
+        offset_ns += m.duration_ns;
+        const int64_t lead_ns =
+            i + 1 < modulation.size()
+                ? KeyingLeadNs(hw, modulation[i + 1].power)
+                : 0;
+        keep_going = ApplyPhaseChangesBefore(offset_ns) &&
+                     WaitForEdgeAt(second_ns + offset_ns, lead_ns);
+        if (!keep_going) break;
+      }
+      if (keep_going) ApplyPhaseChangesBefore(kNanosPerSecond);
+      if (cluster) cluster->SendHeartbeat(status_.station);
+      if (options_.dryrun) PrintModulationChart(modulation);
+      if (options_.dryrun && phase_modulation_) PrintPhaseSummary(phase);
+    }
+    if (sent_any) --ttl;
+    first_second = 0;
+    if (options_.verbose) log_ring_.Printf("\n");
+  }
+}
+
+bool Transmitter::Run() {
+  if (options_.cluster) {
+    event_loop_.AddReadHandler(options_.cluster->fd(), [this]() {
+      options_.cluster->HandleMessages();
+    });
+  }
+  scheduling_ = SetupScheduling(options_.start_minute + time_offset_s_);
+
+  // The transmit loop is instantiated for each backend and runs with the one
+  // of the board we're on, so that the hardware calls in it are direct.
+  DispatchBackend(hardware_, [this](auto *hw) { TransmitLoop(hw); });
+
+  if (carrier_running_) StopCarrier(hardware_);
+
+  log_ring_.Stop();
+  if (log_ring_.dropped()) {
+    fprintf(stderr, "%lld log messages dropped\n",
+            (long long)log_ring_.dropped());
+  }
+  for (int i = 0; i < status_.stations; ++i) {
+    fprintf(stderr, "%s: %lld missed edges\n",
+            status_.missed_by_station[i].station,
+            (long long)status_.missed_by_station[i].missed);
+  }
+  return !aborted_;
+}
@@ -0,0 +1,603 @@
+// -*- mode: c++; c-basic-offset: 2; indent-tabs-mode: nil; -*-
+// This is txtempus-analyze, part of txtempus, a LF time signal transmitter.
+// Copyright (C) 2018 Henner Zeller <h.zeller@acm.org>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+//
+// Analysis of recorded transmissions, e.g. from a sound card connected to a
+// pickup coil, or from an SDR: demodulates the carrier envelope, recovers
+// the edges, decodes the minute frames and compares them to what txtempus
+// sends for that minute.
+// With -V, it checks the encoders themselves against the reference decoders.
+
+#include <strings.h>
+#include <time.h>  // NOLINT(modernize-deprecated-headers) for clock_gettime
+#include <unistd.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "capture-file.h"
+#include "carrier-power.h"
+#include "encoder-sweep.h"
+#include "envelope-detector.h"
+#include "frame-decoder.h"
+#include "time-signal-source.h"
+
+namespace {
+// Resolution of the envelope.
+constexpr double kBlockSeconds = 0.001;
+
+// Window to look for the edge starting a second around its expected time.
+constexpr double kTrackWindow = 0.020;
+
+// Edges closer than this to the boundaries belong to the next second.
+constexpr double kEdgeGuard = 0.003;
+
+// After that many seconds without edge at the expected time, the signal is
+// considered lost and we look for it again.
+constexpr int kMaxMissedSeconds = 5;
+
+struct Levels {
+  float high;       // Mean envelope at full carrier.
+  float reduced;    // Mean envelope at reduced carrier.
+  float threshold;  // In the middle between them.
+};
+
+struct Edge {
+  double time;  // Seconds
+  bool rising;
+};
+
+struct Second {
+  double start;  // Seconds since the beginning of the capture.
+  bool has_start_edge;
+  int segment;  // Seconds in the same segment are contiguous.
+  std::vector<Edge> edges;  // Within the second, relative to its start.
+  TimeSignalSource::SecondModulation modulation;
+};
+
+class ErrorStats {
+ public:
+  void Add(double error) {
+    ++count_;
+    sum_ += error;
+    sum_squares_ += error * error;
+    max_ = std::max(max_, fabs(error));
+  }
+  int count() const { return count_; }
+  double mean() const { return count_ ? sum_ / count_ : 0; }
+  double rms() const { return count_ ? sqrt(sum_squares_ / count_) : 0; }
+  double max() const { return max_; }
+
+ private:
+  int count_ = 0;
+  double sum_ = 0;
+  double sum_squares_ = 0;
+  double max_ = 0;
+};
+
+// Find the levels of full and reduced carrier: start in the middle between
+// the (robust) minimum and maximum, then move the threshold to the middle of
+// the mean levels above and below it until it is stable.
+Levels FindLevels(const std::vector<float> &envelope) {
+  std::vector<float> sorted(envelope);
+  const size_t low_index = sorted.size() / 200;
+  const size_t high_index = sorted.size() - 1 - low_index;
+  std::nth_element(sorted.begin(), sorted.begin() + low_index, sorted.end());
+  const float low = sorted[low_index];
+  std::nth_element(sorted.begin(), sorted.begin() + high_index, sorted.end());
+  const float high = sorted[high_index];
+
+  Levels levels = {high, low, (low + high) / 2};
+  for (int i = 0; i < 100; ++i) {
+    double sum_high = 0, sum_low = 0;
+    int64_t count_high = 0, count_low = 0;
+    for (float e : envelope) {
+      if (e > levels.threshold) {
+        sum_high += e;
+        ++count_high;
+      } else {
+        sum_low += e;
+        ++count_low;
+      }
+    }
+    if (count_high == 0 || count_low == 0) break;
+    levels.high = sum_high / count_high;
+    levels.reduced = sum_low / count_low;
+    const float threshold = (levels.high + levels.reduced) / 2;
+    const bool stable = fabs(threshold - levels.threshold) < 1e-4 * high;
+    levels.threshold = threshold;
+    if (stable) break;
+  }
+  return levels;
+}
+
+// Edges of the envelope, with some hysteresis. The time of the edge is
+// interpolated to where the envelope crosses the threshold; each envelope
+// value is that of the center of its block.
+std::vector<Edge> FindEdges(const std::vector<float> &envelope,
+                            const Levels &levels, double block_seconds) {
+  const float swing = levels.high - levels.reduced;
+  const float upper = levels.reduced + 0.6f * swing;
+  const float lower = levels.reduced + 0.4f * swing;
+  std::vector<Edge> edges;
+  if (envelope.empty()) return edges;
+  bool high = envelope[0] > levels.threshold;
+  for (size_t k = 1; k < envelope.size(); ++k) {
+    if (high ? envelope[k] >= lower : envelope[k] <= upper) continue;
+    high = !high;
+    size_t j = k;
+    while (j > 1 && (envelope[j - 1] > levels.threshold) == high) --j;
+    const float a = envelope[j - 1], b = envelope[j];
+    const double fraction = (b != a) ? (levels.threshold - a) / (b - a) : 0.5;
+    edges.push_back({(j - 0.5 + fraction) * block_seconds, high});
+  }
+  return edges;
+}
+
+// Index of the edge in the given direction closest to "t", within the
+// tracking window. Returns -1 if there is none.
+int64_t FindEdge(const std::vector<Edge> &edges, bool rising, double t) {
+  auto it = std::lower_bound(
+      edges.begin(), edges.end(), t - kTrackWindow,
+      [](const Edge &e, double value) { return e.time < value; });
+  int64_t best = -1;
+  for (/**/; it != edges.end() && it->time <= t + kTrackWindow; ++it) {
+    if (it->rising != rising) continue;
+    if (best < 0 || fabs(it->time - t) < fabs(edges[best].time - t)) {
+      best = it - edges.begin();
+    }
+  }
+  return best;
+}
+
+// Follow the beginning of each second, marked by an edge in the given
+// direction. Some seconds (e.g. DCF77 second 59) don't have that edge, so
+// they are extrapolated. The length of the transmitter's second, as seen by
+// the sample clock, is tracked as we go.
+std::vector<Second> TrackSeconds(const std::vector<Edge> &edges, bool rising,
+                                 double duration) {
+  std::vector<Second> seconds;
+  int segment = 0;
+  size_t candidate = 0;
+  while (candidate < edges.size()) {
+    // Acquire: an edge that has others about one, two or three seconds later.
+    const Edge &first = edges[candidate];
+    int confirmations = 0;
+    for (int n = 1; n <= 3 && first.rising == rising; ++n) {
+      if (FindEdge(edges, rising, first.time + n) >= 0) ++confirmations;
+    }
+    if (confirmations < 2) {
+      ++candidate;
+      continue;
+    }
+
+    double last_edge = first.time;
+    int since_edge = 0;  // Seconds since last_edge.
+    double period = 1.0;
+    seconds.push_back({first.time, true, segment, {}, {}});
+    for (int missed = 0; missed <= kMaxMissedSeconds; /**/) {
+      const double expected = last_edge + (since_edge + 1) * period;
+      if (expected + kTrackWindow > duration) break;
+      const int64_t found = FindEdge(edges, rising, expected);
+      if (found >= 0) {
+        const double t = edges[found].time;
+        period += 0.1 * ((t - last_edge) / (since_edge + 1) - period);
+        period = std::max(0.99, std::min(1.01, period));
+        last_edge = t;
+        since_edge = 0;
+        missed = 0;
+        seconds.push_back({t, true, segment, {}, {}});
+      } else {
+        ++since_edge;
+        ++missed;
+        seconds.push_back({expected, false, segment, {}, {}});
+      }
+    }
+    while (!seconds.back().has_start_edge) seconds.pop_back();
+    ++segment;
+    candidate = std::upper_bound(
+                    edges.begin(), edges.end(), last_edge + 0.5,
+                    [](double value, const Edge &e) { return value < e.time; }) -
+                edges.begin();
+  }
+  return seconds;
+}
+
+// Collect the edges within each second and reconstruct its modulation.
+void FillModulation(const std::vector<Edge> &edges,
+                    const std::vector<float> &envelope, const Levels &levels,
+                    double block_seconds, bool rising,
+                    std::vector<Second> *seconds) {
+  for (size_t i = 0; i < seconds->size(); ++i) {
+    Second &second = (*seconds)[i];
+    const bool has_next = i + 1 < seconds->size() &&
+                          (*seconds)[i + 1].segment == second.segment;
+    const double length = has_next ? (*seconds)[i + 1].start - second.start
+                                   : 1.0;
+    bool high = rising;
+    if (!second.has_start_edge) {
+      const size_t k = (second.start + kEdgeGuard) / block_seconds;
+      high = k < envelope.size() && envelope[k] > levels.threshold;
+    }
+    auto it = std::lower_bound(
+        edges.begin(), edges.end(), second.start + kEdgeGuard,
+        [](const Edge &e, double value) { return e.time < value; });
+    int last_ms = 0;
+    for (/**/; it != edges.end() && it->time < second.start + length - kEdgeGuard;
+         ++it) {
+      // Normalized to the length of the second.
+      const double offset = (it->time - second.start) / length;
+      const int offset_ms = lround(offset * 1000);
+      second.edges.push_back({offset, it->rising});
+      second.modulation.push_back(
+          {high ? CarrierPower::HIGH : CarrierPower::LOW,
+           Millis(offset_ms - last_ms)});
+      high = it->rising;
+      last_ms = offset_ms;
+    }
+    second.modulation.push_back(
+        {high ? CarrierPower::HIGH : CarrierPower::LOW, 0});
+  }
+}
+
+// Whether the seconds of this service begin with the carrier going up.
+bool SecondStartsRising(TimeSignalSource *source) {
+  source->PrepareMinute(0);
+  return PowerAt(source->GetModulationForSecond(1), 0) == CarrierPower::HIGH;
+}
+
+// Edges txtempus sends in the given second, not counting the one at its
+// beginning, and whether the carrier is up at the beginning.
+std::vector<Edge> IntendedEdges(
+    const TimeSignalSource::SecondModulation &modulation, bool *initial_high) {
+  std::vector<Edge> edges;
+  *initial_high = PowerAt(modulation, 0) == CarrierPower::HIGH;
+  bool high = *initial_high;
+  int64_t offset_ns = 0;
+  for (const ModulationDuration &m : modulation) {
+    if ((m.power == CarrierPower::HIGH) != high) {
+      high = !high;
+      edges.push_back({offset_ns / 1e9, high});
+    }
+    if (m.duration_ns == 0) break;
+    offset_ns += m.duration_ns;
+  }
+  return edges;
+}
+
+// Regression line through the start of each second of a segment: the slope
+// is the length of the transmitter's second in capture time, the residuals
+// are the timing errors of the second edges.
+void FitSeconds(const std::vector<Second> &seconds, size_t begin, size_t end,
+                ErrorStats *residuals, double *slope) {
+  double sum_x = 0, sum_y = 0, sum_xx = 0, sum_xy = 0;
+  int n = 0;
+  for (size_t i = begin; i < end; ++i) {
+    if (!seconds[i].has_start_edge) continue;
+    const double x = i - begin;
+    const double y = seconds[i].start - seconds[begin].start;
+    sum_x += x;
+    sum_y += y;
+    sum_xx += x * x;
+    sum_xy += x * y;
+    ++n;
+  }
+  const double denominator = n * sum_xx - sum_x * sum_x;
+  if (n < 2 || denominator == 0) return;
+  *slope = (n * sum_xy - sum_x * sum_y) / denominator;
+  const double intercept = (sum_y - *slope * sum_x) / n;
+  for (size_t i = begin; i < end; ++i) {
+    if (!seconds[i].has_start_edge) continue;
+    const double predicted = intercept + *slope * (i - begin);
+    residuals->Add((seconds[i].start - seconds[begin].start - predicted) *
+                   1000);
+  }
+}
+
+// Time zones to verify the encoders in: those of the stations, UTC, and one
+// with DST in the southern hemisphere.
+constexpr char kDefaultZones[] =
+    "UTC,Europe/Berlin,Europe/London,America/Denver,Asia/Tokyo,"
+    "Asia/Shanghai,Australia/Sydney";
+
+double Now();
+
+// Check every minute of the given years with each of the encoders (or just
+// the given one) in each of the comma separated time zones.
+int VerifyEncoders(const char *station_name, int first_year, int last_year,
+                   const char *zones, int threads) {
+  static constexpr const char *kServices[] = {"DCF77", "WWVB", "JJY40",
+                                              "JJY60", "MSF",  "BPC"};
+  struct tm tm = {};
+  tm.tm_mday = 1;
+  tm.tm_year = first_year - 1900;
+  const time_t from = timegm(&tm);
+  tm.tm_year = last_year + 1 - 1900;
+  const time_t to = timegm(&tm);
+
+  int64_t failures = 0;
+  std::string zone_list = zones;
+  for (char *save, *zone = strtok_r(&zone_list[0], ",", &save); zone;
+       zone = strtok_r(nullptr, ",", &save)) {
+    setenv("TZ", zone, 1);
+    tzset();
+    for (const char *service : kServices) {
+      if (station_name && strcasecmp(station_name, service) != 0) continue;
+      const double start = Now();
+      const SweepResult result =
+          SweepEncoder(service, from, to, threads, 10);
+      printf("%-5s %-20s %lld minutes %d-%d: %lld failed, %lld ambiguous "
+             "(%.1f s)\n",
+             service, zone, (long long)result.minutes, first_year, last_year,
+             (long long)result.failures, (long long)result.ambiguous,
+             Now() - start);
+      fflush(stdout);
+      failures += result.failures;
+    }
+  }
+  return failures == 0 ? 0 : 1;
+}
+
+double Now() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+int usage(const char *msg, const char *progname) {
+  fprintf(stderr,
+          "%susage: %s [options] <capture-file>\n"
+          "       %s -V [options]\n"
+          "Options:\n"
+          "\t-s <service>          : Service; one of "
+          "'DCF77', 'WWVB', 'JJY40', 'JJY60', 'MSF',\n"
+          "\t                        'BPC'\n"
+          "\t-f <format>           : Raw capture instead of WAV; one of "
+          "s16, f32 (real) or\n"
+          "\t                        cu8, cs16, cf32 (I/Q).\n"
+          "\t-r <hertz>            : Sample rate of raw captures.\n"
+          "\t-c <hertz>            : Center frequency of I/Q captures "
+          "(default: 0).\n"
+          "\t-i                    : Stereo WAV file contains I/Q.\n"
+          "\t-y <year>             : Reference year for two-digit years "
+          "(default: now).\n"
+          "\t-j <threads>          : Threads for demodulation "
+          "(default: all CPUs).\n"
+          "\t-v                    : Verbose; list each decoded minute.\n"
+          "\t-h                    : This help.\n"
+          "Verify encoders against the reference decoders (all services "
+          "unless -s):\n"
+          "\t-V                    : Check every minute instead of a "
+          "capture.\n"
+          "\t-Y <year>-<year>      : Range of years (default: 1970-2100).\n"
+          "\t-j <processes>        : Worker processes (default: all CPUs).\n"
+          "\t-Z <zone,...>         : Time zones (default: %s).\n",
+          msg, progname, progname, kDefaultZones);
+  return 1;
+}
+}  // end anonymous namespace
+
+int main(int argc, char *argv[]) {
+  const char *station_name = nullptr;
+  const char *raw_format = nullptr;
+  int sample_rate = 0;
+  double center_hz = 0;
+  bool iq = false;
+  bool verbose = false;
+  time_t reference = time(nullptr);
+  int threads = std::thread::hardware_concurrency();
+  bool verify = false;
+  int first_year = 1970, last_year = 2100;
+  const char *zones = kDefaultZones;
+  int opt;
+  while ((opt = getopt(argc, argv, "s:f:r:c:iy:j:vVY:Z:h")) != -1) {
+    switch (opt) {
+      case 's':
+        station_name = optarg;
+        break;
+      case 'f':
+        raw_format = optarg;
+        break;
+      case 'r':
+        sample_rate = atoi(optarg);
+        break;
+      case 'c':
+        center_hz = atof(optarg);
+        break;
+      case 'i':
+        iq = true;
+        break;
+      case 'y': {
+        struct tm tm = {};
+        tm.tm_year = atoi(optarg) - 1900;
+        tm.tm_mday = 1;
+        reference = timegm(&tm);
+        break;
+      }
+      case 'j':
+        threads = atoi(optarg);
+        break;
+      case 'v':
+        verbose = true;
+        break;
+      case 'V':
+        verify = true;
+        break;
+      case 'Y':
+        if (sscanf(optarg, "%d-%d", &first_year, &last_year) != 2 ||
+            first_year > last_year) {
+          return usage("Invalid year range\n", argv[0]);
+        }
+        break;
+      case 'Z':
+        zones = optarg;
+        break;
+      default:
+        return usage("", argv[0]);
+    }
+  }
+  if (verify) {
+    if (station_name && !CreateFrameDecoder(station_name)) {
+      return usage("Unknown service\n", argv[0]);
+    }
+    return VerifyEncoders(station_name, first_year, last_year, zones, threads);
+  }
+  if (optind != argc - 1) {
+    return usage("Please give one capture file\n", argv[0]);
+  }
+  const char *filename = argv[optind];
+
+  std::unique_ptr<TimeSignalSource> source;
+  std::unique_ptr<FrameDecoder> decoder;
+  if (station_name) {
+    source = CreateTimeSignalSource(station_name);
+    decoder = CreateFrameDecoder(station_name);
+  }
+  if (!source || !decoder) {
+    return usage("Please choose a service name with -s option\n", argv[0]);
+  }
+
+  CaptureFile capture;
+  if (raw_format ? !capture.OpenRaw(filename, raw_format, sample_rate)
+                 : !capture.OpenWav(filename, iq)) {
+    return 1;
+  }
+
+  const int carrier_hz = source->GetCarrierFrequencyHz();
+  const int rate = capture.sample_rate();
+  const double frequency = AliasedFrequency(
+      carrier_hz - (capture.is_complex() ? center_hz : 0), rate,
+      capture.is_complex());
+  const int block_frames = std::max(1L, lround(rate * kBlockSeconds));
+  const double block_seconds = (double)block_frames / rate;
+  const double duration = (double)capture.frames() / rate;
+  printf("Capture: %s, %d Hz %s, %.1f s\n", filename, rate,
+         capture.is_complex() ? "I/Q" : "real", duration);
+  printf("Carrier: %d Hz, seen at %.1f Hz\n", carrier_hz, frequency);
+  if (fabs(frequency) < 1 / block_seconds ||
+      fabs(frequency) > rate / 2.0 - 1 / block_seconds) {
+    fprintf(stderr, "Carrier too close to DC or the Nyquist frequency\n");
+    return 1;
+  }
+
+  const double demodulation_start = Now();
+  const std::vector<float> envelope =
+      ComputeEnvelope(capture, frequency, block_frames, threads);
+  if (verbose) {
+    const double elapsed = Now() - demodulation_start;
+    fprintf(stderr, "Demodulated in %.2f s (%.0fx realtime)\n", elapsed,
+            duration / elapsed);
+  }
+  if (envelope.size() < 3000) {
+    fprintf(stderr, "Capture too short\n");
+    return 1;
+  }
+
+  const Levels levels = FindLevels(envelope);
+  printf("Levels: full %.4g, reduced %.4g (%.1f%%, %.1f dB)\n", levels.high,
+         levels.reduced, 100.0 * levels.reduced / levels.high,
+         20 * log10(levels.reduced / levels.high));
+
+  const bool rising = SecondStartsRising(source.get());
+  const std::vector<Edge> edges = FindEdges(envelope, levels, block_seconds);
+  std::vector<Second> seconds = TrackSeconds(edges, rising, duration);
+  FillModulation(edges, envelope, levels, block_seconds, rising, &seconds);
+
+  ErrorStats second_errors;
+  double longest_slope = 1.0;
+  size_t longest_segment = 0;
+  int without_edge = 0;
+  for (size_t begin = 0, end; begin < seconds.size(); begin = end) {
+    for (end = begin; end < seconds.size() &&
+                      seconds[end].segment == seconds[begin].segment;
+         ++end) {
+      if (!seconds[end].has_start_edge) ++without_edge;
+    }
+    double slope = 1.0;
+    FitSeconds(seconds, begin, end, &second_errors, &slope);
+    if (end - begin > longest_segment) {
+      longest_segment = end - begin;
+      longest_slope = slope;
+    }
+  }
+  printf("Seconds: %zu in %d segment(s), %d without start edge, "
+         "clock %+.1f ppm\n",
+         seconds.size(), seconds.empty() ? 0 : seconds.back().segment + 1,
+         without_edge, (longest_slope - 1) * 1e6);
+  printf("Second edges: rms %.3f ms, max %.3f ms from regression\n",
+         second_errors.rms(), second_errors.max());
+
+  // Decode and compare with what txtempus would have sent.
+  std::vector<TimeSignalSource::ModulationSpan> modulation;
+  for (const Second &s : seconds) modulation.push_back(s.modulation);
+  ErrorStats edge_errors;
+  int frames = 0;
+  int mismatched_seconds = 0;
+  for (size_t i = 0; i + 60 <= seconds.size(); /**/) {
+    DecodedMinute decoded;
+    if (seconds[i].segment != seconds[i + 59].segment ||
+        !decoder->DecodeMinute(&modulation[i], reference, &decoded)) {
+      ++i;
+      continue;
+    }
+    ++frames;
+    if (verbose) {
+      char buf[32];
+      struct tm tm;
+      localtime_r(&decoded.minute, &tm);
+      strftime(buf, sizeof(buf), "%Y-%m-%d %H:%M", &tm);
+      printf("  %9.3f s: %s%s\n", seconds[i].start, buf,
+             decoded.dst > 0 ? " DST" : "");
+    }
+    source->PrepareMinute(decoded.minute);
+    for (int s = 0; s < 60; ++s, ++i) {
+      bool initial_high;
+      const std::vector<Edge> intended =
+          IntendedEdges(source->GetModulationForSecond(s), &initial_high);
+      const std::vector<Edge> &measured = seconds[i].edges;
+      bool same = initial_high == (PowerAt(seconds[i].modulation, 0) ==
+                                   CarrierPower::HIGH) &&
+                  intended.size() == measured.size();
+      for (size_t e = 0; same && e < intended.size(); ++e) {
+        same = intended[e].rising == measured[e].rising;
+      }
+      if (!same) {
+        ++mismatched_seconds;
+        if (verbose) printf("    second %d differs\n", s);
+        continue;
+      }
+      for (size_t e = 0; e < intended.size(); ++e) {
+        edge_errors.Add((measured[e].time - intended[e].time) * 1000);
+      }
+    }
+  }
+  printf("Frames: %d decoded\n", frames);
+  printf("Edges vs. intended: %d, mean %+.3f ms, rms %.3f ms, max %.3f ms; "
+         "%d second(s) differ\n",
+         edge_errors.count(), edge_errors.mean(), edge_errors.rms(),
+         edge_errors.max(), mismatched_seconds);
+
+  return (frames > 0 && mismatched_seconds == 0) ? 0 : 1;
+}
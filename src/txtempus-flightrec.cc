@@ -0,0 +1,151 @@
+// -*- mode: c++; c-basic-offset: 2; indent-tabs-mode: nil; -*-
+// This is txtempus-flightrec, part of txtempus, a LF time signal transmitter.
+// Copyright (C) 2018 Henner Zeller <h.zeller@acm.org>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+// Dumps the flight recorder file written by txtempus -F, oldest first.
+
+#include <unistd.h>
+
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+
+#include "carrier-power.h"
+#include "flight-recorder.h"
+
+namespace {
+const char *PowerName(int value) {
+  switch ((CarrierPower)value) {
+    case CarrierPower::OFF:
+      return "OFF";
+    case CarrierPower::LOW:
+      return "LOW";
+    case CarrierPower::HIGH:
+      return "HIGH";
+  }
+  return "?";
+}
+
+void PrintRecord(const FlightRecord &r) {
+  const time_t second = r.intended_ns / 1000000000;
+  const long micros = (r.intended_ns % 1000000000) / 1000;
+  struct tm tm;
+  char when[32];
+  localtime_r(&second, &tm);
+  strftime(when, sizeof(when), "%Y-%m-%d %H:%M:%S", &tm);
+
+  const time_t frame_time = r.frame;
+  char frame[32];
+  localtime_r(&frame_time, &tm);
+  strftime(frame, sizeof(frame), "%Y-%m-%d %H:%M", &tm);
+
+  char value[32];
+  switch (r.edge) {
+    case FlightEdge::AMPLITUDE:
+      snprintf(value, sizeof(value), "power %s", PowerName(r.value));
+      break;
+    case FlightEdge::PHASE:
+      snprintf(value, sizeof(value), "phase %+.1f", r.value / 10.0);
+      break;
+    case FlightEdge::BLANK:
+      snprintf(value, sizeof(value), "blank");
+      break;
+    default:
+      snprintf(value, sizeof(value), "unknown edge %d", (int)r.edge);
+  }
+
+  const char *pps = "";
+  if (r.clock_status & kFlightPPSUsed) {
+    pps = (r.clock_status & kFlightPPSLocked) ? " pps-locked" : " pps-unlocked";
+  }
+  char line[160];
+  int len = snprintf(line, sizeof(line),
+                     "%s.%06ld %+9.3fms frame %s %-12s%s%s%s", when, micros,
+                     r.late_ns / 1e6, frame, value,
+                     (r.clock_status & kFlightMissed) ? " MISSED" : "",
+                     (r.clock_status & kFlightClockGated) ? " clock-gated" : "",
+                     pps);
+  while (len > 0 && line[len - 1] == ' ') line[--len] = '\0';
+  puts(line);
+}
+
+int usage(const char *msg, const char *progname) {
+  fprintf(stderr,
+          "%susage: %s [options] <flight-recorder-file>\n"
+          "Options:\n"
+          "\t-n <records>          : Only the last number of records.\n"
+          "\t-m                    : Only missed edges.\n"
+          "Times are shown in the local time zone.\n",
+          msg, progname);
+  return 1;
+}
+}  // end anonymous namespace
+
+int main(int argc, char *argv[]) {
+  uint64_t last = 0;
+  bool only_missed = false;
+  int opt;
+  while ((opt = getopt(argc, argv, "n:mh")) != -1) {
+    switch (opt) {
+      case 'n':
+        last = strtoull(optarg, nullptr, 10);
+        if (last == 0) return usage("Invalid number of records\n", argv[0]);
+        break;
+      case 'm':
+        only_missed = true;
+        break;
+      default:
+        return usage("", argv[0]);
+    }
+  }
+  if (optind != argc - 1) return usage("Please give one file\n", argv[0]);
+
+  FlightRecorder recorder;
+  if (!recorder.OpenReadOnly(argv[optind])) return 1;
+  const FlightRecorderHeader &header = recorder.header();
+
+  // Copy the count once; txtempus might be writing while we read.
+  const uint64_t count = header.count;
+  uint64_t first = count > header.capacity ? count - header.capacity : 0;
+  if (last && count - first > last) first = count - last;
+
+  uint64_t shown = 0, incomplete = 0, missed = 0;
+  int64_t max_late_ns = 0;
+  for (uint64_t n = first; n < count; ++n) {
+    const FlightRecord &r = recorder.record(n);
+    if (r.sequence != (uint32_t)(n + 1)) {
+      ++incomplete;  // Torn by a crash, or already overwritten.
+      continue;
+    }
+    if (r.clock_status & kFlightMissed) ++missed;
+    if (r.late_ns > max_late_ns) max_late_ns = r.late_ns;
+    if (only_missed && !(r.clock_status & kFlightMissed)) continue;
+    PrintRecord(r);
+    ++shown;
+  }
+  fprintf(stderr,
+          "%llu of %llu records (capacity %llu); %llu missed edges, "
+          "max lateness %.3fms",
+          (unsigned long long)shown, (unsigned long long)(count - first),
+          (unsigned long long)header.capacity, (unsigned long long)missed,
+          max_late_ns / 1e6);
+  if (incomplete) {
+    fprintf(stderr, "; %llu incomplete", (unsigned long long)incomplete);
+  }
+  fprintf(stderr, "\n");
+  return 0;
+}
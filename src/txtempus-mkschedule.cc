@@ -0,0 +1,255 @@
+// -*- mode: c++; c-basic-offset: 2; indent-tabs-mode: nil; -*-
+// This is txtempus-mkschedule, part of txtempus, a LF time signal transmitter.
+// Copyright (C) 2018 Henner Zeller <h.zeller@acm.org>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+//
+// Generates schedule files (see schedule-file.h) that txtempus can play
+// back with -f, so that the target doesn't need to compute anything or
+// know about time zones.
+
+#define _XOPEN_SOURCE
+
+#include <time.h>  // NOLINT(modernize-deprecated-headers) for clock_gettime
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <vector>
+
+#include "carrier-power.h"
+#include "frame-decoder.h"
+#include "schedule-file.h"
+#include "time-signal-source.h"
+
+namespace {
+time_t ParseLocalTime(const char *time_string) {
+  struct tm tm = {};
+  const char *final_pos = strptime(time_string, "%Y-%m-%d %H:%M", &tm);
+  if (!final_pos || *final_pos) return 0;
+  tm.tm_isdst = -1;
+  return mktime(&tm);
+}
+
+void PrintLocalTime(time_t t) {
+  char buf[32];
+  struct tm tm;
+  localtime_r(&t, &tm);
+  strftime(buf, sizeof(buf), "%Y-%m-%d %H:%M", &tm);
+  fprintf(stderr, "%s", buf);
+}
+
+double Now() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+bool ToSymbol(const TimeSignalSource::SecondModulation &modulation,
+              ScheduleSymbol *symbol) {
+  memset(symbol, 0, sizeof(*symbol));
+  int i = 0;
+  for (const ModulationDuration &m : modulation) {
+    if (i == kScheduleMaxChanges) return false;
+    symbol->changes[i].power = (uint8_t)m.power;
+    symbol->changes[i].duration_ns = m.duration_ns;
+    ++i;
+    if (m.duration_ns == 0) return true;
+  }
+  // The last power stays for the rest of the second; make that explicit.
+  if (i == 0 || i == kScheduleMaxChanges) return false;
+  symbol->changes[i].power = symbol->changes[i - 1].power;
+  return true;
+}
+
+int Generate(const char *service, time_t first_minute, int days,
+             const char *filename) {
+  std::unique_ptr<TimeSignalSource> source = CreateTimeSignalSource(service);
+  const uint32_t minutes = days * 24 * 60;
+  const double start = Now();
+
+  // First, find the distinct symbols in each second of the minute and
+  // remember which one each second of each frame uses.
+  std::vector<ScheduleSymbol> symbols[60];
+  std::vector<uint8_t> values((size_t)minutes * 60);
+  for (uint32_t m = 0; m < minutes; ++m) {
+    source->PrepareMinute(first_minute + m * 60);
+    for (int s = 0; s < 60; ++s) {
+      ScheduleSymbol symbol;
+      if (!ToSymbol(source->GetModulationForSecond(s), &symbol)) {
+        fprintf(stderr, "Modulation too complex for schedule file\n");
+        return 1;
+      }
+      size_t index = 0;
+      while (index < symbols[s].size() &&
+             memcmp(&symbols[s][index], &symbol, sizeof(symbol)) != 0) {
+        ++index;
+      }
+      if (index == symbols[s].size()) {
+        if (index == (1 << kScheduleMaxBitsPerSecond)) {
+          fprintf(stderr, "Too many different symbols in second %d\n", s);
+          return 1;
+        }
+        symbols[s].push_back(symbol);
+      }
+      values[(size_t)m * 60 + s] = index;
+    }
+  }
+
+  int bits = 1;
+  for (const auto &s : symbols) {
+    while (s.size() > (1u << bits)) ++bits;
+  }
+  const int seconds_per_word = 64 / bits;
+  const int words_per_frame = (60 + seconds_per_word - 1) / seconds_per_word;
+
+  ScheduleFileHeader header = {};
+  memcpy(header.magic, kScheduleMagic, sizeof(header.magic));
+  header.byte_order = kScheduleByteOrder;
+  header.carrier_hz = source->GetCarrierFrequencyHz();
+  snprintf(header.station, sizeof(header.station), "%s", service);
+  header.first_minute = first_minute;
+  header.minutes = minutes;
+  header.bits_per_second = bits;
+  header.words_per_frame = words_per_frame;
+  header.symbols_offset = sizeof(header);
+  header.frames_offset =
+      header.symbols_offset + 60 * (1 << bits) * sizeof(ScheduleSymbol);
+
+  FILE *out = fopen(filename, "wb");
+  if (!out) {
+    perror(filename);
+    return 1;
+  }
+  fwrite(&header, sizeof(header), 1, out);
+  for (auto &s : symbols) {
+    s.resize(1 << bits, s[0]);  // Unused ones; never referenced.
+    fwrite(s.data(), sizeof(ScheduleSymbol), s.size(), out);
+  }
+  std::vector<uint64_t> frame(words_per_frame);
+  for (uint32_t m = 0; m < minutes; ++m) {
+    std::fill(frame.begin(), frame.end(), 0);
+    for (int s = 0; s < 60; ++s) {
+      frame[s / seconds_per_word] |= (uint64_t)values[(size_t)m * 60 + s]
+                                     << (s % seconds_per_word * bits);
+    }
+    fwrite(frame.data(), sizeof(uint64_t), words_per_frame, out);
+  }
+  if (fclose(out) != 0) {
+    perror(filename);
+    return 1;
+  }
+
+  fprintf(stderr, "%s: %s ", filename, service);
+  PrintLocalTime(first_minute);
+  fprintf(stderr, " .. ");
+  PrintLocalTime(first_minute + (int64_t)minutes * 60);
+  fprintf(stderr, ", %d bit/s, %.1f MB in %.1f s\n", bits,
+          (header.frames_offset + (double)minutes * words_per_frame * 8) / 1e6,
+          Now() - start);
+  return 0;
+}
+
+// Decode all frames of the file with the reference decoder.
+int Verify(const char *filename) {
+  ScheduleFileSource source;
+  if (!source.Open(filename)) return 1;
+  const ScheduleFileHeader &header = source.header();
+  std::unique_ptr<FrameDecoder> decoder = CreateFrameDecoder(header.station);
+  if (!decoder) {
+    fprintf(stderr, "No decoder for '%s'\n", header.station);
+    return 1;
+  }
+  TimeSignalSource::ModulationSpan frame[60];
+  uint32_t failures = 0;
+  for (uint32_t m = 0; m < header.minutes; ++m) {
+    const time_t t = header.first_minute + (int64_t)m * 60;
+    source.PrepareMinute(t);
+    for (int s = 0; s < 60; ++s) frame[s] = source.GetModulationSpan(s);
+    DecodedMinute decoded;
+    if (decoder->DecodeMinute(frame, t, &decoded) &&
+        decoded.minute == t) {
+      continue;
+    }
+    if (++failures <= 10) {
+      fprintf(stderr, "Frame for ");
+      PrintLocalTime(t);
+      fprintf(stderr, " does not decode to that minute\n");
+    }
+  }
+  fprintf(stderr, "%s: %s, %u minutes, %u failed\n", filename, header.station,
+          header.minutes, failures);
+  return failures == 0 ? 0 : 1;
+}
+
+int usage(const char *msg, const char *progname) {
+  fprintf(stderr,
+          "%susage: %s [options] -o <schedule-file>\n"
+          "       %s -V <schedule-file>\n"
+          "Options:\n"
+          "\t-s <service>          : Service; one of "
+          "'DCF77', 'WWVB', 'JJY40', 'JJY60', 'MSF',\n"
+          "\t                        'BPC'\n"
+          "\t-t 'YYYY-MM-DD HH:MM' : First minute, local time "
+          "(default: now)\n"
+          "\t-d <days>             : Number of days (default: 365)\n"
+          "\t-o <schedule-file>    : Output file.\n"
+          "\t-V <schedule-file>    : Verify the frames of an existing file "
+          "with the\n"
+          "\t                        reference decoder.\n"
+          "The local time zone (TZ) needs to be the one of the service.\n",
+          msg, progname, progname);
+  return 1;
+}
+}  // end anonymous namespace
+
+int main(int argc, char *argv[]) {
+  const char *service = nullptr;
+  const char *output = nullptr;
+  time_t first_minute = time(nullptr);
+  int days = 365;
+  int opt;
+  while ((opt = getopt(argc, argv, "s:t:d:o:V:h")) != -1) {
+    switch (opt) {
+      case 's':
+        service = optarg;
+        break;
+      case 't':
+        first_minute = ParseLocalTime(optarg);
+        if (first_minute <= 0) return usage("Invalid time string\n", argv[0]);
+        break;
+      case 'd':
+        days = atoi(optarg);
+        if (days <= 0) return usage("Invalid number of days\n", argv[0]);
+        break;
+      case 'o':
+        output = optarg;
+        break;
+      case 'V':
+        return Verify(optarg);
+      default:
+        return usage("", argv[0]);
+    }
+  }
+  if (!service || !CreateTimeSignalSource(service)) {
+    return usage("Please choose a service name with -s option\n", argv[0]);
+  }
+  if (!output) return usage("Please give an output file with -o\n", argv[0]);
+  return Generate(service, first_minute - first_minute % 60, days, output);
+}
@@ -21,12 +21,12 @@
 
 #define _XOPEN_SOURCE
 
-#include <sched.h>
 #include <strings.h>
-#include <time.h>  // NOLINT(modernize-deprecated-headers) for clock_nanosleep
+#include <time.h>  // NOLINT(modernize-deprecated-headers) for clock_gettime
 
+#include <algorithm>
 #include <climits>
-#include <csignal>
+#include <cstdint>
 #include <cstdio>
 #include <cstdlib>
 #include <cstring>
@@ -43,45 +43,31 @@ int getopt(int, char *const *, const char *);  // NOLINT
 }
 
 #include <memory>
+#include <vector>
 
 #include "carrier-power.h"
+#include "cluster.h"
+#include "control-socket.h"
+#include "cycle-counter.h"
+#include "edge-export.h"
+#include "edge-schedule.h"
+#include "flight-recorder.h"
+#include "hardware-backends.h"
 #include "hardware-control.h"
+#include "latency-stats.h"
+#include "power-control.h"
+#include "pps-discipline.h"
+#include "schedule-file.h"
+#include "scheduling.h"
+#include "stressors.h"
 #include "time-signal-source.h"
-
-static bool verbose = false;
-static bool dryrun = false;
-static bool carrier_only = false;
+#include "trace-points.h"
+#include "transmitter.h"
 
 namespace {
-volatile sig_atomic_t interrupted = 0;
-extern "C" {
-void InterruptHandler(int signo) { interrupted = signo; }
-}
-
 // Truncate "t" so that it is multiple of "d"
 time_t TruncateTo(time_t t, int d) { return t - t % d; }
 
-void WaitUntil(const struct timespec &ts) {
-  if (dryrun) return;
-  // NOLINTNEXTLINE(misc-include-cleaner) macros should be defined by time.h
-  clock_nanosleep(CLOCK_REALTIME, TIMER_ABSTIME, &ts, nullptr);
-}
-
-void StartCarrier(HardwareControl *hw, int frequency) {
-  if (dryrun) return;
-  double f = hw->StartClock(frequency);
-  if (verbose) {
-    fprintf(stderr, "Requesting %d Hz, getting %.3f Hz carrier\n", frequency,
-            f);
-  }
-}
-
-void SetTxPower(HardwareControl *hw, CarrierPower power) {
-  if (dryrun) return;
-  if (carrier_only) power = CarrierPower::HIGH;
-  hw->SetTxPower(power);
-}
-
 time_t ParseLocalTime(const char *time_string) {
   struct tm tm = {};
   const char *final_pos = strptime(time_string, "%Y-%m-%d %H:%M", &tm);
@@ -90,49 +76,140 @@ time_t ParseLocalTime(const char *time_string) {
   return mktime(&tm);
 }
 
-void PrintLocalTime(time_t t) {
-  char buf[32];
-  struct tm tm;
-  localtime_r(&t, &tm);
-  strftime(buf, sizeof(buf), "%Y-%m-%d %H:%M:%S", &tm);
-  fprintf(stderr, "%s", buf);
-}
+// Summarize the benchmark and suggest settings from it.
+void PrintBenchmarkReport(LatencyStats *stats, const char *scheduling,
+                          const char *stressors, bool have_latency_qos,
+                          int lateness_budget_us) {
+  fprintf(stderr, "\nScheduling: %s; stressors: %s\n", scheduling,
+          stressors ? stressors : "none");
+  stats->Print(stderr, "Wakeup latency");
+  if (stats->count() == 0) return;
+  fprintf(stderr, "  %zu edges later than the lateness budget of %dus\n",
+          stats->CountAbove(lateness_budget_us * 1000LL), lateness_budget_us);
 
-// Show a full modulation of one second as little ASCII-art.
-void PrintModulationChart(const TimeSignalSource::SecondModulation &mod) {
-  static const int kMsPerDash = 100;
-  fprintf(stderr, " [");
-  int running_ms = 0;
-  int target_ms = 0;
-  bool power = false;
-  for (const ModulationDuration &m : mod) {
-    power = (m.power == CarrierPower::HIGH);
-    target_ms += m.duration_ms;
-    for (/**/; running_ms < target_ms; running_ms += kMsPerDash) {
-      fprintf(stderr, "%s", power ? "#" : "_");
-    }
+  // How early to wake up and spin to be on time for 99.9% of the edges.
+  const int64_t lead_us = (stats->Percentile(0.999) / 1000 + 9) / 10 * 10;
+  fprintf(stderr, "\nRecommendations:\n");
+  fprintf(stderr, "  Edge lead (spin window) covering 99.9%%: %lldus\n",
+          (long long)lead_us);
+  if (strncmp(scheduling, "SCHED_OTHER", 11) == 0) {
+    fprintf(stderr,
+            "  Run as root or with CAP_SYS_NICE to get realtime "
+            "scheduling.\n");
   }
-  for (/**/; running_ms < 1000; running_ms += kMsPerDash) {
-    fprintf(stderr, "%s", power ? "#" : "_");
+  if (stats->Percentile(1) / 1000 > kLateEdgeMicros) {
+    fprintf(stderr,
+            "  Some edges were more than %lldus late. Try -D to reserve CPU "
+            "time,\n  keep other realtime work off the board or isolate a "
+            "CPU.\n",
+            (long long)kLateEdgeMicros);
+  }
+  if (!have_latency_qos && stats->Percentile(0.99) > 100000) {
+    fprintf(stderr,
+            "  p99 above 100us: deep idle states might be the cause, "
+            "compare with -L 0.\n");
   }
-  fprintf(stderr, "]\n");
 }
 
-std::unique_ptr<TimeSignalSource> CreateTimeSourceFromName(const char *n) {
-  if (strcasecmp(n, "DCF77") == 0) {
-    return std::make_unique<DCF77TimeSignalSource>();
+// Time the calls into the hardware backend that the transmit loop does,
+// e.g. to know how much ahead of an edge they need to be issued.
+template <class Hardware>
+void RunHardwareBenchmark(Hardware *hw, int frequency) {
+  static constexpr int kEdgeCalls = 5000;
+  static constexpr int kClockStarts = 200;  // These involve sleeps.
+  const double ns_per_tick = 1e9 / CycleCounterFrequency();
+
+  // Same realtime priority as transmitting, so that we measure the calls
+  // and not the scheduler.
+  if (!SetFifoScheduling(99)) {
+    fprintf(stderr, "Note: no realtime scheduling, expect outliers.\n");
   }
-  if (strcasecmp(n, "WWVB") == 0) {
-    return std::make_unique<WWVBTimeSignalSource>();
+  fprintf(stderr, "Platform %s, timed with %s (%.1fns resolution)\n\n",
+          hw->platform(), CycleCounterName(), ns_per_tick);
+
+  // Run "call" the given number of times with the argument alternating
+  // between calls, and print the distribution of how long it took, minus
+  // "overhead_ns". Returns the median. Generic, so that the call is direct
+  // like in the transmit loop.
+  auto Measure = [ns_per_tick](const char *title, int count,
+                               int64_t overhead_ns, auto &&call) {
+    LatencyStats stats(count);
+    for (int i = 0; i < count; ++i) {
+      const uint64_t start = ReadCycleCounter();
+      call(i % 2 == 0);
+      const uint64_t end = ReadCycleCounter();
+      const int64_t ns = (int64_t)((end - start) * ns_per_tick);
+      stats.Add(std::max<int64_t>(0, ns - overhead_ns));
+    }
+    stats.Print(stderr, title);
+    fprintf(stderr, "\n");
+    return stats.Percentile(0.5);
+  };
+
+  // Baseline: reading the counter around a call that does nothing, as if the
+  // carrier was on a dummy pin. Its median is subtracted from the others.
+  const int64_t overhead_ns =
+      Measure("Timer overhead (subtracted below)", kEdgeCalls, 0, [](bool) {});
+
+  Measure("StartClock()", kClockStarts, overhead_ns,
+          [&](bool) { hw->StartClock(frequency); });
+  Measure("SetTxPower()", kEdgeCalls, overhead_ns, [&](bool low) {
+    hw->SetTxPower(low ? CarrierPower::LOW : CarrierPower::HIGH);
+  });
+  Measure("SetTxPower() keying", kEdgeCalls, overhead_ns, [&](bool off) {
+    hw->SetTxPower(off ? CarrierPower::OFF : CarrierPower::HIGH);
+  });
+  fprintf(stderr, "Keying latency compensated: %lldns\n\n",
+          (long long)hw->KeyingLatencyNs());
+  Measure("EnableClockOutput()", kEdgeCalls, overhead_ns,
+          [&](bool off) { hw->EnableClockOutput(!off); });
+  if (hw->SetCarrierPhase(0)) {
+    // Starting and ending a shift; the time in between is spent waiting.
+    Measure("SetCarrierPhase()", kEdgeCalls / 10, overhead_ns, [&](bool shift) {
+      hw->SetCarrierPhase(shift ? 15.8 : 0);
+      hw->FinishPhaseShift();
+    });
   }
-  if (strcasecmp(n, "JJY40") == 0) {
-    return std::make_unique<JJY40TimeSignalSource>();
+  hw->StopClock();
+}
+
+// Export the edges of the minutes to send to "filename" as fast as they can
+// be computed, without transmitting.
+int ExportEdges(const Transmitter::Options &options, TimeSignalSource *source,
+                const char *station, const char *filename) {
+  const time_t first_minute = options.start_minute + options.time_offset_s;
+  EdgeExporter exporter;
+  if (!exporter.Open(filename)) return 1;
+  exporter.Begin(station, source->GetCarrierFrequencyHz(), first_minute,
+                 options.phase_modulation);
+  struct timespec start, end;
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  std::vector<ModulationEdge> edges;
+  int symbols[60];
+  for (int i = 0; i < options.minutes; ++i) {
+    const time_t minute = first_minute + 60 * i;
+    const time_t transmit_time = minute + options.offset_minutes * 60;
+    edges.clear();
+    if (options.carrier_only) {
+      edges.push_back({0, ModulationEdge::Type::POWER, CarrierPower::HIGH, 0});
+      for (int &symbol : symbols) symbol = -1;
+    } else {
+      AppendMinuteEdges(source, transmit_time, options.phase_modulation,
+                        &edges);
+      for (int s = 0; s < 60; ++s) symbols[s] = source->GetSymbolForSecond(s);
+    }
+    exporter.AddMinute(minute, transmit_time, symbols, edges);
   }
-  if (strcasecmp(n, "JJY60") == 0) {
-    return std::make_unique<JJY60TimeSignalSource>();
+  if (!exporter.Finish()) return 1;
+  clock_gettime(CLOCK_MONOTONIC, &end);
+  if (options.verbose) {
+    const double seconds =
+        (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) * 1e-9;
+    fprintf(stderr, "Exported %lld edges to %s in %.3fs (%.0f edges/s)\n",
+            (long long)exporter.edges(), filename, seconds,
+            seconds > 0 ? exporter.edges() / seconds : 0);
   }
-  if (strcasecmp(n, "MSF") == 0) return std::make_unique<MSFTimeSignalSource>();
-  return nullptr;
+  return 0;
 }
 
 int usage(const char *msg, const char *progname) {
@@ -140,7 +217,11 @@ int usage(const char *msg, const char *progname) {
           "%susage: %s [options]\n"
           "Options:\n"
           "\t-s <service>          : Service; one of "
-          "'DCF77', 'WWVB', 'JJY40', 'JJY60', 'MSF'\n"
+          "'DCF77', 'WWVB', 'JJY40', 'JJY60', 'MSF',\n"
+          "\t                        'BPC'\n"
+          "\t-f <schedule-file>    : Play back a schedule file from "
+          "txtempus-mkschedule\n"
+          "\t                        instead of a service.\n"
           "\t-r <minutes>          : Run for limited number of minutes. "
           "(default: no limit)\n"  // in truth: a couple thousand years...
           "\t-t 'YYYY-MM-DD HH:MM' : Transmit the given local time "
@@ -149,10 +230,67 @@ int usage(const char *msg, const char *progname) {
           "(default: 0 minutes)\n"
           "\t-v                    : Verbose.\n"
           "\t-c                    : Carrier wave only.\n"
+          "\t-m                    : Phase modulation as well, if the "
+          "service has it\n"
+          "\t                        (DCF77, WWVB; Raspberry Pi only).\n"
+          "\t-w <HH:MM-HH:MM,...>  : Run as daemon, only transmitting in the "
+          "given\n"
+          "\t                        daily local time windows (end "
+          "exclusive).\n"
+          "\t-C <socket-path>      : Unix domain socket to query status and "
+          "change\n"
+          "\t                        station, offset or carrier-only mode "
+          "at runtime.\n"
+          "\t-D <runtime-us>       : Use SCHED_DEADLINE with this CPU budget "
+          "per edge\n"
+          "\t                        instead of SCHED_FIFO (e.g. 50).\n"
+          "\t-p <pps-device>       : Align seconds to a PPS source, e.g. "
+          "/dev/pps0\n"
+          "\t-g <addr:port[/if]>   : Transmit in phase with other txtempus "
+          "in this\n"
+          "\t                        multicast group, e.g. "
+          "239.255.77.77:7777\n"
+          "\t-i <node-id>          : Id in the group; the highest one leads. "
+          "(default: pid)\n"
+          "\t-q <max-error-ms>     : Only send time if the clock is "
+          "synchronized with\n"
+          "\t                        at most this error, else carrier only "
+          "(e.g. 100).\n"
+          "\t-l <budget-us>        : Edges later than this are missed "
+          "(default: %d).\n"
+          "\t-x <policy>           : On a missed edge: 'blank' the rest of the "
+          "minute,\n"
+          "\t                        'stretch' the rest of the second or "
+          "'abort'.\n"
+          "\t                        (default: blank)\n"
+          "\t-L <latency-us>       : Limit CPU wakeup latency via "
+          "/dev/cpu_dma_latency\n"
+          "\t                        shortly before each edge (e.g. 0).\n"
+          "\t-G                    : Pin the cpufreq governor to "
+          "'performance' while\n"
+          "\t                        transmitting.\n"
+          "\t-T                    : Write trace records to the ftrace "
+          "trace_marker.\n"
+          "\t-F <file>             : Keep a record of the transmitted edges in "
+          "this\n"
+          "\t                        ring file (see txtempus-flightrec).\n"
+          "\t-b                    : Benchmark: run the transmit loop "
+          "without hardware\n"
+          "\t                        and report wakeup latency (default "
+          "-r 1).\n"
+          "\t-S <stressors>        : With -b, load the system with any of "
+          "'cpu,mem,io'.\n"
+          "\t-H                    : Benchmark the hardware calls of this "
+          "platform.\n"
           "\t-n                    : Dryrun, only showing modulation "
           "envelope.\n"
+          "\t-o <file>             : With -n, write all edges of the minutes "
+          "(-r, default\n"
+          "\t                        1) to this file instead; VCD for *.vcd, "
+          "else JSON\n"
+          "\t                        lines.\n"
           "\t-h                    : This help.\n",
-          msg, progname);
+          msg, progname, kDefaultLatenessBudgetMicros);
   return 1;
 }
 
@@ -160,96 +298,258 @@ int usage(const char *msg, const char *progname) {
 
 int main(int argc, char *argv[]) {
   const time_t now = TruncateTo(time(nullptr), 60);  // Time: full minute
+  Transmitter::Options options;
+  options.start_minute = now;
   std::unique_ptr<TimeSignalSource> time_source{};
   time_t chosen_time = now;
-  int zone_offset = 0;
-  int ttl = INT_MAX;
+  const char *station_name = nullptr;
+  const char *control_socket_path = nullptr;
+  const char *pps_device = nullptr;
+  const char *schedule_file = nullptr;
+  int max_latency_us = -1;
+  bool pin_governor = false;
+  const char *stressor_spec = nullptr;
+  bool hardware_benchmark = false;
+  const char *flight_recorder_file = nullptr;
+  const char *cluster_group = nullptr;
+  const char *export_file = nullptr;
+  uint32_t node_id = getpid();
+  bool have_node_id = false;
   int opt;
-  while ((opt = getopt(argc, argv, "t:z:r:vs:hnc")) != -1) {
+  while ((opt = getopt(argc, argv,
+                       "t:z:r:vs:f:hncmw:C:TD:p:L:GbS:Hl:x:F:q:g:i:o:")) !=
+         -1) {
     switch (opt) {
       case 'v':
-        verbose = true;
+        options.verbose = true;
         break;
       case 't':
         chosen_time = ParseLocalTime(optarg);
         if (chosen_time <= 0) return usage("Invalid time string\n", argv[0]);
         break;
       case 'z':
-        zone_offset = atoi(optarg);
+        options.offset_minutes = atoi(optarg);
         break;
       case 'r':
-        ttl = atoi(optarg);
+        options.minutes = atoi(optarg);
         break;
       case 's':
-        time_source = CreateTimeSourceFromName(optarg);
+        time_source = CreateTimeSignalSource(optarg);
+        station_name = optarg;
+        break;
+      case 'f':
+        schedule_file = optarg;
         break;
       case 'n':
-        dryrun = true;
-        verbose = true;
-        ttl = 1;
+        options.dryrun = true;
+        options.verbose = true;
+        options.minutes = 1;
+        break;
+      case 'o':
+        export_file = optarg;
         break;
       case 'c':
-        carrier_only = true;
+        options.carrier_only = true;
+        break;
+      case 'm':
+        options.phase_modulation = true;
+        break;
+      case 'w':
+        if (!options.schedule.AddWindows(optarg)) {
+          return usage("Invalid transmit window\n", argv[0]);
+        }
+        break;
+      case 'C':
+        control_socket_path = optarg;
+        break;
+      case 'D':
+        options.deadline_runtime_us = atoi(optarg);
+        if (options.deadline_runtime_us <= 0) {
+          return usage("Invalid SCHED_DEADLINE runtime\n", argv[0]);
+        }
+        break;
+      case 'p':
+        pps_device = optarg;
+        break;
+      case 'L':
+        max_latency_us = atoi(optarg);
+        if (max_latency_us < 0) {
+          return usage("Invalid wakeup latency\n", argv[0]);
+        }
+        break;
+      case 'G':
+        pin_governor = true;
+        break;
+      case 'b':
+        options.benchmark = true;
+        break;
+      case 'S':
+        stressor_spec = optarg;
+        break;
+      case 'H':
+        hardware_benchmark = true;
+        break;
+      case 'l':
+        options.lateness_budget_us = atoi(optarg);
+        if (options.lateness_budget_us <= 0) {
+          return usage("Invalid lateness budget\n", argv[0]);
+        }
+        break;
+      case 'q':
+        options.max_clock_error_us = atof(optarg) * 1000;
+        if (options.max_clock_error_us <= 0) {
+          return usage("Invalid clock error limit\n", argv[0]);
+        }
+        break;
+      case 'F':
+        flight_recorder_file = optarg;
+        break;
+      case 'g':
+        cluster_group = optarg;
+        break;
+      case 'i':
+        node_id = strtoul(optarg, nullptr, 10);
+        if (node_id == 0) return usage("Invalid node id\n", argv[0]);
+        have_node_id = true;
+        break;
+      case 'x':
+        if (strcasecmp(optarg, "blank") == 0) {
+          options.miss_policy = MissPolicy::BLANK;
+        } else if (strcasecmp(optarg, "stretch") == 0) {
+          options.miss_policy = MissPolicy::STRETCH;
+        } else if (strcasecmp(optarg, "abort") == 0) {
+          options.miss_policy = MissPolicy::ABORT;
+        } else {
+          return usage("Invalid miss policy\n", argv[0]);
+        }
+        break;
+      case 'T':
+        if (!OpenTraceMarker()) {
+          fprintf(stderr, "Can't open ftrace trace_marker\n");
+          return 1;
+        }
         break;
       default:
         return usage("", argv[0]);
     }
   }
 
-  chosen_time += zone_offset * (time_t)60;
-  const int time_offset = chosen_time - now;
+  const bool dryrun = options.dryrun;
+  const bool benchmark = options.benchmark;
+  if (hardware_benchmark && (dryrun || benchmark)) {
+    return usage("The hardware benchmark needs the hardware\n", argv[0]);
+  }
+  if (benchmark && dryrun) {
+    return usage("Benchmark and dryrun don't go together\n", argv[0]);
+  }
+  if (stressor_spec && !benchmark) {
+    return usage("Stressors are only for benchmark mode\n", argv[0]);
+  }
+  if (export_file && !dryrun) {
+    return usage("Exporting edges (-o) needs dryrun (-n)\n", argv[0]);
+  }
+  if (have_node_id && !cluster_group) {
+    return usage("Node id only makes sense in a group (-g)\n", argv[0]);
+  }
+  if (benchmark && options.minutes == INT_MAX) options.minutes = 1;
+
+  options.time_offset_s = chosen_time - now;
+
+  if (schedule_file) {
+    auto file_source = std::make_unique<ScheduleFileSource>();
+    if (!file_source->Open(schedule_file)) return 1;
+    station_name = file_source->header().station;
+    time_source = std::move(file_source);
+  }
 
   if (!time_source) {
     return usage("Please choose a service name with -s option\n", argv[0]);
   }
 
-  HardwareControl hw{};
-  if (!dryrun && !hw.Init()) {
+  if (export_file) {
+    return ExportEdges(options, time_source.get(), station_name, export_file);
+  }
+
+  const char *platform = HardwareControl::DetectPlatform();
+  std::unique_ptr<HardwareControl> hardware = HardwareControl::Create(platform);
+  if (!hardware) {
+    fprintf(stderr, "Platform %s not available; built with %s\n", platform,
+            HardwareControl::AvailablePlatforms());
+    return 1;
+  }
+  if (options.verbose && !dryrun) fprintf(stderr, "Platform: %s\n", platform);
+  if (!dryrun && !benchmark && !hardware->Init()) {
     fprintf(stderr, "Initialization failed\n");
     return 1;
   }
 
-  signal(SIGTERM, InterruptHandler);
-  signal(SIGINT, InterruptHandler);
-
-  // Make sure the kernel knows that we're serious about accuracy of sleeps.
-  struct sched_param sp;  // NOLINT(misc-include-cleaner) is in sched.h
-  sp.sched_priority = 99;
-  sched_setscheduler(0, SCHED_FIFO, &sp);
-
-  StartCarrier(&hw, time_source->GetCarrierFrequencyHz());
-
-  struct timespec target_wait;
-  for (time_t minute_start = now; !interrupted && ttl--; minute_start += 60) {
-    const time_t transmit_time = minute_start + time_offset;
-    if (verbose) PrintLocalTime(transmit_time);
-    if (dryrun) fprintf(stderr, " -> tx-modulation\n");
-    time_source->PrepareMinute(transmit_time);
-
-    for (int second = 0; second < 60 && !interrupted; ++second) {
-      const TimeSignalSource::SecondModulation &modulation =
-          time_source->GetModulationForSecond(second);
-
-      // First, let's wait until we reach the beginning of that second
-      target_wait.tv_sec = minute_start + second;
-      target_wait.tv_nsec = 0;
-      WaitUntil(target_wait);
-      if (interrupted) break;
-
-      if (verbose) fprintf(stderr, "\b\b\b:%02d", second);
-
-      // Depending on the time source, there can be multiple amplitude
-      // modulation changes per second.
-      for (const ModulationDuration &m : modulation) {
-        SetTxPower(&hw, m.power);
-        if (m.duration_ms == 0) break;  // last one.
-        target_wait.tv_nsec += m.duration_ms * 1000000L;
-        WaitUntil(target_wait);
-      }
-      if (dryrun) PrintModulationChart(modulation);
-    }
-    if (verbose) fprintf(stderr, "\n");
+  if (hardware_benchmark) {
+    DispatchBackend(hardware.get(), [&](auto *hw) {
+      RunHardwareBenchmark(hw, time_source->GetCarrierFrequencyHz());
+    });
+    return 0;
   }
 
-  if (!dryrun) hw.StopClock();
+  PPSSource pps;
+  if (pps_device && !dryrun) {
+    if (!pps.Open(pps_device)) return 1;
+    options.pps = &pps;
+  }
+
+  LatencyQoS qos;
+  if (max_latency_us >= 0 && !dryrun) {
+    if (!qos.Open(max_latency_us)) return 1;
+    options.latency_qos = &qos;
+  }
+
+  FlightRecorder recorder;
+  if (flight_recorder_file && !dryrun) {
+    if (!recorder.Open(flight_recorder_file)) return 1;
+    options.recorder = &recorder;
+  }
+
+  GovernorPin governor;
+  if (pin_governor && !dryrun) {
+    if (!governor.Init()) return 1;
+    options.governor = &governor;
+  }
+
+  // Edges in a minute: up to two per second, but phase modulation can have
+  // many more; the vector grows if needed.
+  LatencyStats stats(benchmark ? options.minutes * 120 : 0);
+  if (benchmark) options.wakeup_stats = &stats;
+
+  std::unique_ptr<ControlSocket> control;
+  if (control_socket_path) {
+    control = std::make_unique<ControlSocket>(&CreateTimeSignalSource);
+    options.control = control.get();
+  }
+
+  std::unique_ptr<Cluster> cluster;
+  if (cluster_group) {
+    cluster = std::make_unique<Cluster>(node_id);
+    if (!cluster->Open(cluster_group)) return 1;
+    options.cluster = cluster.get();
+  }
+
+  Transmitter transmitter(options, hardware.get(), std::move(time_source),
+                          station_name);
+  // Needs to be set up before other threads are started, so that they don't
+  // receive the signals.
+  if (!transmitter.Init()) return 1;
+
+  Stressors stressors;
+  if (stressor_spec && !stressors.Start(stressor_spec)) return 1;
+
+  if (control && !control->Start(control_socket_path)) return 1;
+
+  const bool success = transmitter.Run();
+
+  stressors.Stop();
+  if (benchmark) {
+    PrintBenchmarkReport(&stats, transmitter.scheduling(), stressor_spec,
+                         options.latency_qos != nullptr,
+                         options.lateness_budget_us);
+  }
+  return success ? 0 : 1;
 }
@@ -15,49 +15,139 @@
 
 #include <cstdint>
 #include <ctime>
+#include <iterator>
 
 #include "carrier-power.h"
+#include "station-spec.h"
 #include "time-signal-source.h"
 
-// WWVB uses BCD, but always has a zero bit between the digits.
-// So let's call it 'padded' BCD.
-static uint64_t to_padded5_bcd(int n) {
-  return (((n / 100) % 10) << 10) | (((n / 10) % 10) << 5) | (n % 10);
+// https://en.wikipedia.org/wiki/WWVB
+// Big endian bits. WWVB uses BCD, but always has a zero bit between the
+// digits. Time is always sent in UTC; only the DST bits refer to local time.
+static constexpr FieldSpec kWWVBFields[] = {
+    {FieldValue::MINUTE, FieldEncoding::PADDED_BCD, 1, 8},
+    {FieldValue::HOUR, FieldEncoding::PADDED_BCD, 12, 7},
+    {FieldValue::DAY_OF_YEAR, FieldEncoding::PADDED_BCD, 22, 12},
+    {FieldValue::YEAR_OF_CENTURY, FieldEncoding::PADDED_BCD, 45, 9},
+    {FieldValue::LEAP_YEAR, FieldEncoding::BINARY, 55, 1},
+    {FieldValue::DST_TOMORROW, FieldEncoding::BINARY, 57, 1},
+    {FieldValue::DST, FieldEncoding::BINARY, 58, 1},
+};
+
+static constexpr PulseSpec kWWVBSymbols[] = {
+    {2, {{CarrierPower::LOW, Millis(200)}, {CarrierPower::HIGH, 0}}},
+    {2, {{CarrierPower::LOW, Millis(500)}, {CarrierPower::HIGH, 0}}},
+};
+
+static constexpr StationSpec kWWVBSpec = {
+    /*time_offset_seconds=*/0,
+    /*utc=*/true,
+    /*msb_first=*/true,
+    /*frame_seconds=*/60,
+    /*bits_per_second=*/1,
+    kWWVBFields,
+    std::size(kWWVBFields),
+    nullptr,
+    0,
+    /*marker_seconds=*/(1ULL << 0) | (1ULL << 9) | (1ULL << 19) |
+        (1ULL << 29) | (1ULL << 39) | (1ULL << 49) | (1ULL << 59),
+    /*marker=*/{2, {{CarrierPower::LOW, Millis(800)}, {CarrierPower::HIGH, 0}}},
+    kWWVBSymbols,
+};
+
+// -- Phase modulation time code (NIST "Enhanced WWVB Broadcast Format", 2012)
+// One bit per second, sent as 180 degree phase reversal. Carries the
+// minute of the century, protected with a Hamming code, and DST state.
+
+static constexpr uint64_t kPhaseSyncT = 0x768;       // 13 bits, second 0-12.
+static constexpr time_t kCenturyStart = 946684800;  // 2000-01-01 00:00 UTC
+
+// Bits of the minute of century contributing to the five parity bits.
+static constexpr uint32_t kTimeParityMask[5] = {
+    // time[23,21,20,17,16,15,14,13,9,8,6,5,4,2,0]
+    (1 << 23) | (1 << 21) | (1 << 20) | (1 << 17) | (1 << 16) | (1 << 15) |
+        (1 << 14) | (1 << 13) | (1 << 9) | (1 << 8) | (1 << 6) | (1 << 5) |
+        (1 << 4) | (1 << 2) | (1 << 0),
+    // time[24,22,21,18,17,16,15,14,10,9,7,6,5,3,1]
+    (1 << 24) | (1 << 22) | (1 << 21) | (1 << 18) | (1 << 17) | (1 << 16) |
+        (1 << 15) | (1 << 14) | (1 << 10) | (1 << 9) | (1 << 7) | (1 << 6) |
+        (1 << 5) | (1 << 3) | (1 << 1),
+    // time[25,23,22,19,18,17,16,15,11,10,8,7,6,4,2]
+    (1 << 25) | (1 << 23) | (1 << 22) | (1 << 19) | (1 << 18) | (1 << 17) |
+        (1 << 16) | (1 << 15) | (1 << 11) | (1 << 10) | (1 << 8) | (1 << 7) |
+        (1 << 6) | (1 << 4) | (1 << 2),
+    // time[24,21,19,18,15,14,13,12,11,7,6,4,3,2,0]
+    (1 << 24) | (1 << 21) | (1 << 19) | (1 << 18) | (1 << 15) | (1 << 14) |
+        (1 << 13) | (1 << 12) | (1 << 11) | (1 << 7) | (1 << 6) | (1 << 4) |
+        (1 << 3) | (1 << 2) | (1 << 0),
+    // time[25,22,20,19,16,15,14,13,12,8,7,5,4,3,1]
+    (1 << 25) | (1 << 22) | (1 << 20) | (1 << 19) | (1 << 16) | (1 << 15) |
+        (1 << 14) | (1 << 13) | (1 << 12) | (1 << 8) | (1 << 7) | (1 << 5) |
+        (1 << 4) | (1 << 3) | (1 << 1),
+};
+
+// 5-bit code for DST state (bit 57, 58 in the amplitude modulation) without
+// leap second warning.
+static constexpr uint64_t kPhaseDstCode[4] = {0b01000, 0b10101, 0b10110,
+                                              0b00011};
+
+static uint64_t bit_parity(uint32_t value) {
+  return __builtin_popcount(value) & 0x1;
 }
 
-static uint64_t is_leap_year(int year) {
-  return year % 4 == 0 && (year % 100 != 0 || year % 400 == 0);
+// Place "count" bits of "value", most significant first, starting at the
+// given second.
+static uint64_t place_bits(uint64_t value, int first_second, int count) {
+  return (value & ((1ULL << count) - 1)) << (59 - (first_second + count - 1));
+}
+
+static uint64_t phase_time_code(time_t t, int dst) {
+  const uint32_t moc = (t - kCenturyStart) / 60;  // minute of century
+  uint32_t time_parity = 0;
+  for (int i = 0; i < 5; ++i) {
+    time_parity |= bit_parity(moc & kTimeParityMask[i]) << i;
+  }
+  const uint64_t dst_code = kPhaseDstCode[dst];
+
+  uint64_t bits = 0;
+  bits |= place_bits(kPhaseSyncT, 0, 13);
+  bits |= place_bits(time_parity, 13, 5);
+  bits |= place_bits(moc >> 25, 18, 1);
+  bits |= place_bits(moc, 19, 1);
+  bits |= place_bits(moc >> 16, 20, 9);  // time[24:16]
+  // second 29: reserved, zero.
+  bits |= place_bits(moc >> 7, 30, 9);  // time[15:7]
+  bits |= place_bits(1, 39, 1);         // reserved, one.
+  bits |= place_bits(moc, 40, 7);       // time[6:0]
+  bits |= place_bits(dst_code >> 3, 47, 2);
+  bits |= place_bits(1, 49, 1);  // notice
+  bits |= place_bits(dst_code, 50, 3);
+  // second 53..58: schedule of the next DST change; not set.
+  return bits;
 }
 
 void WWVBTimeSignalSource::PrepareMinute(time_t t) {
-  struct tm breakdown;
-  struct tm tomorrow;
-  time_t tomorrow_t;
-  gmtime_r(&t, &breakdown);  // Time transmission is always in UTC.
-
-  // https://en.wikipedia.org/wiki/WWVB
-  // The WWVB format uses Bit-Bigendianess, so we'll start with the first
-  // bit left in our integer in bit 59.
-  time_bits_ = 0;  // All the unused bits are zero.
-  time_bits_ |= to_padded5_bcd(breakdown.tm_min) << (59 - 8);
-  time_bits_ |= to_padded5_bcd(breakdown.tm_hour) << (59 - 18);
-  time_bits_ |= to_padded5_bcd(breakdown.tm_yday + 1) << (59 - 33);
-  time_bits_ |= to_padded5_bcd(breakdown.tm_year % 100) << (59 - 53);
-  time_bits_ |= is_leap_year(breakdown.tm_year + 1900) << (59 - 55);
-
-  // Need local time for now and tomorrow to determine DST status.
-  localtime_r(&t, &breakdown);
-  tomorrow_t = t + 86400;
-  localtime_r(&tomorrow_t, &tomorrow);
-  time_bits_ |= (tomorrow.tm_isdst ? 1 : 0) << (59 - 57);
-  time_bits_ |= (breakdown.tm_isdst ? 1 : 0) << (59 - 58);
+  EncodeSpecMinute<kWWVBSpec>(t, &calendars_, symbols_);
+  const uint64_t phase_bits =
+      phase_time_code(t, (symbols_[57] ? 2 : 0) | (symbols_[58] ? 1 : 0));
+  // Phase is reversed for one bits; changes at the beginning of the second.
+  for (int sec = 0; sec < 60; ++sec) {
+    const bool bit = phase_bits & (1LL << (59 - sec));
+    phase_[sec] = {0, bit ? 180.0 : 0.0};
+  }
 }
 
-TimeSignalSource::SecondModulation WWVBTimeSignalSource::GetModulationForSecond(
+TimeSignalSource::ModulationSpan WWVBTimeSignalSource::GetModulationSpan(
     int sec) {
-  if (sec == 0 || sec % 10 == 9 || sec > 59) {
-    return {{CarrierPower::LOW, 800}, {CarrierPower::HIGH, 0}};
-  }
-  const bool bit = time_bits_ & (1LL << (59 - sec));
-  return {{CarrierPower::LOW, bit ? 500 : 200}, {CarrierPower::HIGH, 0}};
+  return SpecModulationForSecond<kWWVBSpec>(symbols_, sec);
+}
+
+int WWVBTimeSignalSource::GetSymbolForSecond(int sec) const {
+  return SpecSymbolForSecond<kWWVBSpec>(symbols_, sec);
+}
+
+TimeSignalSource::PhaseSpan WWVBTimeSignalSource::GetPhaseSpan(int sec) {
+  static constexpr PhaseChange kUnmodulated = {0, 0.0};
+  if (sec > 59) return {&kUnmodulated, &kUnmodulated + 1};
+  return {&phase_[sec], &phase_[sec] + 1};
 }
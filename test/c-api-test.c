@@ -0,0 +1,99 @@
+// -*- mode: c; c-basic-offset: 2; indent-tabs-mode: nil; -*-
+// Part of txtempus, a LF time signal transmitter.
+// Copyright (C) 2018 Henner Zeller <h.zeller@acm.org>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+
+// Uses libtxtempus through its C interface only, compiled as C, to make
+// sure include/txtempus.h stays usable from C: encodes a known WWVB minute
+// and checks its frame and edge schedule.
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "txtempus.h"
+
+static int check_failures = 0;
+
+#define CHECK(condition)                                               \
+  do {                                                                 \
+    if (!(condition)) {                                                \
+      fprintf(stderr, "%s:%d: Check failed: %s\n", __FILE__, __LINE__, \
+              #condition);                                             \
+      ++check_failures;                                                \
+    }                                                                  \
+  } while (0)
+
+// 2018-08-17 13:22 UTC; WWVB sends UTC, so this doesn't depend on TZ.
+static const time_t kMinute = 1534512120;
+
+// Symbols of that minute: 0, 1 or -1 for markers.
+static const int kSymbols[60] = {
+    -1, 0, 1, 0, 0, 0, 0, 1, 0, -1, 0, 0, 0, 1, 0, 0, 0, 1, 1, -1,
+    0,  0, 1, 0, 0, 0, 0, 1, 0, -1, 1, 0, 0, 1, 0, 0, 0, 0, 0, -1,
+    0,  0, 0, 0, 0, 0, 0, 0, 1, -1, 1, 0, 0, 0, 0, 0, 0, 0, 0, -1};
+
+// Reduced carrier for 200ms (0), 500ms (1) or 800ms (marker), then full.
+static int64_t PulseNanos(int second) {
+  const int symbol = kSymbols[second];
+  return (symbol < 0 ? 800 : symbol ? 500 : 200) * 1000000LL;
+}
+
+static void TestEncoder(void) {
+  CHECK(txtempus_api_version() == TXTEMPUS_API_VERSION);
+  CHECK(txtempus_encoder_new("no-such-service") == NULL);
+
+  txtempus_encoder *encoder = txtempus_encoder_new("wwvb");
+  CHECK(encoder != NULL);
+  if (!encoder) return;
+  CHECK(txtempus_encoder_carrier_hz(encoder) == 60000);
+
+  txtempus_encoder_prepare_minute(encoder, kMinute);
+  for (int s = 0; s < 60; ++s) {
+    struct txtempus_modulation changes[4];
+    const int count = txtempus_encoder_get_second(encoder, s, changes, 4);
+    CHECK(count == 2);
+    if (count != 2) continue;
+    CHECK(changes[0].power == TXTEMPUS_POWER_LOW);
+    CHECK(changes[0].duration_ns == PulseNanos(s));
+    CHECK(changes[1].power == TXTEMPUS_POWER_HIGH);
+    CHECK(changes[1].duration_ns == 0);
+  }
+
+  // The same as edges: two per second, at the second and after the pulse.
+  const size_t edge_count =
+      txtempus_encoder_get_edges(encoder, kMinute, 1, 0, NULL, 0);
+  CHECK(edge_count == 120);
+  struct txtempus_edge *edges = calloc(edge_count, sizeof(*edges));
+  CHECK(txtempus_encoder_get_edges(encoder, kMinute, 1, 0, edges,
+                                   edge_count) == edge_count);
+  for (size_t i = 0; i + 1 < edge_count && i < 120; i += 2) {
+    const int s = i / 2;
+    const int64_t second_ns = (kMinute + s) * 1000000000LL;
+    CHECK(edges[i].type == TXTEMPUS_EDGE_POWER);
+    CHECK(edges[i].power == TXTEMPUS_POWER_LOW);
+    CHECK(edges[i].time_ns == second_ns);
+    CHECK(edges[i + 1].power == TXTEMPUS_POWER_HIGH);
+    CHECK(edges[i + 1].time_ns == second_ns + PulseNanos(s));
+  }
+  free(edges);
+  txtempus_encoder_free(encoder);
+}
+
+int main(void) {
+  TestEncoder();
+  if (check_failures) fprintf(stderr, "%d check(s) failed\n", check_failures);
+  return check_failures ? 1 : 0;
+}
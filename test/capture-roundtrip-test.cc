@@ -0,0 +1,169 @@
+// -*- mode: c++; c-basic-offset: 2; indent-tabs-mode: nil; -*-
+// Part of txtempus, a LF time signal transmitter.
+// Copyright (C) 2018 Henner Zeller <h.zeller@acm.org>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+//
+// Round trip through the analyzer: synthesizes a WAV capture of what the
+// encoders send for a few minutes and checks that txtempus-analyze, given as
+// argument, decodes the frames and finds every second as intended.
+
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "carrier-power.h"
+#include "test-check.h"
+#include "time-signal-source.h"
+
+static constexpr int kSampleRate = 48000;
+static constexpr int kSeconds = 155;  // Two complete minutes and a bit.
+
+// Half a minute before the first complete one.
+static time_t CaptureStart() {
+  struct tm tm = {};
+  tm.tm_year = 2026 - 1900;
+  tm.tm_mon = 2;
+  tm.tm_mday = 10;
+  tm.tm_hour = 12;
+  tm.tm_sec = 30;
+  return timegm(&tm);
+}
+
+static float Amplitude(CarrierPower power) {
+  switch (power) {
+    case CarrierPower::HIGH:
+      return 1.0f;
+    case CarrierPower::LOW:
+      return 0.15f;
+    case CarrierPower::OFF:
+      return 0.0f;
+  }
+  return 0.0f;
+}
+
+static void PutLE(FILE *f, uint32_t value, int bytes) {
+  for (int i = 0; i < bytes; ++i) fputc((value >> (8 * i)) & 0xff, f);
+}
+
+// Mono 16 bit WAV of the carrier as sent by "source", starting at "start".
+static bool WriteCapture(TimeSignalSource *source, time_t start,
+                         const char *filename) {
+  FILE *f = fopen(filename, "wb");
+  if (!f) {
+    perror(filename);
+    return false;
+  }
+  const uint32_t data_bytes = 2u * kSampleRate * kSeconds;
+  fputs("RIFF", f);
+  PutLE(f, 36 + data_bytes, 4);
+  fputs("WAVEfmt ", f);
+  PutLE(f, 16, 4);
+  PutLE(f, 1, 2);  // PCM
+  PutLE(f, 1, 2);  // Channels
+  PutLE(f, kSampleRate, 4);
+  PutLE(f, 2 * kSampleRate, 4);
+  PutLE(f, 2, 2);
+  PutLE(f, 16, 2);
+  fputs("data", f);
+  PutLE(f, data_bytes, 4);
+
+  const double omega =
+      2 * M_PI * source->GetCarrierFrequencyHz() / kSampleRate;
+  std::vector<int16_t> samples(kSampleRate);
+  time_t prepared = -1;
+  for (int s = 0; s < kSeconds; ++s) {
+    const time_t second = start + s;
+    const time_t minute = second - second % 60;
+    if (minute != prepared) {
+      source->PrepareMinute(minute);
+      prepared = minute;
+    }
+    int n = 0;
+    for (const ModulationDuration &m :
+         source->GetModulationForSecond(second % 60)) {
+      const int end = m.duration_ns == 0
+                          ? kSampleRate
+                          : n + (int64_t)m.duration_ns * kSampleRate /
+                                    kNanosPerSecond;
+      for (/**/; n < end && n < kSampleRate; ++n) {
+        const int64_t frame = (int64_t)s * kSampleRate + n;
+        samples[n] = lround(20000 * Amplitude(m.power) *
+                            sin(omega * (frame % kSampleRate)));
+      }
+      if (m.duration_ns == 0) break;
+    }
+    if (fwrite(samples.data(), sizeof(int16_t), samples.size(), f) !=
+        samples.size()) {
+      perror(filename);
+      fclose(f);
+      return false;
+    }
+  }
+  return fclose(f) == 0;
+}
+
+// Runs the analyzer on the capture; returns the decoded frames, or -1 if it
+// reported a problem.
+static int Analyze(const char *analyzer, const char *service,
+                   const char *filename) {
+  const std::string command = std::string(analyzer) + " -s " + service +
+                              " -y 2026 -j 1 " + filename;
+  FILE *out = popen(command.c_str(), "r");
+  if (!out) return -1;
+  int frames = -1;
+  char line[256];
+  while (fgets(line, sizeof(line), out)) {
+    fputs(line, stderr);
+    sscanf(line, "Frames: %d decoded", &frames);
+  }
+  const int status = pclose(out);
+  if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) return -1;
+  return frames;
+}
+
+int main(int argc, char *argv[]) {
+  if (argc != 2) {
+    fprintf(stderr, "usage: %s <txtempus-analyze>\n", argv[0]);
+    return 1;
+  }
+  char filename[] = "/tmp/txtempus-capture-XXXXXX";
+  const int fd = mkstemp(filename);
+  if (fd < 0) {
+    perror("mkstemp");
+    return 1;
+  }
+  close(fd);
+
+  for (const char *service : {"DCF77", "WWVB", "JJY40", "MSF", "BPC"}) {
+    std::unique_ptr<TimeSignalSource> source = CreateTimeSignalSource(service);
+    CHECK(source != nullptr);
+    if (!source) continue;
+    CHECK(WriteCapture(source.get(), CaptureStart(), filename));
+    const int frames = Analyze(argv[1], service, filename);
+    if (frames < 2) fprintf(stderr, "%s: %d frames decoded\n", service, frames);
+    CHECK(frames >= 2);
+  }
+  unlink(filename);
+  return CheckResult();
+}
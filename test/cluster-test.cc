@@ -0,0 +1,267 @@
+// -*- mode: c++; c-basic-offset: 2; indent-tabs-mode: nil; -*-
+// Part of txtempus, a LF time signal transmitter.
+// Copyright (C) 2018 Henner Zeller <h.zeller@acm.org>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+
+// Two nodes in one process, talking through multicast on the loopback
+// interface: leader election, time base, frame handoff, and frames and
+// heartbeats put together byte by byte, as sent by other versions.
+// Skipped if loopback doesn't do multicast.
+
+#include <arpa/inet.h>
+#include <net/if.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <memory>
+#include <string>
+
+#include "cluster.h"
+#include "test-check.h"
+#include "time-signal-source.h"
+
+static const char kGroupAddress[] = "239.255.77.77";
+static constexpr time_t kMinute = 1534512120;  // 2018-08-17 13:22 UTC
+
+// Wire format, spelled out independently of cluster.cc.
+struct WireHeader {
+  char magic[4];
+  uint8_t type;  // 1: heartbeat, 2: frame
+  uint8_t reserved[3];
+  uint32_t node_id;
+  uint32_t reserved2;
+  int64_t sent_ns;
+  char station[16];
+};
+static_assert(sizeof(WireHeader) == 40, "Unexpected padding");
+
+struct WireFrame {
+  WireHeader header;
+  int64_t minute;
+  int64_t transmit_time;
+  struct {
+    uint32_t duration_ns[4];
+    uint8_t power[4];  // 0xff after the last change.
+  } seconds[60];
+};
+static_assert(sizeof(WireFrame) == 1256, "Unexpected padding");
+
+// Sends hand-made messages to the group.
+class RawSender {
+ public:
+  explicit RawSender(int port) {
+    addr_.sin_family = AF_INET;
+    addr_.sin_port = htons(port);
+    inet_pton(AF_INET, kGroupAddress, &addr_.sin_addr);
+    fd_ = socket(AF_INET, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+    struct ip_mreqn interface = {};
+    interface.imr_ifindex = if_nametoindex("lo");
+    setsockopt(fd_, IPPROTO_IP, IP_MULTICAST_IF, &interface,
+               sizeof(interface));
+  }
+  ~RawSender() { close(fd_); }
+
+  void Send(const void *message, size_t size) {
+    CHECK(sendto(fd_, message, size, 0, (struct sockaddr *)&addr_,
+                 sizeof(addr_)) == (ssize_t)size);
+  }
+
+  void SendHeartbeat(uint32_t node_id) {
+    WireHeader header = {};
+    FillHeader(1, node_id, &header);
+    Send(&header, sizeof(header));
+  }
+
+  static void FillHeader(uint8_t type, uint32_t node_id, WireHeader *header) {
+    memcpy(header->magic, "TXCL", 4);
+    header->type = type;
+    header->node_id = node_id;
+    snprintf(header->station, sizeof(header->station), "DCF77");
+    struct timespec now;
+    clock_gettime(CLOCK_REALTIME, &now);
+    header->sent_ns = now.tv_sec * 1000000000LL + now.tv_nsec;
+  }
+
+ private:
+  int fd_;
+  struct sockaddr_in addr_ = {};
+};
+
+// Handle what arrives within a short while.
+static void Receive(Cluster *a, Cluster *b) {
+  for (int i = 0; i < 5; ++i) {
+    struct pollfd fds[2] = {{a->fd(), POLLIN, 0}, {b->fd(), POLLIN, 0}};
+    if (poll(fds, 2, 20) <= 0) break;
+    a->HandleMessages();
+    b->HandleMessages();
+  }
+}
+
+static bool SameSeconds(const Cluster::Frame &a, const Cluster::Frame &b) {
+  for (int s = 0; s < 60; ++s) {
+    if (a.seconds[s].count != b.seconds[s].count) return false;
+    for (int i = 0; i < a.seconds[s].count; ++i) {
+      if (a.seconds[s].changes[i].power != b.seconds[s].changes[i].power ||
+          a.seconds[s].changes[i].duration_ns !=
+              b.seconds[s].changes[i].duration_ns) {
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+static void TestFrameHandoff(Cluster *follower, Cluster *leader) {
+  // Enough heartbeats for the follower to trust the leader's clock, which is
+  // the same as its own here; the first one was sent in main().
+  for (int i = 1; i < 4; ++i) {
+    CHECK(!follower->have_time_base());
+    leader->SendHeartbeat("DCF77");
+    Receive(follower, leader);
+  }
+  CHECK(follower->have_time_base());
+  CHECK(follower->leader_offset_ns() >= 0);
+  CHECK(follower->leader_offset_ns() < 50 * 1000000);
+
+  std::unique_ptr<TimeSignalSource> source = CreateTimeSignalSource("DCF77");
+  Cluster::Frame sent;
+  sent.minute = kMinute;
+  sent.transmit_time = kMinute + 3600;
+  snprintf(sent.station, sizeof(sent.station), "DCF77");
+  source->PrepareMinute(sent.transmit_time);
+  for (int s = 0; s < 60; ++s) {
+    CHECK(sent.SetSecond(s, source->GetModulationForSecond(s)));
+  }
+  CHECK(leader->PublishFrame(sent));
+  Receive(follower, leader);
+
+  Cluster::Frame taken;
+  CHECK(!follower->TakeFrame(kMinute + 60, &taken));
+  CHECK(follower->TakeFrame(kMinute, &taken));
+  CHECK(taken.minute == kMinute);
+  CHECK(taken.transmit_time == kMinute + 3600);
+  CHECK(strcmp(taken.station, "DCF77") == 0);
+  CHECK(SameSeconds(taken, sent));
+}
+
+// Frames made by hand: a valid one is taken, one that doesn't make sense
+// is dropped.
+static void TestWireFrames(Cluster *follower, Cluster *leader, int port) {
+  RawSender sender(port);
+  auto MakeFrame = [&](time_t minute, WireFrame *frame) {
+    memset(frame, 0, sizeof(*frame));
+    RawSender::FillHeader(2, leader->node_id(), &frame->header);
+    frame->minute = minute;
+    frame->transmit_time = minute;
+    for (auto &second : frame->seconds) {
+      memset(second.power, 0xff, sizeof(second.power));
+      second.power[0] = 0;  // OFF for 100ms, then HIGH.
+      second.duration_ns[0] = 100000000;
+      second.power[1] = 2;
+    }
+  };
+  Cluster::Frame taken;
+  WireFrame frame;
+
+  MakeFrame(kMinute + 120, &frame);
+  sender.Send(&frame, sizeof(frame));
+  Receive(follower, leader);
+  CHECK(follower->TakeFrame(kMinute + 120, &taken));
+  CHECK(taken.seconds[59].count == 2);
+  CHECK(taken.seconds[59].changes[0].power == CarrierPower::OFF);
+  CHECK(taken.seconds[59].changes[0].duration_ns == 100000000);
+  CHECK(taken.seconds[59].changes[1].power == CarrierPower::HIGH);
+
+  MakeFrame(kMinute + 180, &frame);
+  frame.seconds[7].power[1] = 7;  // No such power.
+  sender.Send(&frame, sizeof(frame));
+  MakeFrame(kMinute + 240, &frame);
+  frame.seconds[8].duration_ns[1] = 950000000;  // Longer than a second.
+  frame.seconds[8].power[2] = 2;
+  sender.Send(&frame, sizeof(frame));
+  MakeFrame(kMinute + 300, &frame);
+  frame.seconds[9].power[0] = 0xff;  // No changes at all.
+  sender.Send(&frame, sizeof(frame));
+  sender.Send(&frame, sizeof(frame) - 1);  // Truncated.
+  Receive(follower, leader);
+  CHECK(!follower->TakeFrame(kMinute + 180, &taken));
+  CHECK(!follower->TakeFrame(kMinute + 240, &taken));
+  CHECK(!follower->TakeFrame(kMinute + 300, &taken));
+
+  // Only frames from the leader are taken.
+  MakeFrame(kMinute + 360, &frame);
+  frame.header.node_id = follower->node_id() + 1000;
+  sender.Send(&frame, sizeof(frame));
+  Receive(follower, leader);
+  CHECK(follower->leader_id() == follower->node_id() + 1000);
+  CHECK(follower->TakeFrame(kMinute + 360, &taken));
+}
+
+// Highest id wins; silent nodes are forgotten, and the node table doesn't
+// grow beyond its size.
+static void TestElection(Cluster *a, Cluster *b, int port) {
+  RawSender sender(port);
+  for (uint32_t id = 5000; id < 5000 + 2 * Cluster::kMaxNodes; ++id) {
+    sender.SendHeartbeat(id);
+  }
+  Receive(a, b);
+  // Some of the first ones made it into the full table, none of the last.
+  CHECK(a->leader_id() >= 5000);
+  CHECK(a->leader_id() < 5000 + Cluster::kMaxNodes);
+  CHECK(!b->IsLeader());
+
+  // Nodes time out after three seconds without heartbeats.
+  sleep(4);
+  CHECK(a->leader_id() == a->node_id());
+  CHECK(b->IsLeader());
+  sender.SendHeartbeat(6000);
+  Receive(a, b);
+  CHECK(a->leader_id() == 6000);
+  CHECK(b->leader_id() == 6000);
+}
+
+int main() {
+  const int port = 20000 + getpid() % 20000;
+  const std::string group =
+      std::string(kGroupAddress) + ":" + std::to_string(port) + "/lo";
+  Cluster follower(1), leader(2);
+  if (!follower.Open(group.c_str()) || !leader.Open(group.c_str())) {
+    fprintf(stderr, "Can't join %s; skipping\n", group.c_str());
+    return kSkipTest;
+  }
+  follower.SendHeartbeat("DCF77");
+  leader.SendHeartbeat("DCF77");
+  Receive(&follower, &leader);
+  if (follower.leader_id() == follower.node_id()) {
+    fprintf(stderr, "No multicast on loopback; skipping\n");
+    return kSkipTest;
+  }
+  CHECK(follower.leader_id() == 2);
+  CHECK(leader.leader_id() == 2);
+  CHECK(leader.IsLeader());
+  CHECK(!follower.IsLeader());
+
+  TestFrameHandoff(&follower, &leader);
+  TestWireFrames(&follower, &leader, port);
+  TestElection(&follower, &leader, port);
+  return CheckResult();
+}
@@ -0,0 +1,177 @@
+// -*- mode: c++; c-basic-offset: 2; indent-tabs-mode: nil; -*-
+// Part of txtempus, a LF time signal transmitter.
+// Copyright (C) 2018 Henner Zeller <h.zeller@acm.org>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+// Checks what the generic backend writes to a fake sysfs PWM chip in a
+// temporary directory and, if a gpio-sim chip can be created, the value of
+// the attenuation line.
+
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+#include "carrier-power.h"
+#include "generic/generic-control.h"
+#include "test-check.h"
+
+static const char kGpioSimConfig[] = "/sys/kernel/config/gpio-sim";
+static constexpr int kSimLine = 17;
+
+static std::string ReadFile(const std::string &filename) {
+  FILE *f = fopen(filename.c_str(), "r");
+  if (!f) return "<missing>";
+  char buf[256] = {};
+  const size_t len = fread(buf, 1, sizeof(buf) - 1, f);
+  fclose(f);
+  std::string result(buf, len);
+  while (!result.empty() && result.back() == '\n') result.pop_back();
+  return result;
+}
+
+static bool WriteFile(const std::string &filename, const char *value) {
+  FILE *f = fopen(filename.c_str(), "w");
+  if (!f) return false;
+  const bool success = fputs(value, f) >= 0;
+  return (fclose(f) == 0) && success;
+}
+
+// A directory that looks like /sys/class/pwm/pwmchipN with channel 0
+// already exported.
+static std::string CreateFakePwmChip() {
+  char tmpl[] = "/tmp/txtempus-pwm-XXXXXX";
+  if (!mkdtemp(tmpl)) return "";
+  const std::string chip = tmpl;
+  mkdir((chip + "/pwm0").c_str(), 0755);
+  WriteFile(chip + "/export", "");
+  WriteFile(chip + "/pwm0/period", "0");
+  WriteFile(chip + "/pwm0/duty_cycle", "0");
+  WriteFile(chip + "/pwm0/enable", "1");  // Left on by someone else.
+  return chip;
+}
+
+static void RemoveFakePwmChip(const std::string &chip) {
+  for (const char *file : {"/pwm0/period", "/pwm0/duty_cycle", "/pwm0/enable",
+                           "/export"}) {
+    unlink((chip + file).c_str());
+  }
+  rmdir((chip + "/pwm0").c_str());
+  rmdir(chip.c_str());
+}
+
+// A simulated GPIO chip with a pull-up on our line, so that the open-drain
+// output reads back high when not attenuating.
+class GpioSim {
+ public:
+  ~GpioSim() {
+    if (dir_.empty()) return;
+    WriteFile(dir_ + "/live", "0");
+    rmdir((dir_ + "/bank0").c_str());
+    rmdir(dir_.c_str());
+  }
+
+  bool Create() {
+    struct stat s;
+    if (stat(kGpioSimConfig, &s) != 0) return false;
+    const std::string dir =
+        std::string(kGpioSimConfig) + "/txtempus-" + std::to_string(getpid());
+    if (mkdir(dir.c_str(), 0755) != 0) return false;
+    dir_ = dir;
+    if (mkdir((dir_ + "/bank0").c_str(), 0755) != 0 ||
+        !WriteFile(dir_ + "/bank0/num_lines", "32") ||
+        !WriteFile(dir_ + "/live", "1")) {
+      return false;
+    }
+    chip_ = "/dev/" + ReadFile(dir_ + "/bank0/chip_name");
+    line_dir_ = "/sys/devices/platform/" + ReadFile(dir_ + "/dev_name") + "/" +
+                ReadFile(dir_ + "/bank0/chip_name") + "/sim_gpio" +
+                std::to_string(kSimLine);
+    return WriteFile(line_dir_ + "/pull", "pull-up");
+  }
+
+  const std::string &chip() const { return chip_; }
+  std::string value() const { return ReadFile(line_dir_ + "/value"); }
+
+ private:
+  std::string dir_;
+  std::string chip_;
+  std::string line_dir_;
+};
+
+int main() {
+  const std::string pwm_chip = CreateFakePwmChip();
+  if (pwm_chip.empty()) {
+    perror("mkdtemp");
+    return 1;
+  }
+  const std::string pwm = pwm_chip + "/pwm0";
+
+  GpioSim gpio_sim;
+  const bool have_gpio_sim = gpio_sim.Create();
+  if (!have_gpio_sim) fprintf(stderr, "No gpio-sim; only checking PWM.\n");
+  setenv("TXTEMPUS_GPIO_CHIP",
+         have_gpio_sim ? gpio_sim.chip().c_str() : "none", 1);
+  setenv("TXTEMPUS_GPIO_LINE", std::to_string(kSimLine).c_str(), 1);
+  setenv("TXTEMPUS_PWM_CHIP", pwm_chip.c_str(), 1);
+  setenv("TXTEMPUS_PWM_CHANNEL", "0", 1);
+
+  {
+    GenericControl control;
+    CHECK(control.Init());
+    CHECK(ReadFile(pwm + "/enable") == "0");  // Stopped what was running.
+    CHECK(ReadFile(pwm_chip + "/export").empty());  // Already there.
+    if (have_gpio_sim) CHECK(gpio_sim.value() == "1");
+
+    CHECK_NEAR(control.StartClock(77500), 77500, 5);
+    CHECK(ReadFile(pwm + "/period") == "12903");
+    CHECK(ReadFile(pwm + "/duty_cycle") == "6451");
+    CHECK(ReadFile(pwm + "/enable") == "1");
+
+    control.SetTxPower(CarrierPower::LOW);
+    CHECK(ReadFile(pwm + "/enable") == "1");
+    if (have_gpio_sim) CHECK(gpio_sim.value() == "0");
+
+    control.SetTxPower(CarrierPower::HIGH);
+    CHECK(ReadFile(pwm + "/enable") == "1");
+    if (have_gpio_sim) CHECK(gpio_sim.value() == "1");
+
+    control.SetTxPower(CarrierPower::OFF);
+    CHECK(ReadFile(pwm + "/enable") == "0");
+    control.EnableClockOutput(true);
+    CHECK(ReadFile(pwm + "/enable") == "1");
+    control.EnableClockOutput(false);
+    CHECK(ReadFile(pwm + "/enable") == "0");
+
+    // Changing the period: no digits left over from longer old values.
+    CHECK_NEAR(control.StartClock(40000), 40000, 5);
+    CHECK(ReadFile(pwm + "/period") == "25000");
+    CHECK(ReadFile(pwm + "/duty_cycle") == "12500");
+    CHECK_NEAR(control.StartClock(60000), 60000, 5);
+    CHECK(ReadFile(pwm + "/period") == "16667");
+    CHECK(ReadFile(pwm + "/duty_cycle") == "8333");
+
+    control.StopClock();
+    CHECK(ReadFile(pwm + "/enable") == "0");
+    control.EnableClockOutput(true);  // No clock: stays off.
+    CHECK(ReadFile(pwm + "/enable") == "0");
+  }
+
+  RemoveFakePwmChip(pwm_chip);
+  return CheckResult();
+}
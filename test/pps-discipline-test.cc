@@ -0,0 +1,134 @@
+// -*- mode: c++; c-basic-offset: 2; indent-tabs-mode: nil; -*-
+// Part of txtempus, a LF time signal transmitter.
+// Copyright (C) 2018 Henner Zeller <h.zeller@acm.org>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+// Feeds PPSModel with synthetic pulse timestamps: a constant offset, a clock
+// running fast, an outlier, a clock step and pulses stopping.
+
+#include <cstdint>
+#include <ctime>
+
+#include "pps-discipline.h"
+#include "test-check.h"
+
+static constexpr time_t kStart = 1700000000;
+
+// Assert timestamp in system time of the pulse for true second "second",
+// when the system clock is "offset_ns" ahead.
+static struct timespec Pulse(time_t second, int64_t offset_ns) {
+  int64_t nanos = offset_ns;
+  while (nanos < 0) {
+    nanos += 1000000000;
+    second -= 1;
+  }
+  struct timespec ts;
+  ts.tv_sec = second + nanos / 1000000000;
+  ts.tv_nsec = nanos % 1000000000;
+  return ts;
+}
+
+static int64_t DiffNs(const struct timespec &a, const struct timespec &b) {
+  return (a.tv_sec - b.tv_sec) * 1000000000LL + (a.tv_nsec - b.tv_nsec);
+}
+
+static void TestConstantOffset() {
+  PPSModel model;
+  for (int i = 0; i < 3; ++i) CHECK(model.AddSample(Pulse(kStart + i, 250000)));
+  CHECK(!model.locked());
+  const struct timespec true_time = {kStart + 5, 0};
+  CHECK(DiffNs(model.ToSystemTime(true_time), true_time) == 0);  // Unlocked.
+
+  CHECK(model.AddSample(Pulse(kStart + 3, 250000)));
+  CHECK(model.locked());
+  CHECK_NEAR(model.offset_ns(), 250000, 1);
+  CHECK_NEAR(model.rate_ppm(), 0, 1e-6);
+  CHECK_NEAR(DiffNs(model.ToSystemTime(true_time), true_time), 250000, 1);
+}
+
+static void TestSystemClockBehind() {
+  PPSModel model;
+  for (int i = 0; i < 4; ++i) {
+    CHECK(model.AddSample(Pulse(kStart + i, -100000)));
+  }
+  CHECK(model.locked());
+  CHECK_NEAR(model.offset_ns(), -100000, 1);
+  const struct timespec true_time = {kStart + 4, 500000000};
+  CHECK_NEAR(DiffNs(model.ToSystemTime(true_time), true_time), -100000, 1);
+}
+
+static void TestRate() {
+  PPSModel model;
+  const double ppm = 20;
+  const int samples = 16;
+  for (int i = 0; i < samples; ++i) {
+    CHECK(model.AddSample(Pulse(kStart + i, 1000 + ppm * 1000 * i)));
+  }
+  const int64_t newest_offset = 1000 + ppm * 1000 * (samples - 1);
+  CHECK_NEAR(model.rate_ppm(), ppm, 0.01);
+  CHECK_NEAR(model.offset_ns(), newest_offset, 10);
+
+  // Extrapolated ten seconds after the newest pulse.
+  const struct timespec true_time = {kStart + samples - 1 + 10, 0};
+  CHECK_NEAR(DiffNs(model.ToSystemTime(true_time), true_time),
+             newest_offset + ppm * 1000 * 10, 10);
+}
+
+static void TestOutlierAndStep() {
+  PPSModel model;
+  int second = 0;
+  for (; second < 8; ++second) model.AddSample(Pulse(kStart + second, 5000));
+  CHECK(model.locked());
+
+  // A single pulse 5ms off is ignored.
+  CHECK(!model.AddSample(Pulse(kStart + second++, 5005000)));
+  CHECK(model.locked());
+  CHECK_NEAR(model.offset_ns(), 5000, 1);
+  CHECK(model.AddSample(Pulse(kStart + second++, 5000)));
+
+  // Three in a row: the clock was stepped, start over with the new offset.
+  CHECK(!model.AddSample(Pulse(kStart + second++, 3005000)));
+  CHECK(!model.AddSample(Pulse(kStart + second++, 3005000)));
+  CHECK(model.AddSample(Pulse(kStart + second++, 3005000)));
+  CHECK(!model.locked());
+  CHECK_NEAR(model.offset_ns(), 3005000, 1);
+  for (int i = 0; i < 3; ++i) {
+    model.AddSample(Pulse(kStart + second++, 3005000));
+  }
+  CHECK(model.locked());
+  CHECK_NEAR(model.offset_ns(), 3005000, 1);
+}
+
+static void TestHoldover() {
+  PPSModel model;
+  for (int i = 0; i < 4; ++i) model.AddSample(Pulse(kStart + i, 7000));
+  CHECK(model.locked());
+
+  // Without new pulses, the model is used for up to a minute ...
+  const struct timespec within = {kStart + 3 + 60, 0};
+  CHECK_NEAR(DiffNs(model.ToSystemTime(within), within), 7000, 1);
+  // ... but not beyond.
+  const struct timespec beyond = {kStart + 3 + 61, 0};
+  CHECK(DiffNs(model.ToSystemTime(beyond), beyond) == 0);
+}
+
+int main() {
+  TestConstantOffset();
+  TestSystemClockBehind();
+  TestRate();
+  TestOutlierAndStep();
+  TestHoldover();
+  return CheckResult();
+}
@@ -0,0 +1,57 @@
+// -*- mode: c++; c-basic-offset: 2; indent-tabs-mode: nil; -*-
+// Part of txtempus, a LF time signal transmitter.
+// Copyright (C) 2018 Henner Zeller <h.zeller@acm.org>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#ifndef TEST_CHECK_H
+#define TEST_CHECK_H
+
+#include <cmath>
+#include <cstdio>
+
+// Minimal checks for the test programs run by ctest. A failed check is
+// reported and counted, but the test carries on; main() returns
+// CheckResult().
+inline int check_failures = 0;
+
+#define CHECK(condition)                                               \
+  do {                                                                 \
+    if (!(condition)) {                                                \
+      fprintf(stderr, "%s:%d: Check failed: %s\n", __FILE__, __LINE__, \
+              #condition);                                             \
+      ++check_failures;                                                \
+    }                                                                  \
+  } while (0)
+
+#define CHECK_NEAR(value, expected, tolerance)                               \
+  do {                                                                       \
+    const double v_ = (value), e_ = (expected);                              \
+    if (!(std::fabs(v_ - e_) <= (tolerance))) {                              \
+      fprintf(stderr, "%s:%d: Check failed: %s is %g, expected %g +/- %g\n", \
+              __FILE__, __LINE__, #value, v_, e_, (double)(tolerance));      \
+      ++check_failures;                                                      \
+    }                                                                        \
+  } while (0)
+
+// Exit code for ctest: 0 if all checks passed.
+inline int CheckResult() {
+  if (check_failures) fprintf(stderr, "%d check(s) failed\n", check_failures);
+  return check_failures ? 1 : 0;
+}
+
+// Exit code telling ctest that the test could not run here.
+static constexpr int kSkipTest = 77;
+
+#endif  // TEST_CHECK_H